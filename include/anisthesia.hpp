@@ -1,8 +1,14 @@
 #pragma once
 
+#include <anisthesia/detector.hpp>
 #include <anisthesia/media.hpp>
+#include <anisthesia/platform.hpp>
 #include <anisthesia/player.hpp>
 
 #ifdef _WIN32
 #include <anisthesia/win_platform.hpp>
 #endif
+
+#ifdef __linux__
+#include <anisthesia/linux_platform.hpp>
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+
+#include <anisthesia/player.hpp>
+
+// Built-in players are generated from data/players.anisthesia at build time
+// (see ANISTHESIA_BUILTIN_PLAYERS), so that applications shipping the stock
+// database do not have to parse it at run time.
+
+namespace anisthesia {
+
+struct BuiltinPlayer {
+  PlayerType type = PlayerType::Default;
+  std::string_view name;
+  std::string_view window_title_format;
+  std::span<const std::string_view> windows;      // literals are lowercase
+  std::span<const std::string_view> executables;  // literals are lowercase
+  strategy_mask_t strategies = 0;
+  player_option_mask_t options = 0;
+  std::span<const std::string_view> extensions;  // lowercase
+
+  constexpr bool has_strategy(Strategy strategy) const {
+    return (strategies & GetStrategyMask(strategy)) != 0;
+  }
+  constexpr bool has_option(PlayerOption option) const {
+    return (options & GetPlayerOptionMask(option)) != 0;
+  }
+
+  Player ToPlayer() const;
+};
+
+// Returns an empty span if the library was built without built-in players.
+std::span<const BuiltinPlayer> GetBuiltinPlayers();
+
+}  // namespace anisthesia
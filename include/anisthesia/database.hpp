@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <anisthesia/player_table.hpp>
+
+namespace anisthesia {
+
+// Owns an immutable table of the players in a players file, and optionally
+// reloads it in the background whenever the file changes.
+//
+// New tables are published with an atomic pointer swap, after which the
+// generation is incremented. Readers that call Get() keep their table alive
+// for as long as they hold it, and never see a partially updated list of
+// players. If the file fails to parse, the previous table is kept. A Detector
+// that is given the database picks up new tables by itself.
+class PlayersDatabase {
+public:
+  using table_t = std::shared_ptr<const PlayerTable>;
+
+  PlayersDatabase() = default;
+  PlayersDatabase(const PlayersDatabase&) = delete;
+  ~PlayersDatabase();
+
+  PlayersDatabase& operator=(const PlayersDatabase&) = delete;
+
+  // Loading a file stops watching the previous one.
+  bool Load(const std::string& path);
+  bool Reload();
+
+  // Starts watching the file that was previously loaded. Uses inotify on
+  // Linux, and polls the modification time elsewhere.
+  bool Watch();
+  void Unwatch();
+
+  table_t Get() const;
+  uint64_t generation() const;  // zero until a file is loaded
+
+private:
+  std::string path_;
+  std::atomic<table_t> players_;
+  std::atomic<uint64_t> generation_ = 0;
+
+  std::jthread thread_;
+};
+
+}  // namespace anisthesia
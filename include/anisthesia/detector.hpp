@@ -0,0 +1,318 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/database.hpp>
+#include <anisthesia/extension_set.hpp>
+#include <anisthesia/generator.hpp>
+#include <anisthesia/matcher.hpp>
+#include <anisthesia/media.hpp>
+#include <anisthesia/path_trie.hpp>
+#include <anisthesia/platform.hpp>
+#include <anisthesia/player.hpp>
+#include <anisthesia/player_table.hpp>
+#include <anisthesia/strategy.hpp>
+#include <anisthesia/thread_pool.hpp>
+#include <anisthesia/title_cache.hpp>
+
+namespace anisthesia {
+
+bool GetResults(Platform& platform, const std::vector<Player>& players,
+                media_proc_t media_proc, std::vector<Result>& results);
+bool GetResults(Platform& platform, const PlayerTable& players,
+                media_proc_t media_proc, std::vector<Result>& results);
+bool GetResults(Platform& platform, const PlayerTable& players,
+                const PlayerMatcher& matcher, media_proc_t media_proc,
+                std::vector<Result>& results);
+
+TitleCacheStats GetTitleCacheStats();
+
+struct DetectorOptions {
+  // Number of worker threads that run strategies. Each strategy of each result
+  // is a separate task, so that a slow strategy does not hold up the others.
+  // With no workers, strategies run sequentially on the calling thread.
+  size_t worker_count = 4;
+
+  // Time budget of each strategy, zero for no limit. A strategy that exceeds
+  // it is given up on, and reported as TimedOut with the media it has found
+  // so far. Without workers, the budget is only checked between media.
+  strategy_timeout_t strategy_timeout = std::chrono::seconds(2);
+
+  // Open files are reported only if they have one of these extensions, or one
+  // that is declared by the player. Leave empty to report every file of
+  // players that do not declare any.
+  std::vector<std::string> media_extensions = GetDefaultMediaExtensions();
+
+  // Open files under these directories are not reported, in addition to those
+  // under system directories (e.g. fonts, or caches of other applications).
+  std::vector<std::string> excluded_directories;
+
+  // Bounds what the detector and its platform keep between detections. Can be
+  // changed later with Detector::SetCacheLimits.
+  CacheLimits cache_limits;
+};
+
+// Media of a window whose result has changed since the previous poll. Media
+// whose details change (e.g. its state) is both removed and added. Position
+// counts only if it is not where it would be by now, having advanced at the
+// rate of playback (e.g. after a seek).
+struct ResultChange {
+  Result result;
+  std::vector<Media> added;
+  std::vector<Media> removed;
+};
+
+// Difference between two consecutive polls. Results are identified by their
+// window, and a window that is taken over by another process or player counts
+// as one that disappeared and another that appeared.
+struct ChangeSet {
+  std::vector<Result> appeared;
+  std::vector<Result> disappeared;  // as they were last reported
+  std::vector<ResultChange> changed;
+
+  bool empty() const {
+    return appeared.empty() && disappeared.empty() && changed.empty();
+  }
+};
+
+namespace detail {
+
+class StrategyScheduler;
+
+// What strategies need besides the result that they are applied to. Shared
+// with strategies, which may outlive the owner if they are stuck.
+struct StrategyEnvironment {
+  std::shared_ptr<Platform> platform;
+  const PlayerExtensionSets* extensions = nullptr;  // per player, or none
+  std::shared_ptr<const PathTrie> excluded_directories;
+  std::shared_ptr<TitleExtractor> titles;  // or the default one
+};
+
+}  // namespace detail
+
+// Posts work to an event loop. Used to resume coroutines that await results.
+using executor_t = std::function<void(std::function<void()>)>;
+
+// Asynchronous counterpart of Detector::Stream. Each `co_await stream.Next()`
+// resolves to the next result whose strategies are done, or to std::nullopt
+// once all results have been returned. Awaiting coroutines are resumed through
+// the executor, or on a worker thread if there is none. The stream must not be
+// moved while it is being awaited.
+class ResultStream {
+public:
+  class Awaitable {
+  public:
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> handle);
+    std::optional<Result> await_resume();
+
+  private:
+    friend class ResultStream;
+    explicit Awaitable(ResultStream& stream) : stream_(stream) {}
+
+    void Arm();
+    void Step();
+
+    ResultStream& stream_;
+    std::coroutine_handle<> handle_;
+    std::optional<Result> result_;
+  };
+
+  ResultStream(ResultStream&&) noexcept;
+  ~ResultStream();
+
+  ResultStream& operator=(ResultStream&&) noexcept;
+
+  Awaitable Next();
+
+private:
+  friend class Detector;
+  ResultStream(std::unique_ptr<detail::StrategyScheduler> scheduler,
+               executor_t executor);
+
+  // Returns true if a result was taken, or if there are no more results
+  bool TryTake(std::optional<Result>& result);
+  void Post(std::function<void()> proc);
+
+  std::unique_ptr<detail::StrategyScheduler> scheduler_;
+  executor_t executor_;
+};
+
+// Owns the players and everything that is reused between detections: the
+// player index, worker threads, strategy costs, compiled title formats and
+// extracted titles, the previous poll, and through the platform, what it has
+// learned about processes and their open files.
+//
+// The cost and yield of each strategy are measured per player, and strategies
+// that are expected to find a file most cheaply are tried first. Once a
+// strategy finds a file, the remaining ones are skipped (reported as Skipped),
+// unless the player has the "exhaustive" option.
+//
+// GetResults returns results in the order of enumerated windows. Stream and
+// StreamAsync yield each result as soon as its strategies are done, so that a
+// slow strategy of one player does not hold up the others. In either case,
+// media of each result is in the order its strategies were applied. media_proc
+// is never called concurrently, but may be called from any thread.
+//
+// Only one detection may be in progress at a time, and Reset, SetPlayers and
+// SetCacheLimits must not be called during one.
+class Detector {
+public:
+  // Detects through the native platform (see CreateNativePlatform).
+  // Copies of a table share its storage (e.g. a mapped snapshot).
+  explicit Detector(PlayerTable players, DetectorOptions options = {});
+  Detector(std::shared_ptr<Platform> platform, PlayerTable players,
+           DetectorOptions options = {});
+  // Players are taken from the database, and replaced at the start of each
+  // detection if it has loaded a new table since the previous one.
+  explicit Detector(std::shared_ptr<const PlayersDatabase> database,
+                    DetectorOptions options = {});
+  Detector(std::shared_ptr<Platform> platform,
+           std::shared_ptr<const PlayersDatabase> database,
+           DetectorOptions options = {});
+  Detector(const Detector&) = delete;
+
+  Detector& operator=(const Detector&) = delete;
+
+  bool GetResults(media_proc_t media_proc, std::vector<Result>& results);
+
+  // Windows are enumerated when iteration begins.
+  Generator<Result> Stream(media_proc_t media_proc);
+
+  // Windows are enumerated and strategies are started immediately.
+  ResultStream StreamAsync(media_proc_t media_proc, executor_t executor = {});
+
+  // Detects what has changed since the previous poll, which is kept apart from
+  // the other functions. Strategies are only applied to windows that are new,
+  // or whose class, text or process has changed; others keep their media,
+  // unless a strategy of theirs has timed out, or has read the media from the
+  // player itself (i.e. mpris). Returns false if windows could not be
+  // enumerated, in which case the previous poll is kept.
+  bool Poll(media_proc_t media_proc, ChangeSet& changes);
+
+  // Discards everything that has been learned, as if the detector were new.
+  // The next poll reports every result as having appeared.
+  void Reset();
+
+  // Replaces the players. Windows that were matched before are detected again
+  // by the next poll, and reported only if their result has changed.
+  void SetPlayers(PlayerTable players);
+
+  // Caches that exceed the new limits are trimmed immediately.
+  void SetCacheLimits(const CacheLimits& limits);
+
+  const detail::StrategyStats& strategy_stats() const;
+  TitleCacheStats title_cache_stats() const;
+
+private:
+  detail::StrategyEnvironment environment() const;
+  void UpdatePlayers();
+
+  std::shared_ptr<Platform> platform_;
+  std::shared_ptr<const PlayersDatabase> database_;
+  uint64_t generation_ = 0;  // of the database when players were taken
+  PlayerTable players_;
+  bool players_changed_ = false;  // since the previous poll
+  PlayerMatcher matcher_;
+  std::unique_ptr<detail::ThreadPool> thread_pool_;
+  strategy_timeout_t strategy_timeout_;
+  detail::StrategyStats strategy_stats_;
+  std::vector<std::string> media_extensions_;
+  detail::PlayerExtensionSets extensions_;
+  std::shared_ptr<const detail::PathTrie> excluded_directories_;
+  std::shared_ptr<detail::TitleExtractor> titles_;
+  std::vector<Result> snapshot_;  // of the previous poll
+  std::chrono::steady_clock::time_point snapshot_time_;
+};
+
+namespace detail {
+
+// Results are identified by their window. Polls index them, so that finding
+// each window of one among those of another does not take quadratic time.
+using window_index_t = std::unordered_map<window_handle_t, const Result*>;
+window_index_t IndexWindows(const std::vector<Result>& results);
+const Result* FindWindow(const window_index_t& index, const Result& result);
+bool IsSameWindow(const Result& a, const Result& b);
+bool HasTimedOut(const Result& result);
+// Compares media of consecutive polls. The position of media that is playing
+// is expected to have advanced by the time between them (at its rate), and
+// differs only if it is off by more than kPositionTolerance (e.g. after a
+// seek).
+constexpr media_time_t kPositionTolerance = std::chrono::seconds(1);
+bool IsSameMedia(const Media& previous, const Media& current,
+                 media_time_t elapsed);
+// Media that changes without its window (e.g. as reported over MPRIS)
+bool HasLiveMedia(const Result& result);
+void DiffResults(const std::vector<Result>& previous,
+                 const std::vector<Result>& current, media_time_t elapsed,
+                 ChangeSet& changes);
+
+bool EnumerateResults(Platform& platform, const PlayerTable& players,
+                      const PlayerMatcher& matcher,
+                      std::vector<Result>& results);
+
+// Applies strategies to results, and hands out each result once all of its
+// strategies are done. Outcomes are processed on the thread that calls Next,
+// so a scheduler must not be used by more than one thread at a time.
+class StrategyScheduler {
+public:
+  StrategyScheduler(std::vector<Result> results, media_proc_t media_proc,
+                    ThreadPool& thread_pool, strategy_timeout_t timeout,
+                    StrategyStats* stats,
+                    const StrategyEnvironment& environment);
+
+  // Gets the index of the next completed result. Returns false if all results
+  // have been handed out, or if `wait` is false and none is complete yet.
+  bool Next(size_t& index, bool wait);
+  bool NotifyNext(StrategyRunner::notify_proc_t proc);
+
+  bool done() const;
+  bool success() const;
+  std::vector<Result>& results();
+
+private:
+  struct Queue {
+    std::shared_ptr<const Result> result;
+    std::shared_ptr<const ExtensionSet> extensions;
+    std::vector<Strategy> strategies;  // yet to be applied
+    std::vector<Strategy> skipped;
+    std::vector<std::pair<Strategy, StrategyOutcome>>
+        outcomes;  // in the order strategies were applied
+    size_t running = 0;
+    bool exhaustive = false;
+  };
+
+  void SubmitNext(size_t index);
+  void Process(size_t task_index, StrategyOutcome outcome);
+
+  std::vector<Result> results_;
+  std::vector<Queue> queues_;
+  std::vector<std::pair<size_t, size_t>> tasks_;  // result and outcome index
+  std::deque<size_t> completed_;
+  std::shared_ptr<Platform> platform_;
+  std::shared_ptr<TitleExtractor> titles_;
+  std::shared_ptr<const PathTrie> excluded_directories_;
+  StrategyStats* stats_;
+  bool success_ = false;
+  StrategyRunner runner_;
+};
+
+bool ApplyStrategies(media_proc_t media_proc, std::vector<Result>& results,
+                     const StrategyEnvironment& environment);
+bool ApplyStrategies(media_proc_t media_proc, std::vector<Result>& results,
+                     ThreadPool& thread_pool, strategy_timeout_t timeout,
+                     StrategyStats* stats,
+                     const StrategyEnvironment& environment);
+
+}  // namespace detail
+
+}  // namespace anisthesia
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/platform.hpp>
+
+namespace anisthesia::detail {
+
+enum class ElementType {
+  Other,
+  Document,
+  Edit,
+  MenuBar,
+  Tab,
+  TabItem,
+  TitleBar,
+};
+
+enum class ElementProperty {
+  IsEnabled,
+  IsKeyboardFocusable,
+  IsValuePatternAvailable,
+  ValueIsReadOnly,
+};
+
+// A node of the accessibility tree of a window (e.g. UI Automation elements on
+// Windows). Every call may cross into the process that owns the window, which
+// is what makes web browser detection slow.
+class Element {
+public:
+  virtual ~Element() = default;
+
+  virtual ElementType type() = 0;
+  virtual std::string name() = 0;
+  virtual std::string value() = 0;
+  virtual bool GetProperty(ElementProperty property, bool& value) = 0;
+
+  // Returns nullptr if there is no such element
+  virtual std::unique_ptr<Element> FirstChild() = 0;
+  virtual std::unique_ptr<Element> NextSibling() = 0;
+};
+
+// In-memory element, for testing and benchmarking without a web browser
+struct MemoryElement {
+  ElementType type = ElementType::Other;
+  std::string name;
+  std::string value;
+  std::map<ElementProperty, bool> properties;
+  std::vector<MemoryElement> children;
+};
+
+// The tree must not be modified while the element is in use. Each call to the
+// element, or to one that is reached through it, increments `calls`.
+std::unique_ptr<Element> CreateMemoryElement(
+    const MemoryElement& root, std::atomic<uint64_t>* calls = nullptr);
+
+// Child indices from the root of a window to an element
+using ElementPath = std::vector<uint32_t>;
+
+// Where the address bar and the tab strip of a web browser were found, if
+// they were, by the walk at `walked`
+struct WebBrowserElementPaths {
+  ElementPath address;
+  ElementPath tabs;
+  std::chrono::steady_clock::time_point walked;
+};
+
+// Remembers the elements of web browser windows, so that a poll can go
+// straight to them rather than walk the whole tree. Windows that have not been
+// read for the longest time are evicted first.
+class ElementPathCache {
+public:
+  // Windows are told apart by their class as well, as handles are reused.
+  struct Key {
+    window_handle_t handle;
+    std::string class_name;
+
+    auto operator<=>(const Key&) const = default;
+  };
+
+  explicit ElementPathCache(size_t capacity = 32) : capacity_(capacity) {}
+
+  bool Find(const Key& key, WebBrowserElementPaths& paths);
+  void Insert(const Key& key, WebBrowserElementPaths paths);
+  void Erase(const Key& key);
+
+  void Clear();
+  void SetCapacity(size_t capacity);
+  size_t size() const;
+
+private:
+  struct Entry {
+    WebBrowserElementPaths paths;
+    uint64_t last_use = 0;
+  };
+
+  void Evict();  // called with the mutex locked
+
+  mutable std::mutex mutex_;
+  std::map<Key, Entry> entries_;
+  uint64_t use_count_ = 0;
+  size_t capacity_;
+};
+
+// Finds the address bar and the tabs of a web browser below the root element
+// of its window. Paths that are given are tried first, which costs a call per
+// sibling on the way down rather than a walk of the whole tree. The tree is
+// walked only for an element whose path no longer leads to a matching one, or
+// that was not found by the last walk, in which case it is looked for again
+// once kElementWalkInterval has passed (e.g. as the address bar of a window
+// that has left full screen reappears). Paths are updated by the walk.
+// Returns false if nothing could be read.
+constexpr auto kElementWalkInterval = std::chrono::seconds(10);
+bool FindWebBrowserElements(Element& root, WebBrowserElementPaths& paths,
+                            std::string& address,
+                            std::vector<std::string>& tabs,
+                            std::stop_token stop_token = {});
+
+// Reads the title, address and tabs of a web browser through the cache.
+bool GetWebBrowserInformation(Element& root, const Window& window,
+                              ElementPathCache& cache,
+                              web_browser_proc_t web_browser_proc,
+                              std::stop_token stop_token = {});
+
+}  // namespace anisthesia::detail
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <anisthesia/player_table.hpp>
+
+namespace anisthesia {
+
+// Extensions of the files that the open_files strategy reports by default.
+// Players can accept more in their "extensions" section.
+std::vector<std::string> GetDefaultMediaExtensions();
+
+namespace detail {
+
+// Immutable set of file extensions, compiled into a perfect hash table so that
+// a lookup costs one hash and at most one comparison. Extensions are matched
+// case-insensitively, and may be given with or without the leading dot.
+class ExtensionSet {
+public:
+  static constexpr size_t kMaxLength = 15;
+
+  ExtensionSet() = default;
+  explicit ExtensionSet(const std::vector<std::string>& extensions);
+
+  bool empty() const;
+  size_t size() const;
+
+  bool Contains(std::string_view extension) const;
+
+  // Checks the extension of the file name at the end of the path. Wide paths
+  // are checked without being converted.
+  bool ContainsPath(std::string_view path) const;
+  bool ContainsPath(std::wstring_view path) const;
+
+private:
+  struct Slot {
+    std::array<char, kMaxLength> data = {};
+    uint8_t size = 0;  // zero for an empty slot
+  };
+
+  static uint32_t Hash(std::string_view str, uint32_t seed);
+
+  std::vector<Slot> slots_;
+  uint32_t seed_ = 0;
+  uint32_t mask_ = 0;
+  size_t size_ = 0;
+};
+
+// Extension sets of each player, built once from a common set and the
+// extensions that each player declares. Sets are shared with strategies, which
+// may outlive the owner if they are stuck.
+class PlayerExtensionSets {
+public:
+  PlayerExtensionSets() = default;
+  PlayerExtensionSets(const std::vector<std::string>& common,
+                      const PlayerTable& players);
+
+  // Returns nullptr if files of the player are not to be filtered, which is
+  // the case when neither set has any extensions.
+  std::shared_ptr<const ExtensionSet> Get(std::string_view player) const;
+
+private:
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const {
+      return std::hash<std::string_view>{}(str);
+    }
+  };
+
+  std::shared_ptr<const ExtensionSet> common_;
+  std::unordered_map<std::string, std::shared_ptr<const ExtensionSet>,
+                     StringHash, std::equal_to<>>
+      players_;
+};
+
+}  // namespace detail
+
+}  // namespace anisthesia
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <shared_mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <anisthesia/element_tree.hpp>
+#include <anisthesia/path_trie.hpp>
+#include <anisthesia/platform.hpp>
+
+namespace anisthesia {
+
+// In-memory platform, so that detection can be tested and benchmarked with
+// synthetic workloads on any system. Windows are enumerated in the order they
+// were added, and only if their process has been added as well.
+//
+// Web browsers are read either from the information that is set for them, or
+// from an element tree, in which case they are searched as they would be on a
+// real system, and each call to an element is counted.
+//
+// Open files under system directories are never reported, as on a real
+// system. There are none unless they are added, so that a workload behaves
+// the same whichever system it runs on.
+//
+// Strategies may read concurrently. Callbacks must not modify the platform.
+class FakePlatform final : public Platform {
+public:
+  void AddProcess(const Process& process);
+  void AddWindow(process_id_t process_id, const Window& window);
+  void AddOpenFile(const OpenFile& open_file);
+  void AddSystemDirectory(std::string_view directory);
+  void SetWebBrowserInformation(
+      window_handle_t window,
+      std::vector<WebBrowserInformation> web_browser_information);
+  void SetWebBrowserTree(window_handle_t window, detail::MemoryElement root);
+  void SetMediaSessions(process_id_t process_id,
+                        std::vector<MediaSession> media_sessions);
+  void Clear();
+
+  uint64_t element_calls() const;
+
+  bool EnumerateProcesses(process_proc_t process_proc) override;
+  bool EnumerateWindows(window_proc_t window_proc) override;
+  bool EnumerateOpenFiles(const std::set<process_id_t>& process_ids,
+                          open_file_proc_t open_file_proc,
+                          const OpenFileFilter& filter,
+                          std::stop_token stop_token = {}) override;
+  bool GetWebBrowserInformation(const Window& window,
+                                web_browser_proc_t web_browser_proc,
+                                std::stop_token stop_token = {}) override;
+  bool EnumerateMediaSessions(const Process& process,
+                              media_session_proc_t media_session_proc,
+                              std::stop_token stop_token = {}) override;
+
+  void SetCacheLimits(const CacheLimits& limits) override;
+  void ClearCaches() override;
+
+private:
+  mutable std::shared_mutex mutex_;
+  std::map<process_id_t, Process> processes_;
+  std::vector<std::pair<process_id_t, Window>> windows_;
+  std::map<process_id_t, std::vector<std::string>> open_files_;
+  detail::PathTrie system_directories_;
+  std::map<window_handle_t, std::vector<WebBrowserInformation>>
+      web_browser_information_;
+  std::map<window_handle_t, std::shared_ptr<const detail::MemoryElement>>
+      web_browser_trees_;
+  std::map<process_id_t, std::vector<MediaSession>> media_sessions_;
+  detail::ElementPathCache element_paths_;
+  std::atomic<uint64_t> element_calls_ = 0;
+};
+
+}  // namespace anisthesia
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace anisthesia {
+
+// Minimal synchronous generator, as a stand-in for C++23 std::generator. The
+// coroutine body runs on the thread that advances the iterator, and nothing is
+// computed before begin() is called.
+template <typename T>
+class Generator {
+public:
+  struct promise_type {
+    T* value = nullptr;
+    std::exception_ptr exception;
+
+    Generator get_return_object() {
+      return Generator(handle_t::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    std::suspend_always final_suspend() const noexcept { return {}; }
+
+    // The yielded object lives until the coroutine is resumed
+    std::suspend_always yield_value(T& yielded) noexcept {
+      value = std::addressof(yielded);
+      return {};
+    }
+    std::suspend_always yield_value(T&& yielded) noexcept {
+      value = std::addressof(yielded);
+      return {};
+    }
+
+    void return_void() const noexcept {}
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    // Generators are synchronous
+    template <typename U>
+    std::suspend_never await_transform(U&&) = delete;
+  };
+
+  using handle_t = std::coroutine_handle<promise_type>;
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+
+    iterator() = default;
+    explicit iterator(handle_t handle) : handle_(handle) {}
+
+    T& operator*() const { return *handle_.promise().value; }
+    T* operator->() const { return handle_.promise().value; }
+
+    iterator& operator++() {
+      Resume(handle_);
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    bool operator==(std::default_sentinel_t) const {
+      return !handle_ || handle_.done();
+    }
+
+  private:
+    handle_t handle_;
+  };
+
+  Generator(Generator&& other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+  Generator(const Generator&) = delete;
+  ~Generator() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  Generator& operator=(Generator&& other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  Generator& operator=(const Generator&) = delete;
+
+  // Can only be called once, as the generator is an input range.
+  iterator begin() {
+    Resume(handle_);
+    return iterator(handle_);
+  }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+  explicit Generator(handle_t handle) : handle_(handle) {}
+
+  static void Resume(handle_t handle) {
+    handle.resume();
+    if (handle.promise().exception)
+      std::rethrow_exception(handle.promise().exception);
+  }
+
+  handle_t handle_;
+};
+
+}  // namespace anisthesia
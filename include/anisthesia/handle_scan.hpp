@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace anisthesia::detail {
+
+// Layout-compatible with SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX, as returned by
+// NtQuerySystemInformation(SystemExtendedHandleInformation), so that the table
+// can be filtered without depending on Windows headers.
+struct HandleTableEntry {
+  void* Object;
+  uintptr_t UniqueProcessId;
+  void* HandleValue;
+  uint32_t GrantedAccess;
+  uint16_t CreatorBackTraceIndex;
+  uint16_t ObjectTypeIndex;
+  uint32_t HandleAttributes;
+  uint32_t Reserved;
+};
+
+struct HandleFilter {
+  // Process IDs are 32-bit, and only the lower half of UniqueProcessId is
+  // compared. The set is expected to be small (i.e. a few media players).
+  std::span<const uint32_t> process_ids;
+  uint16_t object_type_index = 0;  // 0 to accept any type
+  uint32_t required_access = 0;    // all of these bits must be set
+  uint32_t excluded_access = 0;    // none of these bits may be set
+};
+
+// Appends the indices of matching entries to `indices`, in ascending order.
+// Entries are compared several at a time with SIMD instructions where they are
+// available, with a scalar fallback elsewhere.
+void FilterHandles(std::span<const HandleTableEntry> entries,
+                   const HandleFilter& filter, std::vector<size_t>& indices);
+
+// Reference implementation, which is also used for the remainder of a table.
+void FilterHandlesScalar(std::span<const HandleTableEntry> entries,
+                         const HandleFilter& filter, size_t offset,
+                         std::vector<size_t>& indices);
+
+}  // namespace anisthesia::detail
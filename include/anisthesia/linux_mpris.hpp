@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include <stop_token>
+
+#include <anisthesia/platform.hpp>
+
+namespace anisthesia::lin::detail {
+
+// Keeps track of the media players on the session bus that implement MPRIS
+// (i.e. own an "org.mpris.MediaPlayer2.*" name). Each player is read once when
+// it appears, and is then kept up to date from the signals it emits, which are
+// processed whenever sessions are enumerated. Position is extrapolated from
+// the playback rate in between, as players do not signal its progress.
+//
+// The client connects on first use, and reconnects if the bus goes away.
+class MprisClient {
+public:
+  MprisClient();
+  MprisClient(const MprisClient&) = delete;
+  ~MprisClient();
+
+  MprisClient& operator=(const MprisClient&) = delete;
+
+  // Sessions of players that are owned by the process. If none is, players
+  // whose bus name matches the process name are taken instead (e.g.
+  // "org.mpris.MediaPlayer2.vlc" for "vlc"), as sandboxed players are seen
+  // through another process. Returns false if there is no session bus.
+  bool EnumerateMediaSessions(const Process& process,
+                              media_session_proc_t media_session_proc,
+                              std::stop_token stop_token = {});
+
+  // Disconnects and forgets every player
+  void Clear();
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace anisthesia::lin::detail
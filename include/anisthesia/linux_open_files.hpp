@@ -0,0 +1,47 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <set>
+#include <stop_token>
+#include <string>
+
+#include <sys/types.h>
+
+#include <anisthesia/open_file_cache.hpp>
+#include <anisthesia/path_trie.hpp>
+#include <anisthesia/platform.hpp>
+
+// `linux` is a predefined macro in GNU language modes, hence the short name.
+namespace anisthesia::lin::detail {
+
+// Directories whose files are never media (e.g. /usr and /proc). Built once.
+const anisthesia::detail::PathTrie& GetSystemDirectories();
+
+// A process ID that is reused by another process has another start time.
+struct ProcessKey {
+  process_id_t process_id;
+  uint64_t start_time;  // in clock ticks since boot
+
+  auto operator<=>(const ProcessKey&) const = default;
+};
+
+// A descriptor that is reused for another file refers to another inode.
+struct DescriptorKey {
+  int fd;
+  dev_t device;
+  ino_t inode;
+
+  auto operator<=>(const DescriptorKey&) const = default;
+};
+
+using OpenFileCache =
+    anisthesia::detail::OpenFileCache<ProcessKey, DescriptorKey, std::string>;
+
+bool EnumerateOpenFiles(OpenFileCache& cache,
+                        const std::set<process_id_t>& process_ids,
+                        open_file_proc_t open_file_proc,
+                        const OpenFileFilter& filter,
+                        std::stop_token stop_token = {});
+
+}  // namespace anisthesia::lin::detail
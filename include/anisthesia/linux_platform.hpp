@@ -0,0 +1,52 @@
+#pragma once
+
+#include <set>
+#include <stop_token>
+
+#include <anisthesia/linux_open_files.hpp>
+#ifdef ANISTHESIA_DBUS
+#include <anisthesia/linux_mpris.hpp>
+#endif
+#ifdef ANISTHESIA_XCB
+#include <anisthesia/linux_windows.hpp>
+#endif
+#include <anisthesia/platform.hpp>
+
+namespace anisthesia::lin {
+
+// Processes and their open files are read from /proc. Windows are read from
+// the X server, if the library is built with XCB, and media sessions from the
+// session bus, if it is built with D-Bus. There is no way to read the address
+// bar of a web browser yet.
+//
+// How open files were resolved, and the players on the bus, are remembered
+// per platform, as are the connections to the X server and the bus.
+class LinuxPlatform final : public Platform {
+public:
+  bool EnumerateProcesses(process_proc_t process_proc) override;
+  bool EnumerateWindows(window_proc_t window_proc) override;
+  bool EnumerateOpenFiles(const std::set<process_id_t>& process_ids,
+                          open_file_proc_t open_file_proc,
+                          const OpenFileFilter& filter,
+                          std::stop_token stop_token = {}) override;
+  bool GetWebBrowserInformation(const Window& window,
+                                web_browser_proc_t web_browser_proc,
+                                std::stop_token stop_token = {}) override;
+  bool EnumerateMediaSessions(const Process& process,
+                              media_session_proc_t media_session_proc,
+                              std::stop_token stop_token = {}) override;
+
+  void SetCacheLimits(const CacheLimits& limits) override;
+  void ClearCaches() override;
+
+private:
+  detail::OpenFileCache open_files_;
+#ifdef ANISTHESIA_XCB
+  detail::WindowClient windows_;
+#endif
+#ifdef ANISTHESIA_DBUS
+  detail::MprisClient mpris_;
+#endif
+};
+
+}  // namespace anisthesia::lin
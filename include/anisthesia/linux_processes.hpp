@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include <anisthesia/platform.hpp>
+
+namespace anisthesia::lin::detail {
+
+// Returns the file name of the executable of the process (e.g. "mpv"), or an
+// empty string if it cannot be read, as is the case for kernel threads and
+// processes of other users.
+std::string GetProcessName(process_id_t process_id);
+
+bool EnumerateProcesses(process_proc_t process_proc);
+
+}  // namespace anisthesia::lin::detail
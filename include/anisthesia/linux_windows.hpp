@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+
+#include <anisthesia/platform.hpp>
+
+namespace anisthesia::lin::detail {
+
+// Enumerates the windows that are managed by an EWMH-compliant window manager
+// on the X server of $DISPLAY (including XWayland).
+//
+// The client connects on first use, and keeps the connection (and the atoms
+// it has interned) between enumerations. It reconnects if the server goes
+// away.
+class WindowClient {
+public:
+  WindowClient();
+  WindowClient(const WindowClient&) = delete;
+  ~WindowClient();
+
+  WindowClient& operator=(const WindowClient&) = delete;
+
+  // Returns false if there is no such server, or no window manager that lists
+  // its windows. A window manager that lists none is not an error.
+  bool EnumerateWindows(window_proc_t window_proc);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace anisthesia::lin::detail
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <anisthesia/player_table.hpp>
+#include <anisthesia/regex.hpp>
+
+namespace anisthesia {
+
+namespace detail::matcher {
+
+// ASCII case-insensitive hashing and comparison, with heterogeneous lookup so
+// that string views can be used as keys without allocating.
+struct CaseInsensitiveHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view str) const;
+};
+
+struct CaseInsensitiveEqual {
+  using is_transparent = void;
+  bool operator()(std::string_view str1, std::string_view str2) const;
+};
+
+using index_list_t = std::vector<uint32_t>;  // sorted player indices
+
+using literal_map_t = std::unordered_map<std::string, index_list_t,
+                                         CaseInsensitiveHash,
+                                         CaseInsensitiveEqual>;
+
+struct PatternIndex {
+  literal_map_t literals;
+  index_list_t regex_players;
+  std::vector<std::vector<regex::Regex>> regexes;  // by player index
+};
+
+}  // namespace detail::matcher
+
+// Prebuilt index for finding the player that a window belongs to.
+//
+// Literal window classes and executable names are looked up in hash maps, so
+// the cost of a match does not grow with the number of players. Regular
+// expressions are compiled once, and are only evaluated for players that
+// survive the lookups on both sides.
+class PlayerMatcher {
+public:
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+  PlayerMatcher() = default;
+  explicit PlayerMatcher(const PlayerTable& players);
+
+  // Returns the index of the first player whose window and executable
+  // patterns both match, or npos.
+  size_t Match(std::string_view class_name, std::string_view executable) const;
+
+private:
+  detail::matcher::PatternIndex windows_;
+  detail::matcher::PatternIndex executables_;
+};
+
+}  // namespace anisthesia
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
-#include <vector>
+
+#include <anisthesia/util.hpp>
 
 // Specifications for Matroska media containers:
 // https://www.matroska.org/technical/specs/index.html
@@ -12,7 +16,7 @@ namespace anisthesia::matroska {
 
 namespace detail {
 
-using timecode_scale_t = std::chrono::duration<float, std::nano>;
+using timecode_scale_t = std::chrono::duration<double, std::nano>;
 constexpr uint32_t kDefaultTimecodeScale = 1000000;  // 1 milliseconds
 
 enum ElementId {
@@ -20,6 +24,13 @@ enum ElementId {
   kEBML = 0x1A45DFA3,
   // Segment
   kSegment = 0x18538067,
+  // Meta Seek Information
+  kSeekHead = 0x114D9B74,
+  kSeek = 0x4DBB,
+  kSeekID = 0x53AB,
+  kSeekPosition = 0x53AC,
+  // Cluster
+  kCluster = 0x1F43B675,
   // Segment Information
   kInfo = 0x1549A966,
   kTimecodeScale = 0x2AD7B1,
@@ -36,22 +47,118 @@ enum TrackType {
   kVideo = 1,
 };
 
+////////////////////////////////////////////////////////////////////////////////
+
+// What it took to read a file
+struct ByteSourceStats {
+  uint64_t views = 0;  // headers and values that were read
+  uint64_t bytes_viewed = 0;
+  uint64_t reads = 0;  // system calls, by sources that make them
+  uint64_t bytes_read = 0;
+};
+
+// Where the reader gets its bytes from. Elements are read through views that
+// are only valid until the next call, so that a source can reuse its memory.
+class ByteSource {
+public:
+  virtual ~ByteSource() = default;
+
+  virtual uint64_t size() const = 0;
+
+  // Returns false if the range is out of bounds, or could not be read
+  virtual bool View(uint64_t offset, size_t size,
+                    std::span<const uint8_t>& bytes) = 0;
+
+  const ByteSourceStats& stats() const { return stats_; }
+
+protected:
+  void CountView(size_t size) {
+    ++stats_.views;
+    stats_.bytes_viewed += size;
+  }
+
+  ByteSourceStats stats_;
+};
+
+// Bytes that the caller already holds. They must outlive the source.
+class MemorySource final : public ByteSource {
+public:
+  explicit MemorySource(std::span<const uint8_t> data) : data_(data) {}
+
+  uint64_t size() const override;
+  bool View(uint64_t offset, size_t size,
+            std::span<const uint8_t>& bytes) override;
+
+private:
+  std::span<const uint8_t> data_;
+};
+
+// Maps the whole file, so that reading an element costs no system call
+class MappedFileSource final : public ByteSource {
+public:
+  bool Open(const std::string& path);
+
+  uint64_t size() const override;
+  bool View(uint64_t offset, size_t size,
+            std::span<const uint8_t>& bytes) override;
+
+private:
+  anisthesia::detail::util::MappedFile file_;
+};
+
+// Reads the file in blocks into a single buffer, which is reused for every
+// element that falls within the block. Used when a file cannot be mapped
+// (e.g. while another process has it open for writing on Windows).
+class FileSource final : public ByteSource {
+public:
+  explicit FileSource(size_t block_size = 0x10000);  // arbitrary size
+  FileSource(const FileSource&) = delete;
+  ~FileSource();
+
+  FileSource& operator=(const FileSource&) = delete;
+
+  bool Open(const std::string& path);
+  void Close();
+
+  uint64_t size() const override;
+  bool View(uint64_t offset, size_t size,
+            std::span<const uint8_t>& bytes) override;
+
+private:
+  bool ReadAt(uint64_t offset, size_t size);
+
+#ifdef _WIN32
+  void* handle_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+  uint64_t size_ = 0;
+  size_t block_size_;
+  std::unique_ptr<uint8_t[]> buffer_;
+  size_t buffer_capacity_ = 0;
+  uint64_t buffer_offset_ = 0;
+  size_t buffer_size_ = 0;  // bytes that are valid
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Reads the values of an element. Every read is checked against the end of
+// the data, and fails rather than reading past it.
 class Buffer {
 public:
-  Buffer(size_t size);
+  explicit Buffer(std::span<const uint8_t> data) : data_(data) {}
 
-  uint8_t* data();
   size_t pos() const;
   size_t size() const;
-  void skip(size_t size);
+  bool skip(size_t size);
 
-  bool read_encoded_value(uint32_t& value, bool clear_leading_bits);
-  uint32_t read_uint32(const size_t size);
-  float read_float(const size_t size);
-  std::string read_string(const size_t size);
+  bool read_encoded_value(uint64_t& value, bool clear_leading_bits);
+  bool read_uint(const size_t size, uint64_t& value);
+  bool read_float(const size_t size, double& value);
+  bool read_string(const size_t size, std::string& value);
 
 private:
-  std::vector<uint8_t> data_;
+  std::span<const uint8_t> data_;
   size_t pos_ = 0;
 };
 
@@ -65,6 +172,14 @@ struct Info {
   std::string video_track_name;
 };
 
+namespace detail {
+
+bool ReadInfo(ByteSource& source, Info& info);
+
+}  // namespace detail
+
+// Maps the file if possible, and reads it in blocks otherwise
 bool ReadInfoFromFile(const std::string& path, Info& info);
+bool ReadInfoFromMemory(std::span<const uint8_t> data, Info& info);
 
 }  // namespace anisthesia::matroska
@@ -27,13 +27,19 @@ enum class MediaState {
 struct MediaInfo {
   MediaInfoType type = MediaInfoType::Unknown;
   std::string value;
+
+  bool operator==(const MediaInfo&) const = default;
 };
 
 struct Media {
-  MediaState state = MediaState::Unknown;  // currently unused
-  media_time_t duration;                   // currently unused
-  media_time_t position;                   // currently unused
+  // Only known to strategies that read them from the player (i.e. mpris)
+  MediaState state = MediaState::Unknown;
+  media_time_t duration = media_time_t::zero();
+  media_time_t position = media_time_t::zero();
+  double rate = 1.0;  // by which the position advances while playing
   std::vector<MediaInfo> information;
+
+  bool operator==(const Media&) const = default;
 };
 
 using media_proc_t = std::function<bool(const MediaInfo&)>;
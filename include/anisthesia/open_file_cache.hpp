@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace anisthesia::detail {
+
+enum class OpenFileStatus {
+  Accepted,
+  InvalidType,    // not a regular disk file
+  InvalidAccess,  // opened for writing
+  InvalidPath,    // under a system directory, or not a file
+  InvalidExtension,
+};
+
+// Remembers how the open handles (or file descriptors) of each process were
+// resolved, so that a poll only has to query the ones that are new. Players
+// rarely open or close files between polls, which turns most of the system
+// calls per handle into a map lookup.
+//
+// ProcessKey should tell apart processes that reuse an ID, and HandleKey
+// should tell apart objects that reuse a handle value. Both are compared with
+// operator<.
+//
+// Each process is scanned as a whole. Entries that are not looked up during a
+// complete scan belong to handles that no longer exist, and are evicted.
+template <typename ProcessKey, typename HandleKey, typename Path>
+class OpenFileCache {
+public:
+  struct Entry {
+    OpenFileStatus status = OpenFileStatus::Accepted;
+    Path path;  // for accepted files, and those with another extension
+  };
+
+  using entries_t = std::map<HandleKey, Entry>;
+
+  class Scan {
+  public:
+    // Returns the entry from the previous scan of the process, if any, and
+    // keeps it for the next one.
+    const Entry* Find(const HandleKey& key) {
+      auto node = previous_.extract(key);
+      if (node.empty())
+        return nullptr;
+      return &current_.insert(std::move(node)).position->second;
+    }
+
+    const Entry& Insert(const HandleKey& key, Entry entry) {
+      return current_.insert_or_assign(key, std::move(entry)).first->second;
+    }
+
+  private:
+    friend class OpenFileCache;
+
+    ProcessKey process_;
+    entries_t previous_;
+    entries_t current_;
+  };
+
+  explicit OpenFileCache(size_t max_processes = 32)
+      : max_processes_(max_processes) {}
+
+  // The entries of the process are taken out of the cache until the scan
+  // ends. A concurrent scan of the same process starts from scratch.
+  Scan Begin(const ProcessKey& process) {
+    Scan scan;
+    scan.process_ = process;
+
+    std::lock_guard lock(mutex_);
+    if (auto node = processes_.extract(process); !node.empty())
+      scan.previous_ = std::move(node.mapped().entries);
+
+    return scan;
+  }
+
+  // An incomplete scan (e.g. one that was stopped) keeps the entries that it
+  // has not reached.
+  void End(Scan&& scan, bool complete) {
+    if (!complete) {
+      scan.current_.merge(scan.previous_);
+    }
+
+    std::lock_guard lock(mutex_);
+    auto& process = processes_[scan.process_];
+    process.entries = std::move(scan.current_);
+    process.last_scan = ++scan_count_;
+    Evict();
+  }
+
+  void Clear() {
+    std::lock_guard lock(mutex_);
+    processes_.clear();
+  }
+
+  void SetMaxProcesses(size_t max_processes) {
+    std::lock_guard lock(mutex_);
+    max_processes_ = max_processes;
+    Evict();
+  }
+
+  // Number of entries of all processes that are not being scanned
+  size_t size() const {
+    std::lock_guard lock(mutex_);
+    size_t size = 0;
+    for (const auto& [key, process] : processes_) {
+      size += process.entries.size();
+    }
+    return size;
+  }
+
+private:
+  struct Process {
+    entries_t entries;
+    uint64_t last_scan = 0;
+  };
+
+  // Processes that have not been scanned for the longest time have most likely
+  // exited. Called with the mutex locked.
+  void Evict() {
+    while (processes_.size() > max_processes_) {
+      auto oldest = processes_.begin();
+      for (auto it = processes_.begin(); it != processes_.end(); ++it) {
+        if (it->second.last_scan < oldest->second.last_scan)
+          oldest = it;
+      }
+      processes_.erase(oldest);
+    }
+  }
+
+  mutable std::mutex mutex_;
+  std::map<ProcessKey, Process> processes_;
+  uint64_t scan_count_ = 0;
+  size_t max_processes_;
+};
+
+}  // namespace anisthesia::detail
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace anisthesia::detail {
+
+// Set of directories, for checking whether a path is under any of them. Each
+// check is a single walk over the path, without allocation, however many
+// directories there are.
+//
+// Matching is ASCII case-insensitive, treats '\' and '/' alike, ignores the
+// extended-length prefix ("\\?\") of Windows paths, and respects component
+// boundaries (i.e. "/usr" does not match "/usrdata").
+template <typename CharT>
+class BasicPathTrie {
+public:
+  using string_view_t = std::basic_string_view<CharT>;
+
+  BasicPathTrie() : nodes_(1) {}
+
+  void Insert(string_view_t directory) {
+    directory = StripPrefix(directory);
+    while (!directory.empty() && IsSeparator(directory.back()))
+      directory.remove_suffix(1);
+    if (directory.empty())
+      return;
+
+    uint32_t index = 0;
+    for (const auto c : directory) {
+      const auto folded = Fold(c);
+      const auto child = FindChild(index, folded);
+      if (child) {
+        index = child;
+      } else {
+        const auto next = static_cast<uint32_t>(nodes_.size());
+        nodes_[index].children.emplace_back(folded, next);
+        nodes_.emplace_back();
+        index = next;
+      }
+    }
+    nodes_[index].terminal = true;
+    ++size_;
+  }
+
+  // True if the path is one of the directories, or is under one of them.
+  bool Match(string_view_t path) const {
+    path = StripPrefix(path);
+
+    uint32_t index = 0;
+    for (size_t i = 0; i < path.size(); ++i) {
+      if (nodes_[index].terminal && IsSeparator(path[i]))
+        return true;
+      index = FindChild(index, Fold(path[i]));
+      if (!index)
+        return false;
+    }
+    return nodes_[index].terminal;
+  }
+
+  bool empty() const { return !size_; }
+
+private:
+  struct Node {
+    std::vector<std::pair<CharT, uint32_t>> children;
+    bool terminal = false;
+  };
+
+  static bool IsSeparator(CharT c) {
+    return c == CharT('/') || c == CharT('\\');
+  }
+
+  static CharT Fold(CharT c) {
+    if (c == CharT('\\'))
+      return CharT('/');
+    if (c >= CharT('A') && c <= CharT('Z'))
+      return static_cast<CharT>(c + (CharT('a') - CharT('A')));
+    return c;
+  }
+
+  static string_view_t StripPrefix(string_view_t path) {
+    constexpr CharT kPrefix[] = {'\\', '\\', '?', '\\'};
+    if (path.starts_with(string_view_t(kPrefix, 4)))
+      path.remove_prefix(4);
+    return path;
+  }
+
+  // Returns 0 if there is no such child, as the root is nobody's child
+  uint32_t FindChild(uint32_t index, CharT c) const {
+    for (const auto& [key, child] : nodes_[index].children) {
+      if (key == c)
+        return child;
+    }
+    return 0;
+  }
+
+  std::vector<Node> nodes_;
+  size_t size_ = 0;
+};
+
+using PathTrie = BasicPathTrie<char>;
+using WidePathTrie = BasicPathTrie<wchar_t>;
+
+}  // namespace anisthesia::detail
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include <anisthesia/extension_set.hpp>
+#include <anisthesia/media.hpp>
+#include <anisthesia/path_trie.hpp>
+#include <anisthesia/player.hpp>
+#include <anisthesia/strategy.hpp>
+
+namespace anisthesia {
+
+using process_id_t = uint32_t;
+using window_handle_t = uintptr_t;  // HWND on Windows, XID on Linux
+
+// Strings are UTF-8, whatever the platform uses natively.
+
+struct Process {
+  process_id_t id = 0;
+  std::string name;  // of the executable, without extension
+};
+
+struct Window {
+  window_handle_t handle = 0;
+  std::string class_name;
+  std::string text;
+};
+
+struct Result {
+  Player player;
+  Process process;
+  Window window;
+  std::vector<Media> media;
+  std::vector<StrategyResult> strategies;  // in the order they were applied
+};
+
+struct OpenFile {
+  process_id_t process_id = 0;
+  std::string path;
+};
+
+// Files under system directories are never reported.
+struct OpenFileFilter {
+  const detail::ExtensionSet* extensions = nullptr;  // or any
+  const detail::PathTrie* excluded_directories = nullptr;
+};
+
+enum class WebBrowserInformationType {
+  Address,
+  Tab,
+  Title,
+};
+
+struct WebBrowserInformation {
+  WebBrowserInformationType type = WebBrowserInformationType::Title;
+  std::string value;
+};
+
+// Upper bounds of what is kept between detections. Each platform uses those
+// that apply to it.
+struct CacheLimits {
+  size_t titles = 256;              // extracted window titles
+  size_t open_file_processes = 32;  // processes whose open files are known
+  size_t snapshot_size = 16 << 20;  // bytes of the handle table (Windows)
+  size_t web_browser_windows = 32;  // whose elements are known
+};
+
+// A player that publishes what it is playing (e.g. over MPRIS on Linux)
+struct MediaSession {
+  MediaState state = MediaState::Unknown;
+  media_time_t duration = media_time_t::zero();  // or unknown
+  media_time_t position = media_time_t::zero();  // as of the call
+  double rate = 1.0;  // of playback
+  std::string title;
+  std::string url;  // file:// for local files
+};
+
+using process_proc_t = std::function<bool(const Process&)>;
+using window_proc_t = std::function<bool(const Process&, const Window&)>;
+using open_file_proc_t = std::function<bool(const OpenFile&)>;
+using web_browser_proc_t = std::function<void(const WebBrowserInformation&)>;
+using media_session_proc_t = std::function<bool(const MediaSession&)>;
+
+// Everything that detection needs from the operating system. Callbacks return
+// false to stop an enumeration early, and functions return false if nothing
+// could be enumerated.
+//
+// Strategies call the platform from worker threads, concurrently, and may keep
+// doing so after they are given up on. Platforms are therefore shared.
+class Platform {
+public:
+  virtual ~Platform() = default;
+
+  virtual bool EnumerateProcesses(process_proc_t process_proc) = 0;
+
+  // Visible top-level windows that may belong to a player, along with the
+  // process that owns each of them. Called on the detecting thread.
+  virtual bool EnumerateWindows(window_proc_t window_proc) = 0;
+
+  virtual bool EnumerateOpenFiles(const std::set<process_id_t>& process_ids,
+                                  open_file_proc_t open_file_proc,
+                                  const OpenFileFilter& filter,
+                                  std::stop_token stop_token = {}) = 0;
+
+  // Reads the address bar, the active tab, and the title of a web browser.
+  virtual bool GetWebBrowserInformation(const Window& window,
+                                        web_browser_proc_t web_browser_proc,
+                                        std::stop_token stop_token = {}) = 0;
+
+  // Media sessions that belong to the process. Platforms that have no such
+  // thing return false.
+  virtual bool EnumerateMediaSessions(const Process&, media_session_proc_t,
+                                      std::stop_token = {}) {
+    return false;
+  }
+
+  // Called on each worker thread as it starts and exits
+  virtual void InitializeThread() {}
+  virtual void UninitializeThread() {}
+
+  // What is learned between calls (e.g. how open files were resolved) belongs
+  // to the platform, and is discarded along with it, or when it is cleared.
+  virtual void SetCacheLimits(const CacheLimits&) {}
+  virtual void ClearCaches() {}
+};
+
+// Returns the implementation for the operating system that the library is
+// built for.
+std::shared_ptr<Platform> CreateNativePlatform();
+
+}  // namespace anisthesia
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace anisthesia {
@@ -9,8 +11,27 @@ enum class Strategy {
   WindowTitle,
   OpenFiles,
   UiAutomation,
+  Mpris,
 };
 
+using strategy_mask_t = uint32_t;
+
+constexpr strategy_mask_t GetStrategyMask(Strategy strategy) {
+  return strategy_mask_t{1} << static_cast<uint32_t>(strategy);
+}
+
+enum class PlayerOption {
+  // Applies every strategy, rather than stopping at the first one that finds
+  // a file
+  Exhaustive,
+};
+
+using player_option_mask_t = uint32_t;
+
+constexpr player_option_mask_t GetPlayerOptionMask(PlayerOption option) {
+  return player_option_mask_t{1} << static_cast<uint32_t>(option);
+}
+
 enum class PlayerType {
   Default,
   WebBrowser,
@@ -23,9 +44,13 @@ struct Player {
   std::vector<std::string> windows;
   std::vector<std::string> executables;
   std::vector<Strategy> strategies;
+  std::vector<PlayerOption> options;
+  std::vector<std::string> extensions;  // accepted by open_files
+
+  bool has_option(PlayerOption option) const;
 };
 
-bool ParsePlayersData(const std::string& data, std::vector<Player>& players);
+bool ParsePlayersData(std::string_view data, std::vector<Player>& players);
 bool ParsePlayersFile(const std::string& path, std::vector<Player>& players);
 
 }  // namespace anisthesia
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <anisthesia/player.hpp>
+
+// Compact storage for players. Instead of a handful of heap blocks per player,
+// all strings live in a single arena where each distinct string is stored only
+// once, and players are fixed-size records that refer to it by offset.
+//
+// The same layout is used by binary snapshots, so a table can refer to the
+// sections of a memory-mapped snapshot as they are, rather than build its own.
+
+namespace anisthesia {
+
+struct BuiltinPlayer;
+class Snapshot;
+
+namespace detail::table {
+
+struct StringRef {
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct PlayerRecord {
+  StringRef name;
+  StringRef window_title_format;
+  uint32_t windows_begin;
+  uint32_t windows_count;
+  uint32_t executables_begin;
+  uint32_t executables_count;
+  strategy_mask_t strategies;
+  uint32_t type;
+  player_option_mask_t options;
+  uint32_t extensions_begin;
+  uint32_t extensions_count;
+};
+
+}  // namespace detail::table
+
+// Range of string views over a contiguous array of string references
+class StringRefRange {
+public:
+  class iterator {
+  public:
+    iterator(const char* strings, const detail::table::StringRef* ref)
+        : strings_(strings), ref_(ref) {}
+
+    std::string_view operator*() const {
+      return {strings_ + ref_->offset, ref_->size};
+    }
+    iterator& operator++() { ++ref_; return *this; }
+    bool operator==(const iterator& other) const { return ref_ == other.ref_; }
+
+  private:
+    const char* strings_;
+    const detail::table::StringRef* ref_;
+  };
+
+  StringRefRange(const char* strings,
+                 const detail::table::StringRef* begin, size_t size)
+      : strings_(strings), begin_(begin), end_(begin + size) {}
+
+  iterator begin() const { return {strings_, begin_}; }
+  iterator end() const { return {strings_, end_}; }
+  bool empty() const { return begin_ == end_; }
+  size_t size() const { return static_cast<size_t>(end_ - begin_); }
+
+private:
+  const char* strings_;
+  const detail::table::StringRef* begin_;
+  const detail::table::StringRef* end_;
+};
+
+// Non-owning view of a player record. It is valid for as long as the table or
+// snapshot it was obtained from is alive and unchanged.
+class PlayerRef {
+public:
+  PlayerRef(const detail::table::PlayerRecord* records, uint32_t index,
+            const detail::table::StringRef* patterns, const char* strings)
+      : records_(records), index_(index),
+        patterns_(patterns), strings_(strings) {}
+
+  uint32_t index() const { return index_; }
+
+  PlayerType type() const;
+  std::string_view name() const;
+  std::string_view window_title_format() const;
+  StringRefRange windows() const;
+  StringRefRange executables() const;
+  strategy_mask_t strategies() const;
+  bool has_strategy(Strategy strategy) const;
+  player_option_mask_t options() const;
+  bool has_option(PlayerOption option) const;
+  StringRefRange extensions() const;
+
+  Player ToPlayer() const;
+
+private:
+  const detail::table::PlayerRecord& record() const {
+    return records_[index_];
+  }
+  std::string_view GetString(const detail::table::StringRef& ref) const {
+    return {strings_ + ref.offset, ref.size};
+  }
+
+  const detail::table::PlayerRecord* records_;
+  uint32_t index_;
+  const detail::table::StringRef* patterns_;
+  const char* strings_;
+};
+
+// Tables are immutable, and copies share their storage.
+class PlayerTable {
+public:
+  PlayerTable() = default;
+  explicit PlayerTable(const std::vector<Player>& players);
+  // Strings of built-in players are interned from their literals, without
+  // going through Player.
+  explicit PlayerTable(std::span<const BuiltinPlayer> players);
+  // Refers to the sections of the snapshot where they are mapped, so that
+  // nothing is allocated per player. The snapshot is kept open for as long as
+  // the table, or any copy of it, is alive.
+  explicit PlayerTable(std::shared_ptr<const Snapshot> snapshot);
+
+  bool empty() const;
+  size_t size() const;
+  PlayerRef operator[](size_t index) const;
+
+  std::span<const detail::table::PlayerRecord> records() const;
+  std::span<const detail::table::StringRef> patterns() const;
+  std::string_view strings() const;
+
+private:
+  struct Storage;  // of parsed and built-in players
+
+  template <typename Players>
+  static std::shared_ptr<const Storage> Build(const Players& players);
+
+  explicit PlayerTable(std::shared_ptr<const Storage> storage);
+
+  std::span<const detail::table::PlayerRecord> records_;
+  std::span<const detail::table::StringRef> patterns_;
+  std::string_view strings_;
+  std::shared_ptr<const void> owner_;  // storage or snapshot
+};
+
+}  // namespace anisthesia
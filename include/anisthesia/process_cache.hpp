@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace anisthesia::detail {
+
+// Remembers what was learned about each process that owns a window (e.g. its
+// executable, and whether it can be a player), so that a process is resolved
+// once rather than for each of its windows on every poll.
+//
+// Key should tell apart processes that reuse an ID (e.g. by including the
+// creation time), and is compared with operator<.
+//
+// Entries that are not looked up between two complete sweeps belong to
+// processes that have exited, or no longer have any windows, and are evicted.
+template <typename Key, typename Value>
+class ProcessCache {
+public:
+  std::optional<Value> Find(const Key& key) {
+    std::lock_guard lock(mutex_);
+    const auto it = entries_.find(key);
+    if (it == entries_.end())
+      return std::nullopt;
+    it->second.sweep = sweep_;
+    return it->second.value;
+  }
+
+  void Insert(const Key& key, Value value) {
+    std::lock_guard lock(mutex_);
+    entries_.insert_or_assign(key, Entry{std::move(value), sweep_});
+  }
+
+  // Called after every process has been looked up. An incomplete enumeration
+  // (e.g. one that was stopped) must not sweep.
+  void Sweep() {
+    std::lock_guard lock(mutex_);
+    std::erase_if(entries_, [this](const auto& item) {
+      return item.second.sweep != sweep_;
+    });
+    ++sweep_;
+  }
+
+  void Clear() {
+    std::lock_guard lock(mutex_);
+    entries_.clear();
+  }
+
+  size_t size() const {
+    std::lock_guard lock(mutex_);
+    return entries_.size();
+  }
+
+private:
+  struct Entry {
+    Value value;
+    uint64_t sweep = 0;
+  };
+
+  mutable std::mutex mutex_;
+  std::map<Key, Entry> entries_;
+  uint64_t sweep_ = 0;
+};
+
+}  // namespace anisthesia::detail
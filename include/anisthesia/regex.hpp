@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// A small regular expression engine that covers the subset of ECMAScript
+// grammar used in the players file: literals, escapes, character classes,
+// groups (capturing and non-capturing), alternation, greedy and lazy
+// quantifiers, and anchors. Backreferences and lookarounds are not supported.
+//
+// Patterns are compiled once. Matches without captures run on a lazily built
+// DFA, and matches with captures run on a Thompson NFA simulation (Pike VM)
+// that yields the same groups as an ECMAScript backtracking implementation
+// would. Both are linear in the length of the input, and neither recurses on
+// it.
+//
+// In ECMAScript, an iteration of a loop that matches empty ends the loop, so
+// "(a*)*b" captures "aa" in "aab". std::regex of libstdc++ runs that empty
+// iteration instead, and captures "". Captures in such loops therefore differ
+// from std::regex, though matches do not.
+//
+// Matching is byte-oriented, like std::regex with char: '.' matches any byte
+// except line terminators.
+
+namespace anisthesia::regex {
+
+namespace detail {
+
+enum class Opcode : uint8_t {
+  Byte,         // consumes the byte in `byte`
+  Any,          // consumes any byte except '\n' and '\r'
+  Class,        // consumes a byte that is in classes[x]
+  Split,        // continues at x, then at y (in order of priority)
+  Jump,         // continues at x
+  Save,         // stores the current position in slot x
+  AssertBegin,  // succeeds at the beginning of input
+  AssertEnd,    // succeeds at the end of input
+  Match,
+};
+
+struct Instruction {
+  Opcode opcode = Opcode::Match;
+  uint8_t byte = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+};
+
+using byte_set_t = std::bitset<256>;
+
+struct Program {
+  std::vector<Instruction> instructions;
+  std::vector<byte_set_t> classes;
+  size_t group_count = 0;  // excluding the implicit group 0
+};
+
+bool Compile(std::string_view pattern, Program& program);
+
+// Lazily built DFA. States are created on demand as the input is scanned, and
+// are kept for subsequent matches.
+class Dfa {
+public:
+  enum class Result {
+    NoMatch,
+    Match,
+    GaveUp,  // too many states, caller must fall back to the NFA
+  };
+
+  Dfa(const Program& program, bool search);
+
+  Result Run(std::string_view str);
+
+private:
+  static constexpr int32_t kUnknown = -1;
+  static constexpr int32_t kDead = -2;
+  static constexpr size_t kMaxStates = 4096;
+
+  struct State {
+    std::vector<uint32_t> pcs;
+    std::array<int32_t, 256> next;
+    bool match = false;         // contains Match
+    bool match_at_end = false;  // reaches Match if input ends here
+  };
+
+  void AddClosure(uint32_t pc, bool at_begin, bool at_end,
+                  std::vector<uint32_t>& pcs);
+  int32_t GetState(std::vector<uint32_t>& pcs);
+  int32_t Step(int32_t state, uint8_t byte);
+
+  const Program& program_;
+  const bool search_;
+  std::vector<uint32_t> start_pcs_;  // for restarting an unanchored search
+  std::vector<State> states_;
+  std::map<std::vector<uint32_t>, int32_t> state_map_;
+  std::vector<uint32_t> visited_;
+  uint32_t generation_ = 0;
+};
+
+// Runs the NFA simulation. On a match, stores the offsets of group boundaries
+// (2 per group, SIZE_MAX if unmatched) of the highest priority match.
+bool RunPikeVm(const Program& program, std::string_view str, bool search,
+               std::vector<size_t>* slots);
+
+}  // namespace detail
+
+class Regex {
+public:
+  Regex() = default;
+  explicit Regex(std::string_view pattern);
+  Regex(const Regex& other);
+  Regex(Regex&& other) noexcept = default;
+
+  Regex& operator=(const Regex& other);
+  Regex& operator=(Regex&& other) noexcept = default;
+
+  // Invalid or unsupported patterns never match anything.
+  bool valid() const;
+  size_t group_count() const;
+
+  // Matches the entire string, like std::regex_match.
+  bool Match(std::string_view str) const;
+
+  // Matches the entire string, and stores the whole match followed by each
+  // group. Groups that did not participate in the match are empty.
+  bool Match(std::string_view str,
+             std::vector<std::string_view>& groups) const;
+
+  // Finds a match anywhere in the string, like std::regex_search.
+  bool Search(std::string_view str) const;
+
+private:
+  struct Cache {
+    std::mutex mutex;
+    std::unique_ptr<detail::Dfa> match;
+    std::unique_ptr<detail::Dfa> search;
+  };
+
+  bool RunDfa(std::string_view str, bool search) const;
+
+  std::shared_ptr<const detail::Program> program_;
+  std::unique_ptr<Cache> cache_;
+};
+
+}  // namespace anisthesia::regex
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <anisthesia/player.hpp>
+#include <anisthesia/player_table.hpp>
+#include <anisthesia/util.hpp>
+
+// Binary snapshots are precompiled forms of the players file. They can be
+// memory-mapped and used as is, without any parsing or allocation. Records,
+// patterns and strings share the layout of PlayerTable (see player_table.hpp).
+//
+// Layout (all integers are in native byte order):
+//
+//   Header
+//   PlayerRecord[player_count]
+//   StringRef[pattern_count]     (window and executable patterns, extensions)
+//   char[string_table_size]      (not null-terminated)
+
+namespace anisthesia {
+
+namespace detail::snapshot {
+
+constexpr char kMagic[4] = {'A', 'N', 'I', 'S'};
+constexpr uint16_t kVersion = 3;
+constexpr uint16_t kByteOrderMark = 0x0102;
+
+struct Header {
+  char magic[4];
+  uint16_t version;
+  uint16_t byte_order;
+  uint32_t checksum;  // of everything after the header
+  uint32_t player_count;
+  uint32_t pattern_count;
+  uint32_t string_table_size;
+};
+
+uint32_t Checksum(const char* data, size_t size);
+
+}  // namespace detail::snapshot
+
+class Snapshot {
+public:
+  // Maps the snapshot file and validates its header, checksum and offsets.
+  bool Open(const std::string& path);
+  void Close();
+
+  size_t size() const;
+  PlayerRef operator[](size_t index) const;
+
+  // Sections as they are mapped, in the layout of PlayerTable
+  std::span<const detail::table::PlayerRecord> records() const;
+  std::span<const detail::table::StringRef> patterns() const;
+  std::string_view strings() const;
+
+private:
+  bool ValidateHeader() const;   // against the size of the file
+  bool ValidateOffsets() const;  // against the sections
+
+  detail::util::MappedFile file_;
+  const detail::snapshot::Header* header_ = nullptr;
+  const detail::table::PlayerRecord* records_ = nullptr;
+  const detail::table::StringRef* patterns_ = nullptr;
+  const char* strings_ = nullptr;
+};
+
+bool CompileSnapshot(const std::vector<Player>& players, std::string& data);
+bool CompileSnapshot(const PlayerTable& table, std::string& data);
+bool ReadSnapshotFile(const std::string& path, std::vector<Player>& players);
+
+}  // namespace anisthesia
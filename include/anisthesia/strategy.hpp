@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <anisthesia/media.hpp>
+#include <anisthesia/player.hpp>
+#include <anisthesia/thread_pool.hpp>
+
+namespace anisthesia {
+
+enum class StrategyStatus {
+  NotFound,  // completed without finding any media
+  Found,
+  TimedOut,  // exceeded its time budget, media may be incomplete
+  Skipped,   // another strategy has already found a file
+};
+
+struct StrategyResult {
+  Strategy strategy = Strategy::WindowTitle;
+  StrategyStatus status = StrategyStatus::NotFound;
+};
+
+using strategy_timeout_t = std::chrono::milliseconds;
+using strategy_cost_t = std::chrono::microseconds;
+
+constexpr size_t kStrategyCount =
+    static_cast<size_t>(Strategy::Mpris) + 1;
+
+namespace detail {
+
+struct StrategyRunnerState;
+struct StrategyTaskState;
+
+// Handed to a running strategy. Strategies report media through AddMedia, and
+// are expected to poll stop_requested() between steps that may take a while.
+class StrategyContext {
+public:
+  StrategyContext(std::shared_ptr<StrategyRunnerState> runner,
+                  std::shared_ptr<StrategyTaskState> task);
+
+  // Returns false if the media was rejected by media_proc, or if the strategy
+  // has already been given up on.
+  bool AddMedia(const MediaInfo& media_information);
+  // Information that is rejected is left out. Returns false if all of it is.
+  bool AddMedia(Media media);
+
+  // True once the time budget is exceeded. Also checks the clock, so that it
+  // works when strategies run on the calling thread without a watchdog.
+  bool stop_requested() const;
+  std::stop_token stop_token() const;
+
+private:
+  std::shared_ptr<StrategyRunnerState> runner_;
+  std::shared_ptr<StrategyTaskState> task_;
+};
+
+using strategy_task_t = std::function<bool(StrategyContext&)>;
+
+struct StrategyOutcome {
+  StrategyStatus status = StrategyStatus::NotFound;
+  std::vector<Media> media;
+  strategy_cost_t cost{0};  // time from start to finish or to the deadline
+};
+
+// Runs strategy tasks on a thread pool, and hands out their outcomes in the
+// order they finish.
+//
+// Each task gets `timeout` from the moment it starts (zero for no limit). A
+// watchdog thread requests a stop when a task exceeds its budget, and gives up
+// on it with whatever media it has reported so far. A task that is stuck in a
+// call that cannot be interrupted keeps its thread until it returns, and the
+// pool starts another one in its place.
+//
+// media_proc is never called concurrently, and is never called after the
+// runner is destroyed. Unfinished tasks are given up on at that point.
+class StrategyRunner {
+public:
+  using notify_proc_t = std::function<void()>;
+
+  StrategyRunner(ThreadPool& thread_pool, media_proc_t media_proc,
+                 strategy_timeout_t timeout);
+  StrategyRunner(const StrategyRunner&) = delete;
+  ~StrategyRunner();
+
+  StrategyRunner& operator=(const StrategyRunner&) = delete;
+
+  // Returns the index of the task, which identifies its outcome.
+  size_t Submit(strategy_task_t task);
+
+  // Number of tasks whose outcomes have not been taken yet
+  size_t pending() const;
+
+  // Takes the outcome of a finished task. TryNext returns false if there is
+  // none yet, and WaitNext blocks until there is one, unless nothing is
+  // pending.
+  bool TryNext(size_t& index, StrategyOutcome& outcome);
+  bool WaitNext(size_t& index, StrategyOutcome& outcome);
+
+  // Calls `notify_proc` on a thread of the pool once an outcome is available.
+  // Returns false without doing so if one is available already, or if nothing
+  // is pending. Only one notification can be armed at a time.
+  bool NotifyNext(notify_proc_t notify_proc);
+
+private:
+  void Watch(std::stop_token stop_token);
+  bool TakeOutcome(size_t& index, StrategyOutcome& outcome);
+
+  ThreadPool& thread_pool_;
+  std::shared_ptr<StrategyRunnerState> state_;
+  std::jthread watchdog_;
+};
+
+// Running averages of the cost and yield of each strategy of each player, so
+// that the cheapest strategies can be tried first. Not thread-safe.
+class StrategyStats {
+public:
+  struct Entry {
+    double cost = 0.0;   // in microseconds
+    double yield = 0.0;  // rate of finding a file
+    uint64_t samples = 0;
+  };
+
+  void Record(std::string_view player, Strategy strategy, strategy_cost_t cost,
+              bool found_file);
+
+  // Orders strategies by the expected cost of finding a file, which is their
+  // average cost divided by their yield. A cheap strategy that rarely finds
+  // anything thus goes after a costlier one that usually does. Strategies
+  // that have not been measured yet come first, so that each one is measured
+  // at least once. Ties keep their original order.
+  void Sort(std::string_view player, std::vector<Strategy>& strategies) const;
+
+  Entry Get(std::string_view player, Strategy strategy) const;
+  void Clear();
+
+private:
+  // Weight of the newest sample, so that averages follow changes in the
+  // environment (e.g. a browser with more tabs).
+  static constexpr double kWeight = 0.25;
+  // Lower bound of the yield, so that strategies that have never found a file
+  // are still ordered by their cost.
+  static constexpr double kMinYield = 0.01;
+
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const {
+      return std::hash<std::string_view>{}(str);
+    }
+  };
+
+  using entries_t = std::array<Entry, kStrategyCount>;
+
+  std::unordered_map<std::string, entries_t, StringHash, std::equal_to<>>
+      players_;
+};
+
+}  // namespace detail
+
+}  // namespace anisthesia
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+
+namespace anisthesia::detail {
+
+// Fixed-size pool of worker threads that run submitted tasks in FIFO order.
+//
+// A pool without threads runs each task on the calling thread as soon as it is
+// submitted, so that callers need not special-case sequential execution.
+//
+// Some tasks may block indefinitely in calls that cannot be interrupted. Such
+// a task can be abandoned with Replace(), which starts another thread in place
+// of the worker that runs it. Threads are not joined on destruction: the pool
+// waits for idle and ordinary tasks to finish, while abandoned workers exit on
+// their own once their task returns.
+class ThreadPool {
+public:
+  using task_t = std::function<void()>;
+  using thread_proc_t = std::function<void()>;
+  using worker_id_t = uint64_t;
+
+  // `thread_begin` and `thread_end` are called on each worker thread before
+  // the first task and after the last one (e.g. to initialize COM).
+  explicit ThreadPool(size_t thread_count, thread_proc_t thread_begin = {},
+                      thread_proc_t thread_end = {});
+  ThreadPool(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t thread_count() const;
+
+  void Submit(task_t task);
+
+  // Identifies the worker that runs the calling task. Returns 0 on threads
+  // that are not workers (e.g. when the pool has no threads).
+  static worker_id_t CurrentWorker();
+
+  // Compensates for a worker that is stuck in an abandoned task. The worker
+  // exits instead of taking another task once its task returns.
+  void Replace(worker_id_t worker);
+
+private:
+  struct State {
+    std::mutex mutex;
+    std::condition_variable condition;       // tasks or stop
+    std::condition_variable exit_condition;  // threads exiting
+    std::deque<task_t> tasks;
+    bool stop = false;
+    size_t live_threads = 0;
+    std::set<worker_id_t> abandoned_workers;  // beyond the fixed size
+    thread_proc_t thread_begin;
+    thread_proc_t thread_end;
+  };
+
+  static void Work(std::shared_ptr<State> state, worker_id_t worker);
+  void StartThread();
+
+  const size_t thread_count_;
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace anisthesia::detail
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <anisthesia/media.hpp>
+#include <anisthesia/regex.hpp>
+
+namespace anisthesia {
+
+struct TitleCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  size_t size = 0;
+  size_t capacity = 0;
+};
+
+namespace detail {
+
+// Bounded LRU cache of window title extraction results. Titles rarely change
+// between polls, so most lookups can skip the regular expression entirely.
+//
+// Entries are keyed by the title format rather than the player, because the
+// result depends on nothing else. Raw titles are compared on lookup, so that
+// hash collisions cannot return a wrong result.
+class TitleCache {
+public:
+  struct Value {
+    bool formatted = false;  // ApplyWindowTitleFormat succeeded
+    std::string title;
+    MediaInfoType type = MediaInfoType::Unknown;
+  };
+
+  explicit TitleCache(size_t capacity = 256);
+
+  bool Lookup(std::string_view format, std::string_view raw_title,
+              Value& value);
+  void Insert(std::string_view format, std::string_view raw_title,
+              const Value& value);
+
+  void Clear();  // entries and statistics
+  void SetCapacity(size_t capacity);
+  TitleCacheStats stats() const;
+
+private:
+  struct Key {
+    size_t format_hash;
+    size_t title_hash;
+    bool operator==(const Key& other) const = default;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return key.format_hash ^ (key.title_hash + 0x9E3779B97F4A7C15 +
+                                (key.format_hash << 6) +
+                                (key.format_hash >> 2));
+    }
+  };
+
+  struct Entry {
+    Key key;
+    std::string format;
+    std::string raw_title;
+    Value value;
+  };
+
+  using list_t = std::list<Entry>;
+
+  static Key MakeKey(std::string_view format, std::string_view raw_title);
+  void Evict();
+
+  mutable std::mutex mutex_;
+  size_t capacity_;
+  list_t entries_;  // most recently used first
+  std::unordered_map<Key, list_t::iterator, KeyHash> map_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+// Compiled title formats, and the titles that were extracted with them. Owned
+// by a detector and shared with its strategies, which may outlive it.
+class TitleExtractor {
+public:
+  explicit TitleExtractor(size_t capacity = 256) : cache_(capacity) {}
+
+  // Applies the title format and infers the type of the result, or returns the
+  // previous result for the same format and title.
+  TitleCache::Value Extract(const std::string& format,
+                            const std::string& raw_title);
+
+  void Clear();
+  void SetCapacity(size_t capacity);
+  TitleCacheStats stats() const;
+
+private:
+  std::shared_ptr<const regex::Regex> GetRegex(const std::string& format);
+
+  std::mutex mutex_;
+  // Formats are compiled once. There is only a handful of them in the players
+  // file.
+  std::unordered_map<std::string, std::shared_ptr<const regex::Regex>>
+      regexes_;
+  TitleCache cache_;
+};
+
+// Used where there is no detector (e.g. by the free GetResults functions)
+TitleExtractor& GetDefaultTitleExtractor();
+
+}  // namespace detail
+
+}  // namespace anisthesia
@@ -1,13 +1,43 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace anisthesia::detail::util {
 
+// Read-only memory mapping of a whole file. The mapping is released when the
+// object is destroyed.
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  ~MappedFile();
+
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  bool Open(const std::string& path);
+  void Close();
+
+  const char* data() const;
+  size_t size() const;
+
+private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
 bool ReadFile(const std::string& path, std::string& data);
+bool WriteFile(const std::string& path, const std::string& data);
 
-bool EqualStrings(const std::string& str1, const std::string& str2);
+bool EqualStrings(std::string_view str1, std::string_view str2);
 bool TrimLeft(std::string& str, const char* chars);
 bool TrimRight(std::string& str, const char* chars);
 
+// Gets the percent-decoded path of a local "file://" URL. Returns false for
+// other URLs (e.g. those with a remote host).
+bool FileUrlToPath(std::string_view url, std::string& path);
+
 }  // namespace anisthesia::detail::util
@@ -1,11 +1,20 @@
 #pragma once
 
+#include <atomic>
+#include <compare>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <stop_token>
 #include <string>
 
 #include <windows.h>
 
+#include <anisthesia/open_file_cache.hpp>
+#include <anisthesia/platform.hpp>
+#include <anisthesia/win_util.hpp>
+
 namespace anisthesia::win::detail {
 
 struct OpenFile {
@@ -15,7 +24,46 @@ struct OpenFile {
 
 using open_file_proc_t = std::function<bool(const OpenFile&)>;
 
-bool EnumerateOpenFiles(const std::set<DWORD>& process_ids,
-                        open_file_proc_t open_file_proc);
+struct SnapshotBuffer {
+  std::unique_ptr<BYTE[]> data;
+  ULONG size = 0;
+};
+
+// Process IDs are reused, but not while the creation time is the same.
+// Handle values are reused as soon as they are closed, so the object address
+// is compared as well. It is zero where the system hides it, which leaves a
+// new file that is opened with the same handle value and access undetected
+// until the handle is closed.
+struct HandleKey {
+  ULONG_PTR handle_value;
+  ACCESS_MASK granted_access;
+  ULONG_PTR object;
+
+  auto operator<=>(const HandleKey&) const = default;
+};
+
+using OpenFileCache =
+    anisthesia::detail::OpenFileCache<ProcessKey, HandleKey, std::wstring>;
+
+// What is kept between enumerations. Owned by the platform.
+struct OpenFileState {
+  OpenFileCache cache;
+
+  // Snapshots of the handle table take megabytes on a busy system, so a buffer
+  // is kept between calls, unless it is larger than the limit.
+  std::mutex snapshot_mutex;
+  SnapshotBuffer spare_snapshot;
+  ULONG max_snapshot_size = 16 << 20;
+  std::atomic<ULONG> snapshot_size_hint = 1 << 20;
+
+  // Varies between OS versions, and is determined at run time
+  std::atomic<USHORT> file_type_index = 0;
+};
+
+bool EnumerateOpenFiles(OpenFileState& state,
+                        const std::set<DWORD>& process_ids,
+                        open_file_proc_t open_file_proc,
+                        const OpenFileFilter& filter,
+                        std::stop_token stop_token = {});
 
 }  // namespace anisthesia::win::detail
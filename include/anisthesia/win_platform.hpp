@@ -1,40 +1,65 @@
 #pragma once
 
-#include <string>
+#include <set>
+#include <stop_token>
 #include <vector>
 
-#include <windows.h>
-
-#include <anisthesia/media.hpp>
+#include <anisthesia/detector.hpp>
+#include <anisthesia/platform.hpp>
 #include <anisthesia/player.hpp>
+#include <anisthesia/player_table.hpp>
+#include <anisthesia/win_open_files.hpp>
+#include <anisthesia/win_ui_automation.hpp>
+#include <anisthesia/win_windows.hpp>
 
 namespace anisthesia::win {
 
-struct Process {
-  DWORD id = 0;
-  std::wstring name;
-};
+// Worker threads are initialized for COM, in the multithreaded apartment so
+// that they can share a single UI Automation interface.
+//
+// The interface, and what is learned about processes, their open files and the
+// elements of web browsers, is kept per platform.
+class WindowsPlatform final : public Platform {
+public:
+  bool EnumerateProcesses(process_proc_t process_proc) override;
+  bool EnumerateWindows(window_proc_t window_proc) override;
+  bool EnumerateOpenFiles(const std::set<process_id_t>& process_ids,
+                          open_file_proc_t open_file_proc,
+                          const OpenFileFilter& filter,
+                          std::stop_token stop_token = {}) override;
+  bool GetWebBrowserInformation(const Window& window,
+                                web_browser_proc_t web_browser_proc,
+                                std::stop_token stop_token = {}) override;
 
-struct Window {
-  HWND handle = nullptr;
-  std::wstring class_name;
-  std::wstring text;
-};
+  void InitializeThread() override;
+  void UninitializeThread() override;
+
+  void SetCacheLimits(const CacheLimits& limits) override;
+  void ClearCaches() override;
 
-struct Result {
-  Player player;
-  Process process;
-  Window window;
-  std::vector<Media> media;
+private:
+  detail::ProcessCache processes_;
+  detail::OpenFileState open_files_;
+  detail::UIAutomation ui_automation_;
+  detail::ElementPathCache web_browsers_;
 };
 
+// Detection through WindowsPlatform, as it was before the platform-independent
+// API was introduced. These share a platform, and its caches, for the lifetime
+// of the process.
 bool GetResults(const std::vector<Player>& players, media_proc_t media_proc,
                 std::vector<Result>& results);
+bool GetResults(const PlayerTable& players, media_proc_t media_proc,
+                std::vector<Result>& results);
+bool GetResults(const PlayerTable& players, const PlayerMatcher& matcher,
+                media_proc_t media_proc, std::vector<Result>& results);
 
-namespace detail {
-
-bool ApplyStrategies(media_proc_t media_proc, std::vector<Result>& results);
-
-}  // namespace detail
+using anisthesia::Detector;
+using anisthesia::DetectorOptions;
+using anisthesia::GetTitleCacheStats;
+using anisthesia::Process;
+using anisthesia::Result;
+using anisthesia::ResultStream;
+using anisthesia::Window;
 
 }  // namespace anisthesia::win
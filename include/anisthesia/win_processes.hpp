@@ -0,0 +1,9 @@
+#pragma once
+
+#include <anisthesia/platform.hpp>
+
+namespace anisthesia::win::detail {
+
+bool EnumerateProcesses(process_proc_t process_proc);
+
+}  // namespace anisthesia::win::detail
@@ -1,23 +1,39 @@
-#include <functional>
-#include <string>
+#pragma once
+
+#include <mutex>
+#include <stop_token>
 
 #include <windows.h>
+#include <unknwn.h>
+#include <uiautomation.h>
+
+#include <anisthesia/element_tree.hpp>
+#include <anisthesia/platform.hpp>
+#include <anisthesia/win_util.hpp>
 
 namespace anisthesia::win::detail {
 
-enum class WebBrowserInformationType {
-  Address,
-  Tab,
-  Title,
-};
+// The UI Automation interface, which is created on first use. Worker threads
+// share it, as they are in the multithreaded apartment.
+class UIAutomation {
+public:
+  // Returns a new reference, or nullptr if the interface cannot be created
+  ComInterface<IUIAutomation> Get();
+  void Reset();
+
+private:
+  static ComInterface<IUIAutomation> Create();
 
-struct WebBrowserInformation {
-  WebBrowserInformationType type = WebBrowserInformationType::Title;
-  std::wstring value;
+  std::mutex mutex_;
+  ComInterface<IUIAutomation> interface_;
 };
 
-using web_browser_proc_t = std::function<void(const WebBrowserInformation&)>;
+using anisthesia::detail::ElementPathCache;
 
-bool GetWebBrowserInformation(HWND hwnd, web_browser_proc_t web_browser_proc);
+// Searches the window through the element tree (see element_tree.hpp)
+bool GetWebBrowserInformation(UIAutomation& ui_automation,
+                              ElementPathCache& cache, const Window& window,
+                              web_browser_proc_t web_browser_proc,
+                              std::stop_token stop_token = {});
 
 }  // namespace anisthesia::win::detail
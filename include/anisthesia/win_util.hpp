@@ -1,12 +1,16 @@
 #pragma once
 
+#include <compare>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <type_traits>
 
 #include <windows.h>
 #include <unknwn.h>
 
+#include <anisthesia/path_trie.hpp>
+
 namespace anisthesia::win::detail {
 
 struct HandleDeleter {
@@ -31,9 +35,26 @@ using ComInterface = std::unique_ptr<T, ComInterfaceDeleter<T>>;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Process IDs are reused as soon as a process exits, so the creation time is
+// compared as well.
+struct ProcessKey {
+  DWORD process_id;
+  ULONGLONG creation_time;
+
+  auto operator<=>(const ProcessKey&) const = default;
+};
+
+// Returns 0 if the handle lacks PROCESS_QUERY_LIMITED_INFORMATION access
+ULONGLONG GetProcessCreationTime(HANDLE process_handle);
+
+////////////////////////////////////////////////////////////////////////////////
+
 std::wstring GetFileNameFromPath(const std::wstring& path);
 std::wstring GetFileNameWithoutExtension(const std::wstring& filename);
-bool IsSystemDirectory(const std::wstring& path);
+
+// Directories whose files are never media, i.e. %windir%. Built once.
+const anisthesia::detail::WidePathTrie& GetSystemDirectories();
+bool IsSystemDirectory(std::wstring_view path);
 
 std::string ToUtf8String(const std::wstring& str);
 
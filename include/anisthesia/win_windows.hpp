@@ -1,18 +1,22 @@
 #pragma once
 
-#include <functional>
+#include <string>
 
-namespace anisthesia::win {
+#include <anisthesia/platform.hpp>
+#include <anisthesia/process_cache.hpp>
+#include <anisthesia/win_util.hpp>
 
-struct Process;
-struct Window;
+namespace anisthesia::win::detail {
 
-namespace detail {
+struct ProcessInfo {
+  std::wstring path;
+  std::string name;    // without extension
+  bool valid = false;  // not a system process
+};
 
-using window_proc_t = std::function<bool(const Process&, const Window&)>;
+using ProcessCache =
+    anisthesia::detail::ProcessCache<ProcessKey, ProcessInfo>;
 
-bool EnumerateWindows(window_proc_t window_proc);
+bool EnumerateWindows(ProcessCache& cache, window_proc_t window_proc);
 
-}  // namespace detail
-
-}  // namespace anisthesia::win
+}  // namespace anisthesia::win::detail
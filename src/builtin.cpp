@@ -0,0 +1,38 @@
+#include <span>
+
+#include <anisthesia/builtin.hpp>
+#include <anisthesia/player.hpp>
+
+#ifdef ANISTHESIA_BUILTIN_PLAYERS
+#include <anisthesia/builtin_players_data.hpp>
+#endif
+
+namespace anisthesia {
+
+Player BuiltinPlayer::ToPlayer() const {
+  Player player;
+  player.type = type;
+  player.name = name;
+  player.window_title_format = window_title_format;
+  player.windows.assign(windows.begin(), windows.end());
+  player.executables.assign(executables.begin(), executables.end());
+  for (const auto strategy : {Strategy::WindowTitle, Strategy::OpenFiles,
+                              Strategy::UiAutomation, Strategy::Mpris}) {
+    if (has_strategy(strategy))
+      player.strategies.push_back(strategy);
+  }
+  if (has_option(PlayerOption::Exhaustive))
+    player.options.push_back(PlayerOption::Exhaustive);
+  player.extensions.assign(extensions.begin(), extensions.end());
+  return player;
+}
+
+std::span<const BuiltinPlayer> GetBuiltinPlayers() {
+#ifdef ANISTHESIA_BUILTIN_PLAYERS
+  return detail::builtin::kPlayers;
+#else
+  return {};
+#endif
+}
+
+}  // namespace anisthesia
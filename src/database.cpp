@@ -0,0 +1,206 @@
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <anisthesia/database.hpp>
+#include <anisthesia/player.hpp>
+#include <anisthesia/player_table.hpp>
+
+namespace anisthesia {
+
+namespace detail {
+
+#ifdef __linux__
+
+// Editors often save by writing a temporary file and renaming it over the
+// original, which would drop a watch on the file itself. Watching the
+// directory catches both in-place writes and replacements.
+class FileWatcher {
+public:
+  ~FileWatcher() {
+    if (stop_fd_ >= 0)
+      ::close(stop_fd_);
+    if (inotify_fd_ >= 0)
+      ::close(inotify_fd_);
+  }
+
+  bool Open(const std::string& path) {
+    const std::filesystem::path file_path = path;
+    auto directory = file_path.parent_path();
+    if (directory.empty())
+      directory = ".";
+    filename_ = file_path.filename().string();
+
+    inotify_fd_ = ::inotify_init1(IN_CLOEXEC);
+    stop_fd_ = ::eventfd(0, EFD_CLOEXEC);
+    if (inotify_fd_ < 0 || stop_fd_ < 0)
+      return false;
+
+    return ::inotify_add_watch(inotify_fd_, directory.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO) >= 0;
+  }
+
+  // Blocks until the file changes (returns true) or stop is requested
+  // (returns false).
+  bool Wait(std::stop_token stop_token) {
+    std::stop_callback stop_callback(stop_token, [this]() {
+      const uint64_t value = 1;
+      [[maybe_unused]] const auto result =
+          ::write(stop_fd_, &value, sizeof(value));
+    });
+
+    alignas(inotify_event) char buffer[4096];
+    pollfd fds[] = {{inotify_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+
+    while (!stop_token.stop_requested()) {
+      if (::poll(fds, 2, -1) < 0)
+        continue;
+      if (fds[1].revents & POLLIN)
+        break;
+      if (!(fds[0].revents & POLLIN))
+        continue;
+
+      const auto length = ::read(inotify_fd_, buffer, sizeof(buffer));
+      if (length <= 0)
+        continue;
+
+      bool changed = false;
+      for (ssize_t offset = 0; offset < length; ) {
+        const auto& event = *reinterpret_cast<inotify_event*>(buffer + offset);
+        if (event.len && filename_ == event.name)
+          changed = true;
+        offset += sizeof(inotify_event) + event.len;
+      }
+      if (changed)
+        return true;
+    }
+
+    return false;
+  }
+
+private:
+  std::string filename_;
+  int inotify_fd_ = -1;
+  int stop_fd_ = -1;
+};
+
+#else
+
+// Polls the modification time of the file at a fixed interval.
+class FileWatcher {
+public:
+  bool Open(const std::string& path) {
+    path_ = path;
+    last_write_time_ = std::filesystem::last_write_time(path_, error_);
+    return !error_;
+  }
+
+  bool Wait(std::stop_token stop_token) {
+    constexpr auto kInterval = std::chrono::seconds(1);
+
+    std::mutex mutex;
+    std::condition_variable_any condition;
+
+    while (!stop_token.stop_requested()) {
+      {
+        std::unique_lock lock(mutex);
+        condition.wait_for(lock, stop_token, kInterval, [] { return false; });
+      }
+      if (stop_token.stop_requested())
+        break;
+
+      const auto write_time = std::filesystem::last_write_time(path_, error_);
+      if (!error_ && write_time != last_write_time_) {
+        last_write_time_ = write_time;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  std::filesystem::path path_;
+  std::filesystem::file_time_type last_write_time_;
+  std::error_code error_;
+};
+
+#endif
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+
+PlayersDatabase::~PlayersDatabase() {
+  Unwatch();
+}
+
+bool PlayersDatabase::Load(const std::string& path) {
+  Unwatch();
+  path_ = path;
+  return Reload();
+}
+
+bool PlayersDatabase::Reload() {
+  std::vector<Player> players;
+
+  if (!ParsePlayersFile(path_, players))
+    return false;
+
+  players_.store(std::make_shared<const PlayerTable>(players));
+  ++generation_;
+
+  return true;
+}
+
+bool PlayersDatabase::Watch() {
+  if (path_.empty())
+    return false;
+
+  if (thread_.joinable())
+    return true;
+
+  // The watcher is set up before returning, so that no change made after
+  // this call can be missed.
+  auto watcher = std::make_unique<detail::FileWatcher>();
+  if (!watcher->Open(path_))
+    return false;
+
+  thread_ = std::jthread(
+      [this, watcher = std::move(watcher)](std::stop_token stop_token) {
+        while (watcher->Wait(stop_token)) {
+          Reload();
+        }
+      });
+
+  return true;
+}
+
+void PlayersDatabase::Unwatch() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    thread_.join();
+  }
+}
+
+PlayersDatabase::table_t PlayersDatabase::Get() const {
+  return players_.load();
+}
+
+uint64_t PlayersDatabase::generation() const {
+  return generation_.load();
+}
+
+}  // namespace anisthesia
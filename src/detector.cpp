@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/database.hpp>
+#include <anisthesia/detector.hpp>
+#include <anisthesia/generator.hpp>
+#include <anisthesia/matcher.hpp>
+#include <anisthesia/media.hpp>
+#include <anisthesia/platform.hpp>
+#include <anisthesia/player.hpp>
+#include <anisthesia/player_table.hpp>
+
+namespace anisthesia {
+
+bool GetResults(Platform& platform, const std::vector<Player>& players,
+                media_proc_t media_proc, std::vector<Result>& results) {
+  return GetResults(platform, PlayerTable(players), media_proc, results);
+}
+
+bool GetResults(Platform& platform, const PlayerTable& players,
+                media_proc_t media_proc, std::vector<Result>& results) {
+  return GetResults(platform, players, PlayerMatcher(players), media_proc,
+                    results);
+}
+
+bool GetResults(Platform& platform, const PlayerTable& players,
+                const PlayerMatcher& matcher, media_proc_t media_proc,
+                std::vector<Result>& results) {
+  if (!detail::EnumerateResults(platform, players, matcher, results))
+    return false;
+
+  // Strategies run on the calling thread, so the platform is not shared
+  const detail::PlayerExtensionSets extensions(GetDefaultMediaExtensions(),
+                                               players);
+  detail::StrategyEnvironment environment;
+  environment.platform = std::shared_ptr<Platform>(std::shared_ptr<Platform>(),
+                                                   &platform);
+  environment.extensions = &extensions;
+  if (!detail::ApplyStrategies(media_proc, results, environment))
+    return false;
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Detector::Detector(PlayerTable players, DetectorOptions options)
+    : Detector(CreateNativePlatform(), std::move(players),
+               std::move(options)) {}
+
+Detector::Detector(std::shared_ptr<Platform> platform, PlayerTable players,
+                   DetectorOptions options)
+    : platform_(std::move(platform)), players_(std::move(players)),
+      matcher_(players_),
+      strategy_timeout_(options.strategy_timeout),
+      media_extensions_(std::move(options.media_extensions)),
+      extensions_(media_extensions_, players_),
+      titles_(std::make_shared<detail::TitleExtractor>(
+          options.cache_limits.titles)) {
+  platform_->SetCacheLimits(options.cache_limits);
+
+  if (!options.excluded_directories.empty()) {
+    auto excluded_directories = std::make_shared<detail::PathTrie>();
+    for (const auto& directory : options.excluded_directories) {
+      excluded_directories->Insert(directory);
+    }
+    excluded_directories_ = std::move(excluded_directories);
+  }
+
+  // Worker threads are prepared for the platform (e.g. for COM on Windows)
+  thread_pool_ = std::make_unique<detail::ThreadPool>(
+      options.worker_count,
+      [platform = platform_]() { platform->InitializeThread(); },
+      [platform = platform_]() { platform->UninitializeThread(); });
+}
+
+Detector::Detector(std::shared_ptr<const PlayersDatabase> database,
+                   DetectorOptions options)
+    : Detector(CreateNativePlatform(), std::move(database),
+               std::move(options)) {}
+
+Detector::Detector(std::shared_ptr<Platform> platform,
+                   std::shared_ptr<const PlayersDatabase> database,
+                   DetectorOptions options)
+    : Detector(std::move(platform), PlayerTable(), std::move(options)) {
+  database_ = std::move(database);
+  UpdatePlayers();
+}
+
+bool Detector::GetResults(media_proc_t media_proc,
+                          std::vector<Result>& results) {
+  UpdatePlayers();
+  if (!detail::EnumerateResults(*platform_, players_, matcher_, results))
+    return false;
+
+  if (!detail::ApplyStrategies(media_proc, results, *thread_pool_,
+                               strategy_timeout_, &strategy_stats_,
+                               environment())) {
+    return false;
+  }
+
+  return true;
+}
+
+Generator<Result> Detector::Stream(media_proc_t media_proc) {
+  UpdatePlayers();
+
+  std::vector<Result> results;
+  if (!detail::EnumerateResults(*platform_, players_, matcher_, results))
+    co_return;
+
+  detail::StrategyScheduler scheduler(std::move(results), std::move(media_proc),
+                                      *thread_pool_, strategy_timeout_,
+                                      &strategy_stats_, environment());
+
+  size_t index = 0;
+  while (scheduler.Next(index, true)) {
+    co_yield std::move(scheduler.results()[index]);
+  }
+}
+
+ResultStream Detector::StreamAsync(media_proc_t media_proc,
+                                   executor_t executor) {
+  UpdatePlayers();
+
+  std::vector<Result> results;
+  if (!detail::EnumerateResults(*platform_, players_, matcher_, results))
+    results.clear();
+
+  return ResultStream(
+      std::make_unique<detail::StrategyScheduler>(
+          std::move(results), std::move(media_proc), *thread_pool_,
+          strategy_timeout_, &strategy_stats_, environment()),
+      std::move(executor));
+}
+
+bool Detector::Poll(media_proc_t media_proc, ChangeSet& changes) {
+  changes = {};
+
+  UpdatePlayers();
+
+  std::vector<Result> results;
+  if (!detail::EnumerateResults(*platform_, players_, matcher_, results))
+    return false;
+
+  // Windows that have not changed take their media from the previous poll,
+  // and the others are detected again. Strategies of a player may have
+  // changed along with the players.
+  std::vector<Result> pending;
+  std::vector<size_t> pending_indices;
+  const auto snapshot_index = detail::IndexWindows(snapshot_);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto* previous = detail::FindWindow(snapshot_index, results[i]);
+    if (!players_changed_ && previous &&
+        detail::IsSameWindow(*previous, results[i]) &&
+        !detail::HasTimedOut(*previous) && !detail::HasLiveMedia(*previous)) {
+      results[i].media = previous->media;
+      results[i].strategies = previous->strategies;
+    } else {
+      pending.push_back(std::move(results[i]));
+      pending_indices.push_back(i);
+    }
+  }
+
+  if (!pending.empty()) {
+    detail::ApplyStrategies(media_proc, pending, *thread_pool_,
+                            strategy_timeout_, &strategy_stats_,
+                            environment());
+    for (size_t i = 0; i < pending.size(); ++i) {
+      results[pending_indices[i]] = std::move(pending[i]);
+    }
+  }
+
+  // Positions were read as strategies were applied
+  const auto now = std::chrono::steady_clock::now();
+  detail::DiffResults(
+      snapshot_, results,
+      std::chrono::duration_cast<media_time_t>(now - snapshot_time_), changes);
+  snapshot_ = std::move(results);
+  snapshot_time_ = now;
+  players_changed_ = false;
+
+  return true;
+}
+
+void Detector::Reset() {
+  snapshot_.clear();
+  strategy_stats_.Clear();
+  titles_->Clear();
+  platform_->ClearCaches();
+}
+
+void Detector::SetPlayers(PlayerTable players) {
+  players_ = std::move(players);
+  matcher_ = PlayerMatcher(players_);
+  extensions_ = detail::PlayerExtensionSets(media_extensions_, players_);
+  players_changed_ = true;
+}
+
+void Detector::SetCacheLimits(const CacheLimits& limits) {
+  titles_->SetCapacity(limits.titles);
+  platform_->SetCacheLimits(limits);
+}
+
+const detail::StrategyStats& Detector::strategy_stats() const {
+  return strategy_stats_;
+}
+
+TitleCacheStats Detector::title_cache_stats() const {
+  return titles_->stats();
+}
+
+detail::StrategyEnvironment Detector::environment() const {
+  return {platform_, &extensions_, excluded_directories_, titles_};
+}
+
+void Detector::UpdatePlayers() {
+  if (!database_)
+    return;
+
+  // The table is at least as new as the generation, as it is published first
+  const auto generation = database_->generation();
+  if (generation == generation_)
+    return;
+
+  if (const auto players = database_->Get())
+    SetPlayers(*players);
+  generation_ = generation;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ResultStream::ResultStream(
+    std::unique_ptr<detail::StrategyScheduler> scheduler, executor_t executor)
+    : scheduler_(std::move(scheduler)), executor_(std::move(executor)) {}
+
+ResultStream::ResultStream(ResultStream&&) noexcept = default;
+ResultStream::~ResultStream() = default;
+
+ResultStream& ResultStream::operator=(ResultStream&&) noexcept = default;
+
+ResultStream::Awaitable ResultStream::Next() {
+  return Awaitable(*this);
+}
+
+bool ResultStream::TryTake(std::optional<Result>& result) {
+  size_t index = 0;
+  if (scheduler_->Next(index, false)) {
+    result = std::move(scheduler_->results()[index]);
+    return true;
+  }
+  return scheduler_->done();
+}
+
+void ResultStream::Post(std::function<void()> proc) {
+  if (executor_) {
+    executor_(std::move(proc));
+  } else {
+    proc();
+  }
+}
+
+bool ResultStream::Awaitable::await_ready() {
+  return stream_.TryTake(result_);
+}
+
+void ResultStream::Awaitable::await_suspend(std::coroutine_handle<> handle) {
+  handle_ = handle;
+  Arm();
+}
+
+std::optional<Result> ResultStream::Awaitable::await_resume() {
+  return std::move(result_);
+}
+
+void ResultStream::Awaitable::Arm() {
+  // Outcomes are processed through the executor rather than on the thread
+  // that reports them, because processing may submit further strategies.
+  auto step = [this]() { stream_.Post([this]() { Step(); }); };
+  if (!stream_.scheduler_->NotifyNext(step))
+    step();
+}
+
+void ResultStream::Awaitable::Step() {
+  // An outcome may not complete a result by itself (e.g. if another strategy
+  // is to be applied next), in which case the next one is awaited.
+  if (stream_.TryTake(result_)) {
+    handle_.resume();
+  } else {
+    Arm();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+window_index_t IndexWindows(const std::vector<Result>& results) {
+  window_index_t index;
+  index.reserve(results.size());
+  for (const auto& result : results) {
+    index.emplace(result.window.handle, &result);
+  }
+  return index;
+}
+
+const Result* FindWindow(const window_index_t& index, const Result& result) {
+  const auto it = index.find(result.window.handle);
+  return it != index.end() ? it->second : nullptr;
+}
+
+bool IsSameWindow(const Result& a, const Result& b) {
+  return a.window.handle == b.window.handle &&
+         a.window.class_name == b.window.class_name &&
+         a.window.text == b.window.text && a.process.id == b.process.id &&
+         a.player.name == b.player.name;
+}
+
+bool HasTimedOut(const Result& result) {
+  for (const auto& strategy : result.strategies) {
+    if (strategy.status == StrategyStatus::TimedOut)
+      return true;
+  }
+  return false;
+}
+
+bool IsSameMedia(const Media& previous, const Media& current,
+                 media_time_t elapsed) {
+  if (previous.information != current.information ||
+      previous.state != current.state ||
+      previous.duration != current.duration || previous.rate != current.rate) {
+    return false;
+  }
+
+  auto position = previous.position;
+  if (previous.state == MediaState::Playing) {
+    position += std::chrono::duration_cast<media_time_t>(elapsed *
+                                                         previous.rate);
+    if (previous.duration > media_time_t::zero())
+      position = std::min(position, previous.duration);
+  }
+
+  const auto difference = current.position - position;
+  return std::chrono::abs(difference) <= kPositionTolerance;
+}
+
+bool HasLiveMedia(const Result& result) {
+  for (const auto& strategy : result.strategies) {
+    if (strategy.strategy == Strategy::Mpris &&
+        strategy.status == StrategyStatus::Found) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DiffResults(const std::vector<Result>& previous,
+                 const std::vector<Result>& current, media_time_t elapsed,
+                 ChangeSet& changes) {
+  auto contains_previous = [elapsed](const std::vector<Media>& media,
+                                     const Media& item) {
+    return std::any_of(media.begin(), media.end(), [&](const Media& m) {
+      return IsSameMedia(m, item, elapsed);
+    });
+  };
+  auto contains_current = [elapsed](const std::vector<Media>& media,
+                                    const Media& item) {
+    return std::any_of(media.begin(), media.end(), [&](const Media& m) {
+      return IsSameMedia(item, m, elapsed);
+    });
+  };
+
+  const auto previous_index = IndexWindows(previous);
+  const auto current_index = IndexWindows(current);
+
+  for (const auto& result : current) {
+    const auto* previous_result = FindWindow(previous_index, result);
+    if (!previous_result || previous_result->process.id != result.process.id ||
+        previous_result->player.name != result.player.name) {
+      changes.appeared.push_back(result);
+      continue;
+    }
+
+    ResultChange change;
+    for (const auto& item : result.media) {
+      if (!contains_previous(previous_result->media, item))
+        change.added.push_back(item);
+    }
+    for (const auto& item : previous_result->media) {
+      if (!contains_current(result.media, item))
+        change.removed.push_back(item);
+    }
+    if (!change.added.empty() || !change.removed.empty()) {
+      change.result = result;
+      changes.changed.push_back(std::move(change));
+    }
+  }
+
+  for (const auto& result : previous) {
+    const auto* current_result = FindWindow(current_index, result);
+    if (!current_result || current_result->process.id != result.process.id ||
+        current_result->player.name != result.player.name) {
+      changes.disappeared.push_back(result);
+    }
+  }
+}
+
+bool EnumerateResults(Platform& platform, const PlayerTable& players,
+                      const PlayerMatcher& matcher,
+                      std::vector<Result>& results) {
+  // Only players that match a window are expanded into a full Player object.
+  auto window_proc = [&](const Process& process, const Window& window) -> bool {
+    const auto index = matcher.Match(window.class_name, process.name);
+    if (index != PlayerMatcher::npos)
+      results.push_back({players[index].ToPlayer(), process, window, {}, {}});
+    return true;
+  };
+
+  return platform.EnumerateWindows(window_proc);
+}
+
+}  // namespace detail
+
+}  // namespace anisthesia
@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/element_tree.hpp>
+#include <anisthesia/platform.hpp>
+
+namespace anisthesia::detail {
+
+bool ElementPathCache::Find(const Key& key, WebBrowserElementPaths& paths) {
+  std::lock_guard lock(mutex_);
+
+  const auto it = entries_.find(key);
+  if (it == entries_.end())
+    return false;
+
+  it->second.last_use = ++use_count_;
+  paths = it->second.paths;
+  return true;
+}
+
+void ElementPathCache::Insert(const Key& key, WebBrowserElementPaths paths) {
+  std::lock_guard lock(mutex_);
+  entries_.insert_or_assign(key, Entry{std::move(paths), ++use_count_});
+  Evict();
+}
+
+void ElementPathCache::Erase(const Key& key) {
+  std::lock_guard lock(mutex_);
+  entries_.erase(key);
+}
+
+void ElementPathCache::Clear() {
+  std::lock_guard lock(mutex_);
+  entries_.clear();
+}
+
+void ElementPathCache::SetCapacity(size_t capacity) {
+  std::lock_guard lock(mutex_);
+  capacity_ = capacity;
+  Evict();
+}
+
+size_t ElementPathCache::size() const {
+  std::lock_guard lock(mutex_);
+  return entries_.size();
+}
+
+void ElementPathCache::Evict() {
+  while (entries_.size() > capacity_) {
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.last_use < oldest->second.last_use)
+        oldest = it;
+    }
+    entries_.erase(oldest);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class MemoryElementAdapter final : public Element {
+public:
+  MemoryElementAdapter(const MemoryElement& element,
+                       const std::vector<MemoryElement>* siblings,
+                       size_t index, std::atomic<uint64_t>* calls)
+      : element_(element), siblings_(siblings), index_(index),
+        calls_(calls) {}
+
+  ElementType type() override {
+    Count();
+    return element_.type;
+  }
+
+  std::string name() override {
+    Count();
+    return element_.name;
+  }
+
+  std::string value() override {
+    Count();
+    return element_.value;
+  }
+
+  bool GetProperty(ElementProperty property, bool& value) override {
+    Count();
+    const auto it = element_.properties.find(property);
+    if (it == element_.properties.end())
+      return false;
+    value = it->second;
+    return true;
+  }
+
+  std::unique_ptr<Element> FirstChild() override {
+    Count();
+    if (element_.children.empty())
+      return nullptr;
+    return std::make_unique<MemoryElementAdapter>(
+        element_.children.front(), &element_.children, 0, calls_);
+  }
+
+  std::unique_ptr<Element> NextSibling() override {
+    Count();
+    if (!siblings_ || index_ + 1 >= siblings_->size())
+      return nullptr;
+    return std::make_unique<MemoryElementAdapter>(
+        (*siblings_)[index_ + 1], siblings_, index_ + 1, calls_);
+  }
+
+private:
+  void Count() {
+    if (calls_)
+      ++*calls_;
+  }
+
+  const MemoryElement& element_;
+  const std::vector<MemoryElement>* siblings_;
+  size_t index_;
+  std::atomic<uint64_t>* calls_;
+};
+
+std::unique_ptr<Element> CreateMemoryElement(const MemoryElement& root,
+                                             std::atomic<uint64_t>* calls) {
+  return std::make_unique<MemoryElementAdapter>(root, nullptr, 0, calls);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+enum class WalkAction {
+  Skip,     // the children of the element
+  Descend,
+  Stop,     // the whole walk
+};
+
+using element_proc_t =
+    std::function<WalkAction(Element&, const ElementPath& path)>;
+
+bool VerifyElementProperties(
+    Element& element,
+    std::initializer_list<std::pair<ElementProperty, bool>> properties) {
+  for (const auto& [property, expected] : properties) {
+    bool value = false;
+    if (!element.GetProperty(property, value) || value != expected)
+      return false;
+  }
+
+  return true;
+}
+
+bool IsAddressBarElement(Element& element) {
+  return VerifyElementProperties(element, {
+    {ElementProperty::IsEnabled, true},
+    {ElementProperty::IsKeyboardFocusable, true},
+    {ElementProperty::IsValuePatternAvailable, true},
+    {ElementProperty::ValueIsReadOnly, false},
+  });
+}
+
+bool IsTabsElement(Element& element) {
+  return VerifyElementProperties(element, {
+    {ElementProperty::ValueIsReadOnly, true},
+  });
+}
+
+// Returns false if the walk was stopped
+bool WalkElements(Element& parent, ElementPath& path, size_t depth,
+                  const element_proc_t& element_proc,
+                  const std::stop_token& stop_token) {
+  constexpr size_t kMaxTreeDepth = 16;  // arbitrary value
+  if (depth > kMaxTreeDepth)
+    return true;
+
+  path.push_back(0);
+
+  for (auto element = parent.FirstChild(); element;
+       element = element->NextSibling(), ++path.back()) {
+    // Each call crosses into the browser process, which may be busy.
+    if (stop_token.stop_requested()) {
+      path.pop_back();
+      return false;
+    }
+
+    const auto action = element_proc(*element, path);
+    if (action == WalkAction::Stop ||
+        (action == WalkAction::Descend &&
+         !WalkElements(*element, path, depth + 1, element_proc,
+                       stop_token))) {
+      path.pop_back();
+      return false;
+    }
+  }
+
+  path.pop_back();
+  return true;
+}
+
+bool WalkElements(Element& root, const element_proc_t& element_proc,
+                  const std::stop_token& stop_token) {
+  ElementPath path;
+  const auto action = element_proc(root, path);
+  if (action != WalkAction::Descend)
+    return action != WalkAction::Stop;
+  return WalkElements(root, path, 0, element_proc, stop_token);
+}
+
+std::unique_ptr<Element> GetElementAtPath(Element& root,
+                                          const ElementPath& path,
+                                          const std::stop_token& stop_token) {
+  std::unique_ptr<Element> element;
+  Element* parent = &root;
+
+  for (const auto index : path) {
+    auto child = parent->FirstChild();
+    for (uint32_t i = 0; i < index && child; ++i) {
+      if (stop_token.stop_requested())
+        return nullptr;
+      child = child->NextSibling();
+    }
+    if (!child)
+      return nullptr;
+    element = std::move(child);
+    parent = element.get();
+  }
+
+  return element;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+WalkAction CollectTabs(Element& element, std::vector<std::string>& tabs) {
+  switch (element.type()) {
+    case ElementType::TabItem:
+      tabs.push_back(element.name());
+      return WalkAction::Skip;
+    case ElementType::Other:
+      return WalkAction::Descend;
+    default:
+      return WalkAction::Skip;
+  }
+}
+
+// Reads the element that the path leads to, if it is still what it was when
+// the path was found
+bool ReadAddressElement(Element& root, const ElementPath& path,
+                        std::string& address,
+                        const std::stop_token& stop_token) {
+  if (path.empty())
+    return false;
+
+  const auto element = GetElementAtPath(root, path, stop_token);
+  if (!element || element->type() != ElementType::Edit ||
+      !IsAddressBarElement(*element)) {
+    return false;
+  }
+
+  address = element->value();
+  return true;
+}
+
+bool ReadTabsElement(Element& root, const ElementPath& path,
+                     std::vector<std::string>& tabs,
+                     const std::stop_token& stop_token) {
+  if (path.empty())
+    return false;
+
+  const auto element = GetElementAtPath(root, path, stop_token);
+  if (!element || element->type() != ElementType::Tab ||
+      !IsTabsElement(*element)) {
+    return false;
+  }
+
+  auto element_proc = [&tabs](Element& element, const ElementPath&) {
+    return CollectTabs(element, tabs);
+  };
+  ElementPath tab_path;
+  WalkElements(*element, tab_path, 0, element_proc, stop_token);
+  return true;
+}
+
+bool FindWebBrowserElements(Element& root, WebBrowserElementPaths& paths,
+                            std::string& address,
+                            std::vector<std::string>& tabs,
+                            std::stop_token stop_token) {
+  // Elements that the last walk did not find are not walked for again until
+  // a while later
+  const auto now = std::chrono::steady_clock::now();
+  const bool walk_for_missing =
+      paths.walked == std::chrono::steady_clock::time_point{} ||
+      now - paths.walked >= kElementWalkInterval;
+
+  const bool find_address =
+      !ReadAddressElement(root, paths.address, address, stop_token) &&
+      (!paths.address.empty() || walk_for_missing);
+  const bool find_tabs =
+      !ReadTabsElement(root, paths.tabs, tabs, stop_token) &&
+      (!paths.tabs.empty() || walk_for_missing);
+
+  // Paths that could not be followed to the end are not known to be wrong
+  if (stop_token.stop_requested())
+    return false;
+  if (!find_address && !find_tabs)
+    return true;
+
+  if (find_address) {
+    address.clear();
+    paths.address.clear();
+  }
+  if (find_tabs) {
+    tabs.clear();
+    paths.tabs.clear();
+  }
+
+  // Tabs are collected from the first tab strip, until a sibling of it
+  // is reached.
+  bool in_tabs = false;
+
+  auto element_proc = [&](Element& element,
+                          const ElementPath& path) -> WalkAction {
+    if (in_tabs && (path.size() <= paths.tabs.size() ||
+                    !std::equal(paths.tabs.begin(), paths.tabs.end(),
+                                path.begin()))) {
+      in_tabs = false;
+    }
+
+    switch (element.type()) {
+      default:
+        // Are we done?
+        if ((!find_address || !paths.address.empty()) &&
+            (!find_tabs || !paths.tabs.empty()) && !in_tabs) {
+          return WalkAction::Stop;
+        }
+        // Otherwise continue descending the tree.
+        return WalkAction::Descend;
+
+      case ElementType::Document:
+      case ElementType::MenuBar:
+      case ElementType::TitleBar:
+        // We do not need to walk through these nodes. In fact, skipping
+        // documents dramatically improves our performance on worst case
+        // scenarios. This is the whole reason we are walking the tree rather
+        // than searching it.
+        return WalkAction::Skip;
+
+      case ElementType::Edit:
+        // Here we assume that the first edit control that fits our properties
+        // is the address bar (e.g. "Omnibox" on Chrome, "Awesome Bar" on
+        // Firefox). This element is named differently on each web browser
+        // (e.g. "Address and search bar" on Chrome, "Search or enter address"
+        // on Firefox). This name can change depending on the browser
+        // language. However, we are only interested in the element value,
+        // which usually gives us the URL of the current page.
+        if (paths.address.empty() && find_address &&
+            IsAddressBarElement(element)) {
+          address = element.value();
+          paths.address = path;
+          return WalkAction::Skip;
+        } else {
+          // Opera has an edit control ("Address field") within another edit
+          // control ("Address bar").
+          return WalkAction::Descend;
+        }
+
+      case ElementType::Tab:
+        if (paths.tabs.empty() && find_tabs && IsTabsElement(element)) {
+          paths.tabs = path;
+          in_tabs = true;
+          return WalkAction::Descend;
+        }
+        return WalkAction::Skip;
+
+      case ElementType::TabItem:
+        if (find_tabs)
+          tabs.push_back(element.name());
+        return WalkAction::Skip;
+    }
+  };
+
+  // A walk that was stopped may have missed what it did not find
+  WalkElements(root, element_proc, stop_token);
+  paths.walked = stop_token.stop_requested()
+                     ? std::chrono::steady_clock::time_point{}
+                     : now;
+  return true;
+}
+
+bool GetWebBrowserInformation(Element& root, const Window& window,
+                              ElementPathCache& cache,
+                              web_browser_proc_t web_browser_proc,
+                              std::stop_token stop_token) {
+  if (!web_browser_proc)
+    return false;
+
+  web_browser_proc({WebBrowserInformationType::Title, root.name()});
+
+  const ElementPathCache::Key key{window.handle, window.class_name};
+  WebBrowserElementPaths paths;
+  cache.Find(key, paths);
+
+  std::string address;
+  std::vector<std::string> tabs;
+
+  if (!FindWebBrowserElements(root, paths, address, tabs, stop_token))
+    return false;
+
+  // Kept even if nothing was found, so that the tree is not walked again on
+  // every poll
+  cache.Insert(key, std::move(paths));
+
+  web_browser_proc({WebBrowserInformationType::Address, address});
+  for (const auto& tab : tabs) {
+    web_browser_proc({WebBrowserInformationType::Tab, tab});
+  }
+
+  return true;
+}
+
+}  // namespace anisthesia::detail
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <anisthesia/extension_set.hpp>
+#include <anisthesia/player_table.hpp>
+
+namespace anisthesia {
+
+std::vector<std::string> GetDefaultMediaExtensions() {
+  return {
+      "3gp", "asf",  "avi", "divx", "f4v",  "flv", "m2ts", "m4v",
+      "mkv", "mov",  "mp4", "mpeg", "mpg",  "mts", "ogm",  "ogv",
+      "rm",  "rmvb", "ts",  "vob",  "webm", "wmv",
+  };
+}
+
+namespace detail {
+
+namespace {
+
+char ToLowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+// Lowercase, without the leading dot. Returns false for extensions that can
+// never match.
+bool NormalizeExtension(std::string_view extension, std::string& output) {
+  if (extension.starts_with('.'))
+    extension.remove_prefix(1);
+  if (extension.empty() || extension.size() > ExtensionSet::kMaxLength)
+    return false;
+
+  output.clear();
+  for (const auto c : extension) {
+    output += ToLowerAscii(c);
+  }
+  return true;
+}
+
+template <typename CharT>
+bool ContainsPathImpl(const ExtensionSet& set,
+                      std::basic_string_view<CharT> path) {
+  const auto pos = path.find_last_of(static_cast<CharT>('.'));
+  if (pos == path.npos || path.size() - pos - 1 > ExtensionSet::kMaxLength)
+    return false;
+
+  std::array<char, ExtensionSet::kMaxLength> buffer;
+  size_t length = 0;
+  for (const auto c : path.substr(pos + 1)) {
+    // Extensions in the set are ASCII, and never contain separators
+    if (c < 0x21 || c > 0x7E || c == '/' || c == '\\')
+      return false;
+    buffer[length++] = static_cast<char>(c);
+  }
+
+  return set.Contains(std::string_view(buffer.data(), length));
+}
+
+}  // namespace
+
+ExtensionSet::ExtensionSet(const std::vector<std::string>& extensions) {
+  std::vector<std::string> keys;
+  std::string key;
+  for (const auto& extension : extensions) {
+    if (NormalizeExtension(extension, key))
+      keys.push_back(key);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  size_ = keys.size();
+  if (keys.empty())
+    return;
+
+  // Look for a seed that maps every key to a different slot. With at least
+  // twice as many slots as keys, one is usually found within a few tries.
+  // Otherwise the table is doubled.
+  std::vector<bool> used;
+  for (size_t slot_count = std::bit_ceil(keys.size() * 2);;
+       slot_count *= 2) {
+    used.assign(slot_count, false);
+    const auto mask = static_cast<uint32_t>(slot_count - 1);
+
+    for (uint32_t seed = 0; seed < 256; ++seed) {
+      std::fill(used.begin(), used.end(), false);
+      const bool perfect = std::all_of(
+          keys.begin(), keys.end(), [&](const std::string& key) {
+            const auto index = Hash(key, seed) & mask;
+            if (used[index])
+              return false;
+            used[index] = true;
+            return true;
+          });
+      if (!perfect)
+        continue;
+
+      seed_ = seed;
+      mask_ = mask;
+      slots_.assign(slot_count, {});
+      for (const auto& key : keys) {
+        auto& slot = slots_[Hash(key, seed) & mask];
+        std::copy(key.begin(), key.end(), slot.data.begin());
+        slot.size = static_cast<uint8_t>(key.size());
+      }
+      return;
+    }
+  }
+}
+
+bool ExtensionSet::empty() const {
+  return !size_;
+}
+
+size_t ExtensionSet::size() const {
+  return size_;
+}
+
+bool ExtensionSet::Contains(std::string_view extension) const {
+  if (slots_.empty())
+    return false;
+
+  if (extension.starts_with('.'))
+    extension.remove_prefix(1);
+  if (extension.empty() || extension.size() > kMaxLength)
+    return false;
+
+  std::array<char, kMaxLength> buffer;
+  for (size_t i = 0; i < extension.size(); ++i) {
+    buffer[i] = ToLowerAscii(extension[i]);
+  }
+  const std::string_view key(buffer.data(), extension.size());
+
+  const auto& slot = slots_[Hash(key, seed_) & mask_];
+  return std::string_view(slot.data.data(), slot.size) == key;
+}
+
+bool ExtensionSet::ContainsPath(std::string_view path) const {
+  return ContainsPathImpl(*this, path);
+}
+
+bool ExtensionSet::ContainsPath(std::wstring_view path) const {
+  return ContainsPathImpl(*this, path);
+}
+
+uint32_t ExtensionSet::Hash(std::string_view str, uint32_t seed) {
+  // FNV-1a, with the seed mixed into the offset basis
+  uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+  for (const auto c : str) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 16777619u;
+  }
+  return hash ^ (hash >> 16);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+PlayerExtensionSets::PlayerExtensionSets(
+    const std::vector<std::string>& common, const PlayerTable& players) {
+  if (!common.empty())
+    common_ = std::make_shared<const ExtensionSet>(common);
+
+  for (size_t i = 0; i < players.size(); ++i) {
+    const auto player = players[i];
+    if (player.extensions().empty())
+      continue;
+
+    auto extensions = common;
+    for (const auto extension : player.extensions()) {
+      extensions.emplace_back(extension);
+    }
+    players_.emplace(std::string(player.name()),
+                     std::make_shared<const ExtensionSet>(extensions));
+  }
+}
+
+std::shared_ptr<const ExtensionSet> PlayerExtensionSets::Get(
+    std::string_view player) const {
+  const auto it = players_.find(player);
+  return it != players_.end() ? it->second : common_;
+}
+
+}  // namespace detail
+
+}  // namespace anisthesia
@@ -0,0 +1,198 @@
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/fake_platform.hpp>
+
+namespace anisthesia {
+
+void FakePlatform::AddProcess(const Process& process) {
+  std::unique_lock lock(mutex_);
+  processes_[process.id] = process;
+}
+
+void FakePlatform::AddWindow(process_id_t process_id, const Window& window) {
+  std::unique_lock lock(mutex_);
+  windows_.emplace_back(process_id, window);
+}
+
+void FakePlatform::AddOpenFile(const OpenFile& open_file) {
+  std::unique_lock lock(mutex_);
+  open_files_[open_file.process_id].push_back(open_file.path);
+}
+
+void FakePlatform::AddSystemDirectory(std::string_view directory) {
+  std::unique_lock lock(mutex_);
+  system_directories_.Insert(directory);
+}
+
+void FakePlatform::SetWebBrowserInformation(
+    window_handle_t window,
+    std::vector<WebBrowserInformation> web_browser_information) {
+  std::unique_lock lock(mutex_);
+  web_browser_information_[window] = std::move(web_browser_information);
+}
+
+void FakePlatform::SetWebBrowserTree(window_handle_t window,
+                                     detail::MemoryElement root) {
+  // Reads that are in progress keep the previous tree
+  std::unique_lock lock(mutex_);
+  web_browser_trees_[window] =
+      std::make_shared<const detail::MemoryElement>(std::move(root));
+}
+
+void FakePlatform::SetMediaSessions(process_id_t process_id,
+                                    std::vector<MediaSession> media_sessions) {
+  std::unique_lock lock(mutex_);
+  media_sessions_[process_id] = std::move(media_sessions);
+}
+
+void FakePlatform::Clear() {
+  std::unique_lock lock(mutex_);
+  processes_.clear();
+  windows_.clear();
+  open_files_.clear();
+  system_directories_ = {};
+  web_browser_information_.clear();
+  web_browser_trees_.clear();
+  media_sessions_.clear();
+}
+
+uint64_t FakePlatform::element_calls() const {
+  return element_calls_.load();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool FakePlatform::EnumerateProcesses(process_proc_t process_proc) {
+  if (!process_proc)
+    return false;
+
+  std::shared_lock lock(mutex_);
+  for (const auto& [id, process] : processes_) {
+    if (!process_proc(process))
+      break;
+  }
+
+  return true;
+}
+
+bool FakePlatform::EnumerateWindows(window_proc_t window_proc) {
+  if (!window_proc)
+    return false;
+
+  std::shared_lock lock(mutex_);
+  for (const auto& [process_id, window] : windows_) {
+    const auto it = processes_.find(process_id);
+    if (it == processes_.end())
+      continue;
+    if (!window_proc(it->second, window))
+      break;
+  }
+
+  return true;
+}
+
+bool FakePlatform::EnumerateOpenFiles(
+    const std::set<process_id_t>& process_ids, open_file_proc_t open_file_proc,
+    const OpenFileFilter& filter, std::stop_token stop_token) {
+  if (!open_file_proc)
+    return false;
+
+  std::shared_lock lock(mutex_);
+  bool enumerated = false;
+
+  for (const auto process_id : process_ids) {
+    if (!processes_.count(process_id))
+      continue;
+    enumerated = true;
+
+    const auto it = open_files_.find(process_id);
+    if (it == open_files_.end())
+      continue;
+
+    for (const auto& path : it->second) {
+      if (stop_token.stop_requested())
+        return false;
+      if (system_directories_.Match(path))
+        continue;
+      if (filter.extensions && !filter.extensions->ContainsPath(path))
+        continue;
+      if (filter.excluded_directories &&
+          filter.excluded_directories->Match(path)) {
+        continue;
+      }
+      if (!open_file_proc({process_id, path}))
+        return false;
+    }
+  }
+
+  return enumerated;
+}
+
+bool FakePlatform::GetWebBrowserInformation(
+    const Window& window, web_browser_proc_t web_browser_proc,
+    std::stop_token stop_token) {
+  if (!web_browser_proc)
+    return false;
+
+  std::shared_lock lock(mutex_);
+
+  if (const auto it = web_browser_trees_.find(window.handle);
+      it != web_browser_trees_.end()) {
+    const auto tree = it->second;
+    lock.unlock();
+    const auto root = detail::CreateMemoryElement(*tree, &element_calls_);
+    return detail::GetWebBrowserInformation(*root, window, element_paths_,
+                                            web_browser_proc, stop_token);
+  }
+
+  const auto it = web_browser_information_.find(window.handle);
+  if (it == web_browser_information_.end())
+    return false;
+
+  for (const auto& information : it->second) {
+    if (stop_token.stop_requested())
+      return false;
+    web_browser_proc(information);
+  }
+
+  return true;
+}
+
+bool FakePlatform::EnumerateMediaSessions(
+    const Process& process, media_session_proc_t media_session_proc,
+    std::stop_token stop_token) {
+  if (!media_session_proc)
+    return false;
+
+  std::shared_lock lock(mutex_);
+
+  const auto it = media_sessions_.find(process.id);
+  if (it == media_sessions_.end())
+    return false;
+
+  for (const auto& media_session : it->second) {
+    if (stop_token.stop_requested() || !media_session_proc(media_session))
+      return false;
+  }
+
+  return true;
+}
+
+void FakePlatform::SetCacheLimits(const CacheLimits& limits) {
+  element_paths_.SetCapacity(limits.web_browser_windows);
+}
+
+void FakePlatform::ClearCaches() {
+  element_paths_.Clear();
+}
+
+}  // namespace anisthesia
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <anisthesia/handle_scan.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANISTHESIA_HANDLE_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace anisthesia::detail {
+
+namespace {
+
+bool MatchEntry(const HandleTableEntry& entry, const HandleFilter& filter) {
+  const auto process_id = static_cast<uint32_t>(entry.UniqueProcessId);
+  if (std::find(filter.process_ids.begin(), filter.process_ids.end(),
+                process_id) == filter.process_ids.end()) {
+    return false;
+  }
+
+  if (filter.object_type_index &&
+      entry.ObjectTypeIndex != filter.object_type_index) {
+    return false;
+  }
+
+  return (entry.GrantedAccess & filter.required_access) ==
+             filter.required_access &&
+         !(entry.GrantedAccess & filter.excluded_access);
+}
+
+#ifdef ANISTHESIA_HANDLE_SCAN_SSE2
+
+// Entries are 40 bytes apart, so each field is gathered into a vector of four
+// lanes. Nearly all entries belong to other processes, which is determined
+// from the process IDs alone.
+void FilterHandlesSse2(std::span<const HandleTableEntry> entries,
+                       const HandleFilter& filter, size_t& offset,
+                       std::vector<size_t>& indices) {
+  constexpr size_t kLanes = 4;
+
+  const auto lane = [](uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    return _mm_setr_epi32(static_cast<int>(a), static_cast<int>(b),
+                          static_cast<int>(c), static_cast<int>(d));
+  };
+  const auto splat = [](uint32_t value) {
+    return _mm_set1_epi32(static_cast<int>(value));
+  };
+
+  const __m128i type_index = splat(filter.object_type_index);
+  const __m128i required_access = splat(filter.required_access);
+  const __m128i excluded_access = splat(filter.excluded_access);
+  const __m128i zero = _mm_setzero_si128();
+
+  const size_t count = entries.size() - entries.size() % kLanes;
+
+  for (size_t i = 0; i < count; i += kLanes) {
+    const auto* e = entries.data() + i;
+
+    const __m128i process_ids =
+        lane(static_cast<uint32_t>(e[0].UniqueProcessId),
+             static_cast<uint32_t>(e[1].UniqueProcessId),
+             static_cast<uint32_t>(e[2].UniqueProcessId),
+             static_cast<uint32_t>(e[3].UniqueProcessId));
+    __m128i match = zero;
+    for (const auto process_id : filter.process_ids) {
+      match = _mm_or_si128(match,
+                           _mm_cmpeq_epi32(process_ids, splat(process_id)));
+    }
+    if (!_mm_movemask_epi8(match))
+      continue;
+
+    if (filter.object_type_index) {
+      const __m128i type_indices =
+          lane(e[0].ObjectTypeIndex, e[1].ObjectTypeIndex,
+               e[2].ObjectTypeIndex, e[3].ObjectTypeIndex);
+      match = _mm_and_si128(match, _mm_cmpeq_epi32(type_indices, type_index));
+    }
+
+    const __m128i access = lane(e[0].GrantedAccess, e[1].GrantedAccess,
+                                e[2].GrantedAccess, e[3].GrantedAccess);
+    match = _mm_and_si128(
+        match, _mm_cmpeq_epi32(_mm_and_si128(access, required_access),
+                               required_access));
+    match = _mm_and_si128(
+        match, _mm_cmpeq_epi32(_mm_and_si128(access, excluded_access), zero));
+
+    // One bit per lane
+    auto mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(match)));
+    while (mask) {
+      indices.push_back(i + static_cast<size_t>(std::countr_zero(mask)));
+      mask &= mask - 1;
+    }
+  }
+
+  offset = count;
+}
+
+#endif
+
+}  // namespace
+
+void FilterHandles(std::span<const HandleTableEntry> entries,
+                   const HandleFilter& filter, std::vector<size_t>& indices) {
+  if (filter.process_ids.empty())
+    return;
+
+  size_t offset = 0;
+#ifdef ANISTHESIA_HANDLE_SCAN_SSE2
+  FilterHandlesSse2(entries, filter, offset, indices);
+#endif
+  FilterHandlesScalar(entries.subspan(offset), filter, offset, indices);
+}
+
+void FilterHandlesScalar(std::span<const HandleTableEntry> entries,
+                         const HandleFilter& filter, size_t offset,
+                         std::vector<size_t>& indices) {
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (MatchEntry(entries[i], filter))
+      indices.push_back(offset + i);
+  }
+}
+
+}  // namespace anisthesia::detail
@@ -0,0 +1,610 @@
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <dbus/dbus.h>
+
+#include <anisthesia/linux_mpris.hpp>
+#include <anisthesia/util.hpp>
+
+namespace anisthesia::lin::detail {
+
+constexpr std::string_view kBusNamePrefix = "org.mpris.MediaPlayer2.";
+constexpr const char* kObjectPath = "/org/mpris/MediaPlayer2";
+constexpr const char* kPlayerInterface = "org.mpris.MediaPlayer2.Player";
+constexpr const char* kPropertiesInterface = "org.freedesktop.DBus.Properties";
+
+// A player that does not reply by then is given up on
+constexpr int kCallTimeout = 500;  // milliseconds
+
+// Connecting to a bus that is not there is not retried on every poll
+constexpr auto kReconnectInterval = std::chrono::seconds(10);
+
+using steady_clock = std::chrono::steady_clock;
+using microseconds_t = std::chrono::microseconds;
+
+struct ConnectionDeleter {
+  void operator()(DBusConnection* connection) const {
+    ::dbus_connection_close(connection);
+    ::dbus_connection_unref(connection);
+  }
+};
+
+using Connection = std::unique_ptr<DBusConnection, ConnectionDeleter>;
+
+struct MessageDeleter {
+  void operator()(DBusMessage* message) const {
+    ::dbus_message_unref(message);
+  }
+};
+
+using Message = std::unique_ptr<DBusMessage, MessageDeleter>;
+
+class Error {
+public:
+  Error() { ::dbus_error_init(&error_); }
+  Error(const Error&) = delete;
+  ~Error() { ::dbus_error_free(&error_); }
+
+  Error& operator=(const Error&) = delete;
+
+  DBusError* get() { return &error_; }
+
+private:
+  DBusError error_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct Player {
+  std::set<std::string> names;  // well-known, i.e. "org.mpris.MediaPlayer2.*"
+  process_id_t process_id = 0;
+
+  MediaState state = MediaState::Unknown;
+  std::string title;
+  std::string url;
+  microseconds_t duration = microseconds_t::zero();
+  microseconds_t position = microseconds_t::zero();  // as of `updated`
+  steady_clock::time_point updated;
+  double rate = 1.0;
+
+  microseconds_t PositionAt(steady_clock::time_point time) const {
+    if (state != MediaState::Playing || time < updated)
+      return position;
+    auto result = position + std::chrono::duration_cast<microseconds_t>(
+                                 (time - updated) * rate);
+    if (result < microseconds_t::zero())
+      result = microseconds_t::zero();
+    if (duration > microseconds_t::zero() && result > duration)
+      result = duration;
+    return result;
+  }
+
+  void SetPosition(microseconds_t value, steady_clock::time_point time) {
+    position = value;
+    updated = time;
+  }
+};
+
+// Reads the current argument, or the variant it holds
+bool ReadString(DBusMessageIter* iter, std::string& value) {
+  DBusMessageIter variant;
+  if (::dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_VARIANT) {
+    ::dbus_message_iter_recurse(iter, &variant);
+    iter = &variant;
+  }
+
+  switch (::dbus_message_iter_get_arg_type(iter)) {
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH: {
+      const char* str = nullptr;
+      ::dbus_message_iter_get_basic(iter, &str);
+      value = str ? str : "";
+      return true;
+    }
+    case DBUS_TYPE_ARRAY: {
+      // e.g. "xesam:url" as a list of one
+      DBusMessageIter array;
+      ::dbus_message_iter_recurse(iter, &array);
+      return ::dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRING &&
+             ReadString(&array, value);
+    }
+    default:
+      return false;
+  }
+}
+
+// Numbers of any type are accepted, as players disagree on them
+bool ReadNumber(DBusMessageIter* iter, double& value) {
+  DBusMessageIter variant;
+  if (::dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_VARIANT) {
+    ::dbus_message_iter_recurse(iter, &variant);
+    iter = &variant;
+  }
+
+  DBusBasicValue basic;
+  switch (::dbus_message_iter_get_arg_type(iter)) {
+    case DBUS_TYPE_INT16:
+      ::dbus_message_iter_get_basic(iter, &basic);
+      value = basic.i16;
+      return true;
+    case DBUS_TYPE_UINT16:
+      ::dbus_message_iter_get_basic(iter, &basic);
+      value = basic.u16;
+      return true;
+    case DBUS_TYPE_INT32:
+      ::dbus_message_iter_get_basic(iter, &basic);
+      value = basic.i32;
+      return true;
+    case DBUS_TYPE_UINT32:
+      ::dbus_message_iter_get_basic(iter, &basic);
+      value = basic.u32;
+      return true;
+    case DBUS_TYPE_INT64:
+      ::dbus_message_iter_get_basic(iter, &basic);
+      value = static_cast<double>(basic.i64);
+      return true;
+    case DBUS_TYPE_UINT64:
+      ::dbus_message_iter_get_basic(iter, &basic);
+      value = static_cast<double>(basic.u64);
+      return true;
+    case DBUS_TYPE_DOUBLE:
+      ::dbus_message_iter_get_basic(iter, &basic);
+      value = basic.dbl;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool ReadMicroseconds(DBusMessageIter* iter, microseconds_t& value) {
+  double number = 0;
+  if (!ReadNumber(iter, number))
+    return false;
+  value = microseconds_t{static_cast<int64_t>(number)};
+  return true;
+}
+
+// Calls `entry_proc` with the key and value of each entry of an a{sv}
+template <typename Proc>
+bool ReadDictionary(DBusMessageIter* iter, Proc entry_proc) {
+  DBusMessageIter variant;
+  if (::dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_VARIANT) {
+    ::dbus_message_iter_recurse(iter, &variant);
+    iter = &variant;
+  }
+  if (::dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+    return false;
+
+  DBusMessageIter array;
+  ::dbus_message_iter_recurse(iter, &array);
+
+  for (; ::dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_DICT_ENTRY;
+       ::dbus_message_iter_next(&array)) {
+    DBusMessageIter entry;
+    ::dbus_message_iter_recurse(&array, &entry);
+    std::string key;
+    if (!ReadString(&entry, key) || !::dbus_message_iter_next(&entry))
+      continue;
+    entry_proc(key, &entry);
+  }
+
+  return true;
+}
+
+MediaState ParsePlaybackStatus(std::string_view status) {
+  if (status == "Playing")
+    return MediaState::Playing;
+  if (status == "Paused")
+    return MediaState::Paused;
+  if (status == "Stopped")
+    return MediaState::Stopped;
+  return MediaState::Unknown;
+}
+
+void ReadMetadata(DBusMessageIter* iter, Player& player) {
+  player.title.clear();
+  player.url.clear();
+  player.duration = microseconds_t::zero();
+
+  ReadDictionary(iter, [&player](const std::string& key,
+                                 DBusMessageIter* value) {
+    if (key == "xesam:title") {
+      ReadString(value, player.title);
+    } else if (key == "xesam:url") {
+      ReadString(value, player.url);
+    } else if (key == "mpris:length") {
+      ReadMicroseconds(value, player.duration);
+    }
+  });
+}
+
+// Returns true if the position has to be read again, as the player has moved
+// on to another file, or has started or stopped playing.
+bool ReadPlayerProperties(DBusMessageIter* iter, Player& player,
+                          steady_clock::time_point now) {
+  bool stale_position = false;
+
+  ReadDictionary(iter, [&](const std::string& key, DBusMessageIter* value) {
+    if (key == "PlaybackStatus") {
+      std::string status;
+      if (ReadString(value, status)) {
+        player.SetPosition(player.PositionAt(now), now);
+        player.state = ParsePlaybackStatus(status);
+        stale_position = true;
+      }
+    } else if (key == "Metadata") {
+      ReadMetadata(value, player);
+      stale_position = true;
+    } else if (key == "Position") {
+      microseconds_t position;
+      if (ReadMicroseconds(value, position))
+        player.SetPosition(position, now);
+    } else if (key == "Rate") {
+      double rate = 1.0;
+      if (ReadNumber(value, rate)) {
+        player.SetPosition(player.PositionAt(now), now);
+        player.rate = rate;
+      }
+    }
+  });
+
+  return stale_position;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct MprisClient::Impl {
+  bool Connect();
+  void Disconnect();
+
+  Message Call(const char* destination, const char* path,
+               const char* interface, const char* method,
+               std::initializer_list<const char*> arguments);
+
+  void AddPlayer(const std::string& name);
+  void RemovePlayer(const std::string& name);
+  bool ReadPlayer(const std::string& unique_name, Player& player);
+  bool ReadPosition(const std::string& unique_name, Player& player);
+
+  void Dispatch();
+  void HandleMessage(DBusMessage* message);
+
+  std::mutex mutex;
+  Connection connection;
+  std::map<std::string, Player> players;  // by unique name
+  std::map<std::string, std::string> owners;  // unique name of each name
+  steady_clock::time_point last_attempt;
+  bool attempted = false;
+};
+
+bool MprisClient::Impl::Connect() {
+  if (connection && ::dbus_connection_get_is_connected(connection.get()))
+    return true;
+
+  Disconnect();
+
+  const auto now = steady_clock::now();
+  if (attempted && now - last_attempt < kReconnectInterval)
+    return false;
+  attempted = true;
+  last_attempt = now;
+
+  // A private connection, so that we neither share nor dispatch the messages
+  // of another library in the same process.
+  Error error;
+  connection.reset(::dbus_bus_get_private(DBUS_BUS_SESSION, error.get()));
+  if (!connection)
+    return false;
+  ::dbus_connection_set_exit_on_disconnect(connection.get(), false);
+
+  // Signals are subscribed to before players are listed, so that no change
+  // is missed in between.
+  const std::string rules[] = {
+    std::string{"type='signal',interface='"} + kPropertiesInterface +
+        "',member='PropertiesChanged',path='" + kObjectPath + "',arg0='" +
+        kPlayerInterface + "'",
+    std::string{"type='signal',interface='"} + kPlayerInterface +
+        "',member='Seeked',path='" + kObjectPath + "'",
+    "type='signal',sender='org.freedesktop.DBus',"
+    "interface='org.freedesktop.DBus',member='NameOwnerChanged',"
+    "arg0namespace='org.mpris.MediaPlayer2'",
+  };
+  for (const auto& rule : rules) {
+    Error rule_error;
+    ::dbus_bus_add_match(connection.get(), rule.c_str(), rule_error.get());
+    if (::dbus_error_is_set(rule_error.get())) {
+      Disconnect();
+      return false;
+    }
+  }
+
+  const auto reply = Call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+                          DBUS_INTERFACE_DBUS, "ListNames", {});
+  if (!reply) {
+    Disconnect();
+    return false;
+  }
+
+  DBusMessageIter iter;
+  DBusMessageIter array;
+  if (::dbus_message_iter_init(reply.get(), &iter) &&
+      ::dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY) {
+    ::dbus_message_iter_recurse(&iter, &array);
+    for (; ::dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRING;
+         ::dbus_message_iter_next(&array)) {
+      std::string name;
+      ReadString(&array, name);
+      if (name.starts_with(kBusNamePrefix))
+        AddPlayer(name);
+    }
+  }
+
+  attempted = false;
+  return true;
+}
+
+void MprisClient::Impl::Disconnect() {
+  connection.reset();
+  players.clear();
+  owners.clear();
+}
+
+Message MprisClient::Impl::Call(const char* destination, const char* path,
+                                const char* interface, const char* method,
+                                std::initializer_list<const char*> arguments) {
+  Message message{::dbus_message_new_method_call(destination, path, interface,
+                                                 method)};
+  if (!message)
+    return nullptr;
+
+  for (const char* argument : arguments) {
+    if (!::dbus_message_append_args(message.get(), DBUS_TYPE_STRING,
+                                    &argument, DBUS_TYPE_INVALID)) {
+      return nullptr;
+    }
+  }
+
+  Error error;
+  Message reply{::dbus_connection_send_with_reply_and_block(
+      connection.get(), message.get(), kCallTimeout, error.get())};
+  if (::dbus_error_is_set(error.get()))
+    return nullptr;
+  return reply;
+}
+
+void MprisClient::Impl::AddPlayer(const std::string& name) {
+  const auto owner = Call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+                          DBUS_INTERFACE_DBUS, "GetNameOwner", {name.c_str()});
+  const char* unique_name = nullptr;
+  if (!owner || !::dbus_message_get_args(owner.get(), nullptr,
+                                         DBUS_TYPE_STRING, &unique_name,
+                                         DBUS_TYPE_INVALID)) {
+    return;
+  }
+
+  owners[name] = unique_name;
+
+  // A player may own more than one name (e.g. one per instance)
+  if (const auto it = players.find(unique_name); it != players.end()) {
+    it->second.names.insert(name);
+    return;
+  }
+
+  Player player;
+  player.names.insert(name);
+  if (!ReadPlayer(unique_name, player))
+    return;
+  players.emplace(unique_name, std::move(player));
+}
+
+void MprisClient::Impl::RemovePlayer(const std::string& name) {
+  const auto owner = owners.find(name);
+  if (owner == owners.end())
+    return;
+
+  if (const auto it = players.find(owner->second); it != players.end()) {
+    it->second.names.erase(name);
+    if (it->second.names.empty())
+      players.erase(it);
+  }
+  owners.erase(owner);
+}
+
+bool MprisClient::Impl::ReadPlayer(const std::string& unique_name,
+                                   Player& player) {
+  const auto pid = Call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS,
+                        "GetConnectionUnixProcessID", {unique_name.c_str()});
+  dbus_uint32_t process_id = 0;
+  if (pid && ::dbus_message_get_args(pid.get(), nullptr, DBUS_TYPE_UINT32,
+                                     &process_id, DBUS_TYPE_INVALID)) {
+    player.process_id = process_id;
+  }
+
+  const auto properties =
+      Call(unique_name.c_str(), kObjectPath, kPropertiesInterface, "GetAll",
+           {kPlayerInterface});
+  DBusMessageIter iter;
+  if (!properties || !::dbus_message_iter_init(properties.get(), &iter))
+    return false;
+
+  ReadPlayerProperties(&iter, player, steady_clock::now());
+  return true;
+}
+
+bool MprisClient::Impl::ReadPosition(const std::string& unique_name,
+                                     Player& player) {
+  const auto reply = Call(unique_name.c_str(), kObjectPath,
+                          kPropertiesInterface, "Get",
+                          {kPlayerInterface, "Position"});
+  DBusMessageIter iter;
+  microseconds_t position;
+  if (!reply || !::dbus_message_iter_init(reply.get(), &iter) ||
+      !ReadMicroseconds(&iter, position)) {
+    return false;
+  }
+
+  player.SetPosition(position, steady_clock::now());
+  return true;
+}
+
+void MprisClient::Impl::Dispatch() {
+  // Reads whatever has arrived, without waiting for more
+  if (!::dbus_connection_read_write(connection.get(), 0))
+    return;
+
+  while (const Message message{
+             ::dbus_connection_pop_message(connection.get())}) {
+    HandleMessage(message.get());
+  }
+}
+
+void MprisClient::Impl::HandleMessage(DBusMessage* message) {
+  if (::dbus_message_is_signal(message, DBUS_INTERFACE_DBUS,
+                               "NameOwnerChanged")) {
+    const char* name = nullptr;
+    const char* old_owner = nullptr;
+    const char* new_owner = nullptr;
+    if (!::dbus_message_get_args(message, nullptr, DBUS_TYPE_STRING, &name,
+                                 DBUS_TYPE_STRING, &old_owner,
+                                 DBUS_TYPE_STRING, &new_owner,
+                                 DBUS_TYPE_INVALID) ||
+        !std::string_view{name}.starts_with(kBusNamePrefix)) {
+      return;
+    }
+    if (*old_owner)
+      RemovePlayer(name);
+    if (*new_owner)
+      AddPlayer(name);
+    return;
+  }
+
+  const char* sender = ::dbus_message_get_sender(message);
+  if (!sender)
+    return;
+  const auto it = players.find(sender);
+  if (it == players.end())
+    return;
+  auto& player = it->second;
+
+  if (::dbus_message_is_signal(message, kPropertiesInterface,
+                               "PropertiesChanged")) {
+    DBusMessageIter iter;
+    std::string interface;
+    if (!::dbus_message_iter_init(message, &iter) ||
+        !ReadString(&iter, interface) || interface != kPlayerInterface ||
+        !::dbus_message_iter_next(&iter)) {
+      return;
+    }
+
+    const bool stale_position =
+        ReadPlayerProperties(&iter, player, steady_clock::now());
+
+    // Properties that are invalidated rather than changed are read again
+    bool invalidated = false;
+    if (::dbus_message_iter_next(&iter) &&
+        ::dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY) {
+      DBusMessageIter array;
+      ::dbus_message_iter_recurse(&iter, &array);
+      invalidated =
+          ::dbus_message_iter_get_arg_type(&array) != DBUS_TYPE_INVALID;
+    }
+
+    if (invalidated) {
+      ReadPlayer(sender, player);
+    } else if (stale_position) {
+      ReadPosition(sender, player);
+    }
+
+  } else if (::dbus_message_is_signal(message, kPlayerInterface, "Seeked")) {
+    DBusMessageIter iter;
+    microseconds_t position;
+    if (::dbus_message_iter_init(message, &iter) &&
+        ReadMicroseconds(&iter, position)) {
+      player.SetPosition(position, steady_clock::now());
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MprisClient::MprisClient() : impl_(std::make_unique<Impl>()) {
+  ::dbus_threads_init_default();
+}
+
+MprisClient::~MprisClient() = default;
+
+bool MprisClient::EnumerateMediaSessions(
+    const Process& process, media_session_proc_t media_session_proc,
+    std::stop_token stop_token) {
+  if (!media_session_proc)
+    return false;
+
+  std::lock_guard lock(impl_->mutex);
+
+  if (!impl_->Connect())
+    return false;
+  impl_->Dispatch();
+
+  // e.g. "vlc" from "org.mpris.MediaPlayer2.vlc.instance1234"
+  auto matches_name = [&process](const Player& player) {
+    for (const auto& name : player.names) {
+      auto suffix = std::string_view{name}.substr(kBusNamePrefix.size());
+      suffix = suffix.substr(0, suffix.find('.'));
+      if (anisthesia::detail::util::EqualStrings(suffix, process.name))
+        return true;
+    }
+    return false;
+  };
+
+  std::vector<const Player*> players;
+  for (const auto& [unique_name, player] : impl_->players) {
+    if (player.process_id == process.id)
+      players.push_back(&player);
+  }
+  if (players.empty()) {
+    for (const auto& [unique_name, player] : impl_->players) {
+      if (matches_name(player))
+        players.push_back(&player);
+    }
+  }
+
+  const auto now = steady_clock::now();
+
+  for (const auto* player : players) {
+    if (stop_token.stop_requested())
+      return false;
+
+    MediaSession session;
+    session.state = player->state;
+    session.duration =
+        std::chrono::duration_cast<media_time_t>(player->duration);
+    session.position =
+        std::chrono::duration_cast<media_time_t>(player->PositionAt(now));
+    session.rate = player->rate;
+    session.title = player->title;
+    session.url = player->url;
+
+    if (!media_session_proc(session))
+      break;
+  }
+
+  return true;
+}
+
+void MprisClient::Clear() {
+  std::lock_guard lock(impl_->mutex);
+  impl_->Disconnect();
+  impl_->attempted = false;
+}
+
+}  // namespace anisthesia::lin::detail
@@ -0,0 +1,322 @@
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <anisthesia/linux_open_files.hpp>
+
+namespace anisthesia::lin::detail {
+
+// Layout of the records that are returned by getdents64. glibc only exposes a
+// wrapper in newer versions, so the system call is made directly.
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+
+// Reused for every process within a scan, so that a process with thousands of
+// descriptors does not cost an allocation per descriptor.
+struct ScanBuffer {
+  static constexpr size_t kDirentSize = 1 << 15;  // 32 KiB
+
+  alignas(LinuxDirent64) std::array<char, kDirentSize> dirents;
+  std::array<char, PATH_MAX> path;
+};
+
+using anisthesia::detail::ExtensionSet;
+using anisthesia::detail::PathTrie;
+using anisthesia::detail::OpenFileStatus;
+
+class FileDescriptor {
+public:
+  explicit FileDescriptor(int fd) : fd_(fd) {}
+  FileDescriptor(const FileDescriptor&) = delete;
+  ~FileDescriptor() {
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+  int get() const { return fd_; }
+
+private:
+  int fd_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool IsSystemDirectory(std::string_view path) {
+  return GetSystemDirectories().Match(path);
+}
+
+bool VerifyAccessMode(int dir_fd, const char* name) {
+  // The mode of a link under /proc/<pid>/fd reflects the access mode of the
+  // descriptor. As on Windows, media players must have read access to a video
+  // file, and are assumed not to have write access.
+  struct stat st = {};
+  if (::fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+    return false;
+
+  return (st.st_mode & S_IRUSR) && !(st.st_mode & S_IWUSR);
+}
+
+bool VerifyFileType(int dir_fd, const char* name, struct stat& st) {
+  // Skip directories, character devices, sockets, pipes and anonymous inodes.
+  // The link is followed to the open file itself, rather than to its path.
+  if (::fstatat(dir_fd, name, &st, 0) != 0)
+    return false;
+
+  return S_ISREG(st.st_mode);
+}
+
+bool ReadLink(int dir_fd, const char* name, ScanBuffer& buffer,
+              std::string_view& path) {
+  const auto length = ::readlinkat(dir_fd, name, buffer.path.data(),
+                                   buffer.path.size());
+  // The result is truncated if it fills the buffer
+  if (length <= 0 || static_cast<size_t>(length) >= buffer.path.size())
+    return false;
+
+  path = std::string_view(buffer.path.data(), static_cast<size_t>(length));
+  return true;
+}
+
+bool VerifyExtension(std::string_view path, const ExtensionSet* extensions) {
+  return !extensions || extensions->ContainsPath(path);
+}
+
+bool VerifyExcludedDirectories(std::string_view path,
+                               const OpenFileFilter& filter) {
+  return !filter.excluded_directories ||
+         !filter.excluded_directories->Match(path);
+}
+
+bool VerifyPath(std::string_view path) {
+  // Skip pseudo-files such as "socket:[1234]" and "anon_inode:[eventfd]"
+  if (!path.starts_with('/'))
+    return false;
+
+  // Skip files that have been deleted while being open
+  if (path.ends_with(" (deleted)"))
+    return false;
+
+  // Skip files under system directories
+  if (IsSystemDirectory(path))
+    return false;
+
+  return true;
+}
+
+// Returns false if the descriptor has been closed in the meantime, in which
+// case there is nothing to remember.
+bool ResolveDescriptor(int dir_fd, const char* name, ScanBuffer& buffer,
+                       const ExtensionSet* extensions,
+                       OpenFileCache::Entry& entry) {
+  if (!VerifyAccessMode(dir_fd, name)) {
+    entry.status = OpenFileStatus::InvalidAccess;
+    return true;
+  }
+
+  std::string_view path;
+  if (!ReadLink(dir_fd, name, buffer, path))
+    return false;
+
+  // Skip files that the player is not expected to play, before anything else
+  // is done with the path
+  if (!VerifyExtension(path, extensions)) {
+    entry.status = OpenFileStatus::InvalidExtension;
+    entry.path = path;
+    return true;
+  }
+
+  if (!VerifyPath(path)) {
+    entry.status = OpenFileStatus::InvalidPath;
+    return true;
+  }
+
+  entry.status = OpenFileStatus::Accepted;
+  entry.path = path;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Reads the 22nd field of /proc/<pid>/stat. The name of the process (the 2nd
+// field) may contain spaces and parentheses, so fields are counted from the
+// last closing parenthesis.
+bool GetProcessStartTime(int process_fd, uint64_t& start_time) {
+  const FileDescriptor stat_fd(::openat(process_fd, "stat",
+                                        O_RDONLY | O_CLOEXEC));
+  if (stat_fd.get() < 0)
+    return false;
+
+  std::array<char, 1024> buffer;
+  const auto size = ::read(stat_fd.get(), buffer.data(), buffer.size());
+  if (size <= 0)
+    return false;
+
+  std::string_view stat(buffer.data(), static_cast<size_t>(size));
+  const auto name_end = stat.rfind(')');
+  if (name_end == stat.npos)
+    return false;
+  stat.remove_prefix(name_end + 1);
+
+  for (int field = 3; field < 22; ++field) {
+    const auto separator = stat.find(' ', 1);
+    if (separator == stat.npos)
+      return false;
+    stat.remove_prefix(separator);
+  }
+  stat.remove_prefix(1);
+
+  const auto [ptr, ec] =
+      std::from_chars(stat.data(), stat.data() + stat.size(), start_time);
+  return ec == std::errc{};
+}
+
+bool EnumerateProcessFiles(process_id_t process_id, int process_fd,
+                           ScanBuffer& buffer, OpenFileCache::Scan& scan,
+                           const OpenFileFilter& filter,
+                           const open_file_proc_t& open_file_proc,
+                           const std::stop_token& stop_token, bool& stopped) {
+  // Links are resolved relative to the directory, which avoids building a path
+  // for each descriptor, and fails cleanly if the process exits.
+  const FileDescriptor dir_fd(
+      ::openat(process_fd, "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (dir_fd.get() < 0)
+    return false;
+
+  while (true) {
+    const auto size = ::syscall(SYS_getdents64, dir_fd.get(),
+                                buffer.dirents.data(), buffer.dirents.size());
+    if (size <= 0)
+      return size == 0;
+
+    for (long offset = 0; offset < size;) {
+      const auto& entry = *reinterpret_cast<const LinuxDirent64*>(
+          buffer.dirents.data() + offset);
+      offset += entry.d_reclen;
+
+      // Skip "." and ".."
+      if (entry.d_name[0] == '.')
+        continue;
+
+      if (stop_token.stop_requested()) {
+        stopped = true;
+        return false;
+      }
+
+      struct stat st = {};
+      if (!VerifyFileType(dir_fd.get(), entry.d_name, st))
+        continue;
+
+      // Only descriptors that are new since the last scan are resolved
+      DescriptorKey key{0, st.st_dev, st.st_ino};
+      const auto name_end = entry.d_name + std::strlen(entry.d_name);
+      std::from_chars(entry.d_name, name_end, key.fd);
+
+      // The extension set may have changed since the file was rejected
+      const auto* cached = scan.Find(key);
+      if (cached && cached->status == OpenFileStatus::InvalidExtension &&
+          VerifyExtension(cached->path, filter.extensions)) {
+        cached = nullptr;
+      }
+      if (!cached) {
+        OpenFileCache::Entry resolved;
+        if (!ResolveDescriptor(dir_fd.get(), entry.d_name, buffer,
+                               filter.extensions, resolved)) {
+          continue;
+        }
+        cached = &scan.Insert(key, std::move(resolved));
+      }
+
+      // The filter may differ from the one that the entry was resolved with.
+      // Unlike system directories, excluded directories are not cached.
+      if (cached->status != OpenFileStatus::Accepted ||
+          !VerifyExtension(cached->path, filter.extensions) ||
+          !VerifyExcludedDirectories(cached->path, filter)) {
+        continue;
+      }
+
+      if (!open_file_proc({process_id, cached->path})) {
+        stopped = true;
+        return false;
+      }
+    }
+  }
+}
+
+const PathTrie& GetSystemDirectories() {
+  // "/run" is not included, because removable media is mounted under
+  // "/run/media".
+  static const auto directories = []() {
+    PathTrie directories;
+    for (const auto directory : {"/bin", "/dev", "/etc", "/lib", "/lib32",
+                                 "/lib64", "/proc", "/sbin", "/sys", "/usr"}) {
+      directories.Insert(directory);
+    }
+    return directories;
+  }();
+
+  return directories;
+}
+
+bool EnumerateOpenFiles(OpenFileCache& cache,
+                        const std::set<process_id_t>& process_ids,
+                        open_file_proc_t open_file_proc,
+                        const OpenFileFilter& filter,
+                        std::stop_token stop_token) {
+  if (!open_file_proc)
+    return false;
+
+  const auto buffer = std::make_unique<ScanBuffer>();
+
+  // Processes that cannot be read (e.g. because they belong to another user,
+  // or have exited) are skipped, as they are on Windows.
+  bool enumerated = false;
+  for (const auto process_id : process_ids) {
+    // The start time and the descriptors are read through the same directory,
+    // so that they belong to the same process even if its ID is reused.
+    const auto process_path = "/proc/" + std::to_string(process_id);
+    const FileDescriptor process_fd(::open(
+        process_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    ProcessKey key{process_id, 0};
+    if (process_fd.get() < 0 ||
+        !GetProcessStartTime(process_fd.get(), key.start_time)) {
+      continue;
+    }
+
+    bool stopped = false;
+    auto scan = cache.Begin(key);
+    const bool result = EnumerateProcessFiles(process_id, process_fd.get(),
+                                              *buffer, scan, filter,
+                                              open_file_proc, stop_token,
+                                              stopped);
+    cache.End(std::move(scan), !stopped);
+    if (result) {
+      enumerated = true;
+    } else if (stopped) {
+      return false;
+    }
+  }
+
+  return enumerated;
+}
+
+}  // namespace anisthesia::lin::detail
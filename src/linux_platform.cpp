@@ -0,0 +1,66 @@
+#include <memory>
+#include <set>
+#include <stop_token>
+
+#include <anisthesia/linux_open_files.hpp>
+#include <anisthesia/linux_platform.hpp>
+#include <anisthesia/linux_processes.hpp>
+
+namespace anisthesia {
+
+std::shared_ptr<Platform> CreateNativePlatform() {
+  return std::make_shared<lin::LinuxPlatform>();
+}
+
+}  // namespace anisthesia
+
+namespace anisthesia::lin {
+
+bool LinuxPlatform::EnumerateProcesses(process_proc_t process_proc) {
+  return detail::EnumerateProcesses(process_proc);
+}
+
+bool LinuxPlatform::EnumerateWindows(window_proc_t window_proc) {
+#ifdef ANISTHESIA_XCB
+  return windows_.EnumerateWindows(window_proc);
+#else
+  return false;
+#endif
+}
+
+bool LinuxPlatform::EnumerateOpenFiles(
+    const std::set<process_id_t>& process_ids, open_file_proc_t open_file_proc,
+    const OpenFileFilter& filter, std::stop_token stop_token) {
+  return detail::EnumerateOpenFiles(open_files_, process_ids, open_file_proc,
+                                    filter, stop_token);
+}
+
+bool LinuxPlatform::GetWebBrowserInformation(const Window&, web_browser_proc_t,
+                                             std::stop_token) {
+  return false;
+}
+
+bool LinuxPlatform::EnumerateMediaSessions(
+    [[maybe_unused]] const Process& process,
+    [[maybe_unused]] media_session_proc_t media_session_proc,
+    [[maybe_unused]] std::stop_token stop_token) {
+#ifdef ANISTHESIA_DBUS
+  return mpris_.EnumerateMediaSessions(process, media_session_proc,
+                                       stop_token);
+#else
+  return false;
+#endif
+}
+
+void LinuxPlatform::SetCacheLimits(const CacheLimits& limits) {
+  open_files_.SetMaxProcesses(limits.open_file_processes);
+}
+
+void LinuxPlatform::ClearCaches() {
+  open_files_.Clear();
+#ifdef ANISTHESIA_DBUS
+  mpris_.Clear();
+#endif
+}
+
+}  // namespace anisthesia::lin
@@ -0,0 +1,72 @@
+#include <array>
+#include <charconv>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <anisthesia/linux_processes.hpp>
+
+namespace anisthesia::lin::detail {
+
+struct DirectoryDeleter {
+  void operator()(DIR* dir) const { ::closedir(dir); }
+};
+
+using Directory = std::unique_ptr<DIR, DirectoryDeleter>;
+
+bool ParseProcessId(std::string_view name, process_id_t& process_id) {
+  const auto end = name.data() + name.size();
+  const auto [ptr, ec] = std::from_chars(name.data(), end, process_id);
+  return ec == std::errc{} && ptr == end && process_id;
+}
+
+std::string GetProcessName(process_id_t process_id) {
+  const auto link = "/proc/" + std::to_string(process_id) + "/exe";
+
+  std::array<char, PATH_MAX> buffer;
+  const auto length = ::readlink(link.c_str(), buffer.data(), buffer.size());
+  if (length <= 0 || static_cast<size_t>(length) >= buffer.size())
+    return std::string();
+
+  // An executable that has been replaced while running (e.g. by an update)
+  // is reported as deleted.
+  std::string_view path(buffer.data(), static_cast<size_t>(length));
+  if (path.ends_with(" (deleted)"))
+    path.remove_suffix(10);
+
+  const auto pos = path.find_last_of('/');
+  if (pos != std::string_view::npos)
+    path.remove_prefix(pos + 1);
+
+  return std::string(path);
+}
+
+bool EnumerateProcesses(process_proc_t process_proc) {
+  if (!process_proc)
+    return false;
+
+  const Directory dir(::opendir("/proc"));
+  if (!dir)
+    return false;
+
+  while (const auto entry = ::readdir(dir.get())) {
+    Process process;
+    if (!ParseProcessId(entry->d_name, process.id))
+      continue;
+
+    process.name = GetProcessName(process.id);
+    if (process.name.empty())
+      continue;
+
+    if (!process_proc(process))
+      break;
+  }
+
+  return true;
+}
+
+}  // namespace anisthesia::lin::detail
@@ -0,0 +1,320 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <xcb/xcb.h>
+
+#include <anisthesia/linux_processes.hpp>
+#include <anisthesia/linux_windows.hpp>
+
+namespace anisthesia::lin::detail {
+
+struct ConnectionDeleter {
+  void operator()(xcb_connection_t* connection) const {
+    ::xcb_disconnect(connection);
+  }
+};
+
+using Connection = std::unique_ptr<xcb_connection_t, ConnectionDeleter>;
+
+// Connecting to a server that is not there is not retried on every poll
+constexpr auto kReconnectInterval = std::chrono::seconds(10);
+
+using steady_clock = std::chrono::steady_clock;
+
+struct ReplyDeleter {
+  void operator()(void* reply) const { std::free(reply); }
+};
+
+template <typename T>
+using Reply = std::unique_ptr<T, ReplyDeleter>;
+
+enum Atom {
+  kNetClientList,
+  kNetWmName,
+  kNetWmPid,
+  kNetWmWindowType,
+  kNetWmWindowTypeNormal,
+  kUtf8String,
+  kAtomCount,
+};
+
+using atoms_t = std::array<xcb_atom_t, kAtomCount>;
+
+bool InternAtoms(xcb_connection_t* connection, atoms_t& atoms) {
+  static constexpr std::array<std::string_view, kAtomCount> kNames{
+      "_NET_CLIENT_LIST",
+      "_NET_WM_NAME",
+      "_NET_WM_PID",
+      "_NET_WM_WINDOW_TYPE",
+      "_NET_WM_WINDOW_TYPE_NORMAL",
+      "UTF8_STRING",
+  };
+
+  // Requests are sent at once, and replies are waited for afterwards, so that
+  // there is a single round trip to the server.
+  std::array<xcb_intern_atom_cookie_t, kAtomCount> cookies;
+  for (size_t i = 0; i < kAtomCount; ++i) {
+    cookies[i] = ::xcb_intern_atom(connection, 1,
+                                   static_cast<uint16_t>(kNames[i].size()),
+                                   kNames[i].data());
+  }
+
+  bool success = true;
+  for (size_t i = 0; i < kAtomCount; ++i) {
+    xcb_generic_error_t* error = nullptr;
+    const Reply<xcb_intern_atom_reply_t> reply(
+        ::xcb_intern_atom_reply(connection, cookies[i], &error));
+    std::free(error);
+    atoms[i] = reply ? reply->atom : static_cast<xcb_atom_t>(XCB_ATOM_NONE);
+    success &= atoms[i] != XCB_ATOM_NONE;
+  }
+
+  return success;
+}
+
+xcb_get_property_cookie_t GetProperty(xcb_connection_t* connection,
+                                      xcb_window_t window, xcb_atom_t property,
+                                      xcb_atom_t type, uint32_t max_length) {
+  // The length is in 32-bit units
+  return ::xcb_get_property(connection, 0, window, property, type, 0,
+                            (max_length + 3) / 4);
+}
+
+// Errors (e.g. for a window that has closed since) are taken along with the
+// reply, as they would otherwise pile up as events on the connection.
+Reply<xcb_get_property_reply_t> GetPropertyReply(
+    xcb_connection_t* connection, xcb_get_property_cookie_t cookie) {
+  xcb_generic_error_t* error = nullptr;
+  Reply<xcb_get_property_reply_t> reply(
+      ::xcb_get_property_reply(connection, cookie, &error));
+  std::free(error);
+  return reply;
+}
+
+std::string_view GetPropertyString(const xcb_get_property_reply_t* reply) {
+  if (!reply || reply->format != 8)
+    return {};
+  return {static_cast<const char*>(::xcb_get_property_value(reply)),
+          static_cast<size_t>(::xcb_get_property_value_length(reply))};
+}
+
+template <typename T>
+std::span<const T> GetPropertyValues(
+    const xcb_get_property_reply_t* reply) {
+  if (!reply || reply->format != 32)
+    return {};
+  return {static_cast<const T*>(::xcb_get_property_value(reply)),
+          static_cast<size_t>(::xcb_get_property_value_length(reply)) / 4};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string GetWindowClassName(const xcb_get_property_reply_t* reply) {
+  // WM_CLASS holds the instance name and then the class name, each terminated
+  // by a null character.
+  auto value = GetPropertyString(reply);
+  const auto pos = value.find('\0');
+  if (pos == std::string_view::npos)
+    return std::string();
+  value.remove_prefix(pos + 1);
+  return std::string(value.substr(0, value.find('\0')));
+}
+
+bool VerifyWindowType(const xcb_get_property_reply_t* reply,
+                      const atoms_t& atoms) {
+  // Toolbars, menus, notifications and the like. Windows without a type are
+  // treated as normal windows.
+  const auto types = GetPropertyValues<xcb_atom_t>(reply);
+  return types.empty() || types.front() == atoms[kNetWmWindowTypeNormal];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct Cookies {
+  xcb_get_property_cookie_t pid;
+  xcb_get_property_cookie_t type;
+  xcb_get_property_cookie_t class_name;
+  xcb_get_property_cookie_t name;
+  xcb_get_property_cookie_t legacy_name;
+};
+
+// Replies that are not waited for would otherwise be kept by the connection
+void DiscardReplies(xcb_connection_t* connection,
+                    std::span<const Cookies> cookies) {
+  for (const auto& c : cookies) {
+    ::xcb_discard_reply(connection, c.pid.sequence);
+    ::xcb_discard_reply(connection, c.type.sequence);
+    ::xcb_discard_reply(connection, c.class_name.sequence);
+    ::xcb_discard_reply(connection, c.name.sequence);
+    ::xcb_discard_reply(connection, c.legacy_name.sequence);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct WindowClient::Impl {
+  bool Connect();
+  void Disconnect();
+
+  std::mutex mutex;
+  Connection connection;
+  xcb_window_t root = XCB_WINDOW_NONE;
+  atoms_t atoms = {};
+  steady_clock::time_point last_attempt;
+  bool attempted = false;
+};
+
+bool WindowClient::Impl::Connect() {
+  if (connection && !::xcb_connection_has_error(connection.get()))
+    return true;
+
+  Disconnect();
+
+  const auto now = steady_clock::now();
+  if (attempted && now - last_attempt < kReconnectInterval)
+    return false;
+  attempted = true;
+  last_attempt = now;
+
+  // A connection is returned even if it failed, so that its error can be read
+  int screen_number = 0;
+  connection.reset(::xcb_connect(nullptr, &screen_number));
+  if (::xcb_connection_has_error(connection.get())) {
+    Disconnect();
+    return false;
+  }
+
+  auto screens = ::xcb_setup_roots_iterator(::xcb_get_setup(connection.get()));
+  for (int i = 0; i < screen_number && screens.rem; ++i) {
+    ::xcb_screen_next(&screens);
+  }
+  if (!screens.rem || !InternAtoms(connection.get(), atoms)) {
+    Disconnect();
+    return false;
+  }
+  root = screens.data->root;
+
+  attempted = false;
+  return true;
+}
+
+void WindowClient::Impl::Disconnect() {
+  connection.reset();
+  root = XCB_WINDOW_NONE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+WindowClient::WindowClient() : impl_(std::make_unique<Impl>()) {}
+
+WindowClient::~WindowClient() = default;
+
+bool WindowClient::EnumerateWindows(window_proc_t window_proc) {
+  if (!window_proc)
+    return false;
+
+  std::lock_guard lock(impl_->mutex);
+
+  if (!impl_->Connect())
+    return false;
+  xcb_connection_t* connection = impl_->connection.get();
+  const auto& atoms = impl_->atoms;
+
+  // Top-level windows that are managed by the window manager, in the order
+  // they were mapped. There is no reply if the connection has broken since,
+  // and no property if there is no such window manager.
+  constexpr uint32_t kMaxWindows = 4096;
+  const auto client_list = GetPropertyReply(
+      connection, GetProperty(connection, impl_->root, atoms[kNetClientList],
+                              XCB_ATOM_WINDOW, kMaxWindows * 4));
+  if (!client_list) {
+    if (::xcb_connection_has_error(connection))
+      impl_->Disconnect();
+    return false;
+  }
+  if (client_list->type == XCB_ATOM_NONE)
+    return false;
+  const auto windows = GetPropertyValues<xcb_window_t>(client_list.get());
+
+  // The same arbitrary limits as on Windows
+  constexpr uint32_t kMaxClassNameSize = 2 * 256;
+  constexpr uint32_t kMaxTextSize = 1024;
+
+  std::vector<Cookies> cookies;
+  cookies.reserve(windows.size());
+  for (const auto window : windows) {
+    auto& c = cookies.emplace_back();
+    c.pid = GetProperty(connection, window, atoms[kNetWmPid],
+                        XCB_ATOM_CARDINAL, 4);
+    c.type = GetProperty(connection, window, atoms[kNetWmWindowType],
+                         XCB_ATOM_ATOM, 4);
+    c.class_name = GetProperty(connection, window, XCB_ATOM_WM_CLASS,
+                               XCB_ATOM_STRING, kMaxClassNameSize);
+    c.name = GetProperty(connection, window, atoms[kNetWmName],
+                         atoms[kUtf8String], kMaxTextSize);
+    c.legacy_name = GetProperty(connection, window, XCB_ATOM_WM_NAME,
+                                XCB_ATOM_ANY, kMaxTextSize);
+  }
+
+  // Processes often own more than one window
+  std::map<process_id_t, std::string> process_names;
+
+  for (size_t i = 0; i < windows.size(); ++i) {
+    const auto& c = cookies[i];
+    const auto pid = GetPropertyReply(connection, c.pid);
+    const auto type = GetPropertyReply(connection, c.type);
+    const auto class_name = GetPropertyReply(connection, c.class_name);
+    const auto name = GetPropertyReply(connection, c.name);
+    const auto legacy_name = GetPropertyReply(connection, c.legacy_name);
+
+    if (!VerifyWindowType(type.get(), atoms))
+      continue;
+
+    const auto pids = GetPropertyValues<uint32_t>(pid.get());
+    if (pids.empty())
+      continue;
+
+    Window window;
+    window.handle = windows[i];
+    window.class_name = GetWindowClassName(class_name.get());
+    if (window.class_name.empty())
+      continue;
+
+    window.text = GetPropertyString(name.get());
+    if (window.text.empty())
+      window.text = GetPropertyString(legacy_name.get());
+
+    Process process;
+    process.id = pids.front();
+    auto [it, inserted] = process_names.try_emplace(process.id);
+    if (inserted)
+      it->second = GetProcessName(process.id);
+    process.name = it->second;
+    if (process.name.empty())
+      continue;
+
+    if (!window_proc(process, window)) {
+      DiscardReplies(connection, std::span(cookies).subspan(i + 1));
+      break;
+    }
+  }
+
+  // Windows whose replies were lost are not reported as if they had closed
+  if (::xcb_connection_has_error(connection)) {
+    impl_->Disconnect();
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace anisthesia::lin::detail
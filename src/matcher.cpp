@@ -0,0 +1,152 @@
+#include <string>
+#include <string_view>
+
+#include <anisthesia/matcher.hpp>
+#include <anisthesia/player_table.hpp>
+#include <anisthesia/regex.hpp>
+#include <anisthesia/util.hpp>
+
+namespace anisthesia {
+
+namespace detail::matcher {
+
+size_t CaseInsensitiveHash::operator()(std::string_view str) const {
+  // FNV-1a over lowercase characters
+  uint64_t hash = 0xCBF29CE484222325;
+  for (const auto c : str) {
+    const auto lower = ('A' <= c && c <= 'Z') ? c + ('a' - 'A') : c;
+    hash ^= static_cast<uint8_t>(lower);
+    hash *= 0x100000001B3;
+  }
+  return static_cast<size_t>(hash);
+}
+
+bool CaseInsensitiveEqual::operator()(std::string_view str1,
+                                      std::string_view str2) const {
+  return util::EqualStrings(str1, str2);
+}
+
+void AddPatterns(PatternIndex& index, uint32_t player_index,
+                 const StringRefRange& patterns) {
+  for (const auto pattern : patterns) {
+    if (pattern.empty())
+      continue;
+
+    if (pattern.front() == '^') {
+      if (index.regexes.size() <= player_index)
+        index.regexes.resize(player_index + 1);
+      index.regexes[player_index].emplace_back(pattern);
+      if (index.regex_players.empty() ||
+          index.regex_players.back() != player_index) {
+        index.regex_players.push_back(player_index);
+      }
+    } else {
+      auto& players = index.literals[std::string(pattern)];
+      if (players.empty() || players.back() != player_index)
+        players.push_back(player_index);
+    }
+  }
+}
+
+// Iterates over the sorted union of the players that have a matching literal,
+// and the players that have at least one regular expression.
+class Candidates {
+public:
+  static constexpr uint32_t kEnd = std::numeric_limits<uint32_t>::max();
+
+  Candidates(const PatternIndex& index, std::string_view str) : index_(index) {
+    const auto it = index.literals.find(str);
+    if (it != index.literals.end()) {
+      literal_ = it->second.data();
+      literal_end_ = literal_ + it->second.size();
+    }
+    regex_ = index.regex_players.data();
+    regex_end_ = regex_ + index.regex_players.size();
+  }
+
+  uint32_t current() const {
+    const auto a = literal_ != literal_end_ ? *literal_ : kEnd;
+    const auto b = regex_ != regex_end_ ? *regex_ : kEnd;
+    return a < b ? a : b;
+  }
+
+  void Advance(uint32_t player_index) {
+    while (literal_ != literal_end_ && *literal_ <= player_index)
+      ++literal_;
+    while (regex_ != regex_end_ && *regex_ <= player_index)
+      ++regex_;
+  }
+
+  void SkipTo(uint32_t player_index) {
+    if (player_index)
+      Advance(player_index - 1);
+  }
+
+  bool IsMatch(uint32_t player_index, std::string_view str) const {
+    if (IsLiteralMatch(player_index))
+      return true;
+    if (player_index >= index_.regexes.size())
+      return false;
+    for (const auto& regex : index_.regexes[player_index]) {
+      if (regex.Match(str))
+        return true;
+    }
+    return false;
+  }
+
+private:
+  // Must be called with the current index
+  bool IsLiteralMatch(uint32_t player_index) const {
+    return literal_ != literal_end_ && *literal_ == player_index;
+  }
+
+  const PatternIndex& index_;
+  const uint32_t* literal_ = nullptr;
+  const uint32_t* literal_end_ = nullptr;
+  const uint32_t* regex_ = nullptr;
+  const uint32_t* regex_end_ = nullptr;
+};
+
+}  // namespace detail::matcher
+
+////////////////////////////////////////////////////////////////////////////////
+
+PlayerMatcher::PlayerMatcher(const PlayerTable& players) {
+  for (uint32_t i = 0; i < players.size(); ++i) {
+    const auto player = players[i];
+    detail::matcher::AddPatterns(windows_, i, player.windows());
+    detail::matcher::AddPatterns(executables_, i, player.executables());
+  }
+}
+
+size_t PlayerMatcher::Match(std::string_view class_name,
+                            std::string_view executable) const {
+  using detail::matcher::Candidates;
+
+  Candidates windows(windows_, class_name);
+  Candidates executables(executables_, executable);
+
+  while (true) {
+    const auto a = windows.current();
+    const auto b = executables.current();
+    if (a == Candidates::kEnd || b == Candidates::kEnd)
+      break;
+
+    if (a < b) {
+      windows.SkipTo(b);
+    } else if (b < a) {
+      executables.SkipTo(a);
+    } else {
+      if (windows.IsMatch(a, class_name) &&
+          executables.IsMatch(a, executable)) {
+        return a;
+      }
+      windows.Advance(a);
+      executables.Advance(a);
+    }
+  }
+
+  return npos;
+}
+
+}  // namespace anisthesia
@@ -1,4 +1,22 @@
-#include <fstream>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <anisthesia/matroska.hpp>
 
@@ -6,14 +24,171 @@ namespace anisthesia::matroska {
 
 namespace detail {
 
-Buffer::Buffer(size_t size) {
-  data_.resize(size, '\0');
+uint64_t MemorySource::size() const {
+  return data_.size();
+}
+
+bool MemorySource::View(uint64_t offset, size_t size,
+                        std::span<const uint8_t>& bytes) {
+  if (offset > data_.size() || size > data_.size() - offset)
+    return false;
+  bytes = data_.subspan(static_cast<size_t>(offset), size);
+  CountView(size);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool MappedFileSource::Open(const std::string& path) {
+  return file_.Open(path);
+}
+
+uint64_t MappedFileSource::size() const {
+  return file_.size();
+}
+
+bool MappedFileSource::View(uint64_t offset, size_t size,
+                            std::span<const uint8_t>& bytes) {
+  if (offset > file_.size() || size > file_.size() - offset)
+    return false;
+  bytes = {reinterpret_cast<const uint8_t*>(file_.data()) + offset, size};
+  CountView(size);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FileSource::FileSource(size_t block_size) : block_size_(block_size) {}
+
+FileSource::~FileSource() {
+  Close();
 }
 
-uint8_t* Buffer::data() {
-  return !data_.empty() ? &data_.front() : nullptr;
+bool FileSource::Open(const std::string& path) {
+  Close();
+
+#ifdef _WIN32
+  // Files that players are still downloading are open for writing
+  const HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER file_size = {};
+  if (!::GetFileSizeEx(file, &file_size)) {
+    ::CloseHandle(file);
+    return false;
+  }
+
+  handle_ = file;
+  size_ = static_cast<uint64_t>(file_size.QuadPart);
+#else
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat st = {};
+  if (::fstat(fd, &st) != 0 || st.st_size < 0) {
+    ::close(fd);
+    return false;
+  }
+
+  fd_ = fd;
+  size_ = static_cast<uint64_t>(st.st_size);
+#endif
+
+  return true;
+}
+
+void FileSource::Close() {
+#ifdef _WIN32
+  if (handle_)
+    ::CloseHandle(handle_);
+  handle_ = nullptr;
+#else
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+#endif
+
+  size_ = 0;
+  buffer_offset_ = 0;
+  buffer_size_ = 0;
 }
 
+uint64_t FileSource::size() const {
+  return size_;
+}
+
+bool FileSource::View(uint64_t offset, size_t size,
+                      std::span<const uint8_t>& bytes) {
+  if (offset > size_ || size > size_ - offset)
+    return false;
+
+  const uint64_t buffer_end = buffer_offset_ + buffer_size_;
+  if (offset < buffer_offset_ || offset + size > buffer_end) {
+    // A jump past the buffer is most likely a skip over an element (e.g. a
+    // cluster), whose neighbour is skipped as well, so only a page is read.
+    constexpr size_t kPageSize = 0x1000;
+    const size_t block_size =
+        buffer_size_ && offset > buffer_end + block_size_
+            ? std::min(kPageSize, block_size_)
+            : block_size_;
+    if (!ReadAt(offset, std::max(size, block_size)) || size > buffer_size_)
+      return false;
+  }
+
+  bytes = {buffer_.get() + (offset - buffer_offset_), size};
+  CountView(size);
+  return true;
+}
+
+bool FileSource::ReadAt(uint64_t offset, size_t size) {
+  size = static_cast<size_t>(std::min<uint64_t>(size, size_ - offset));
+
+  // The buffer only grows for elements that are larger than a block
+  if (buffer_capacity_ < size) {
+    buffer_ = std::make_unique_for_overwrite<uint8_t[]>(size);
+    buffer_capacity_ = size;
+  }
+
+  buffer_offset_ = offset;
+  buffer_size_ = 0;
+
+  while (buffer_size_ < size) {
+    uint8_t* data = buffer_.get() + buffer_size_;
+    const uint64_t position = offset + buffer_size_;
+#ifdef _WIN32
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(position);
+    overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+    DWORD bytes_read = 0;
+    const auto length = static_cast<DWORD>(
+        std::min<size_t>(size - buffer_size_, 0x80000000));
+    if (!::ReadFile(handle_, data, length, &bytes_read, &overlapped))
+      return false;
+#else
+    const auto bytes_read = ::pread(fd_, data, size - buffer_size_,
+                                    static_cast<off_t>(position));
+    if (bytes_read < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+#endif
+    ++stats_.reads;
+    stats_.bytes_read += static_cast<uint64_t>(bytes_read);
+    if (bytes_read == 0)
+      break;  // the file has been truncated since it was opened
+    buffer_size_ += static_cast<size_t>(bytes_read);
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 size_t Buffer::pos() const {
   return pos_;
 }
@@ -22,139 +197,390 @@ size_t Buffer::size() const {
   return data_.size();
 }
 
-void Buffer::skip(size_t size) {
+bool Buffer::skip(size_t size) {
+  if (size > data_.size() - pos_)
+    return false;
   pos_ += size;
+  return true;
 }
 
-bool Buffer::read_encoded_value(uint32_t& value, bool clear_leading_bits) {
-  uint8_t base = 0x80;
-  size_t size = 0;
+bool Buffer::read_encoded_value(uint64_t& value, bool clear_leading_bits) {
+  if (pos_ >= data_.size())
+    return false;
 
-  for ( ; size <= 8; ++size) {
-    base = 0x80 >> size;
-    if (!base)
-      return false;
-    if (data_[pos_] & base)
-      break;
-  }
+  // The number of leading zero bits of the first byte tells the length
+  const uint8_t first = data_[pos_];
+  if (!first)
+    return false;
+  const size_t length = std::countl_zero(first) + 1;
+  if (length > data_.size() - pos_)
+    return false;
 
-  for (size_t i = 0; i <= size; ++i) {
-    const uint8_t b = (clear_leading_bits && i == 0) ? ~base : 0xFF;
-    value |= (data_[pos_ + i] & b) << ((size - i) * 8);
+  value = clear_leading_bits ? (first & (0xFF >> length)) : first;
+  for (size_t i = 1; i < length; ++i) {
+    value = (value << 8) | data_[pos_ + i];
   }
 
-  pos_ += size + 1;
+  pos_ += length;
   return true;
 }
 
-uint32_t Buffer::read_uint32(const size_t size) {
-  uint32_t value = 0;
+bool Buffer::read_uint(const size_t size, uint64_t& value) {
+  if (size > sizeof(uint64_t) || size > data_.size() - pos_)
+    return false;
+
+  value = 0;
   for (size_t i = 0; i < size; ++i) {
-    value |= (data_[pos_ + i] & 0xFF) << ((size - i - 1) * 8);
+    value = (value << 8) | data_[pos_ + i];
   }
+
   pos_ += size;
-  return value;
+  return true;
 }
 
-float Buffer::read_float(const size_t size) {
-  static_assert(sizeof(uint32_t) == sizeof(float), "Invalid float size");
+bool Buffer::read_float(const size_t size, double& value) {
+  uint64_t bits = 0;
   switch (size) {
-    case 4: {
-      auto u32 = read_uint32(size);
-      return reinterpret_cast<float&>(u32);  // @TODO: Is this safe?
-    }
+    case 0:
+      value = 0;
+      return true;
+    case 4:
+      if (!read_uint(size, bits))
+        return false;
+      value = std::bit_cast<float>(static_cast<uint32_t>(bits));
+      return true;
+    case 8:
+      if (!read_uint(size, bits))
+        return false;
+      value = std::bit_cast<double>(bits);
+      return true;
     default:
-      // @TODO: Do we need to handle 64-bit values? (i.e. size == 8)
-      pos_ += size;
-      return 0;
+      return false;
   }
 }
 
-std::string Buffer::read_string(const size_t size) {
-  auto result = std::string(
-      reinterpret_cast<const char*>(&data_.at(pos_)), size);
+bool Buffer::read_string(const size_t size, std::string& value) {
+  if (size > data_.size() - pos_)
+    return false;
+
+  // Strings may be padded with null characters
+  const auto data = reinterpret_cast<const char*>(data_.data() + pos_);
+  value.assign(data, ::strnlen(data, size));
+
   pos_ += size;
-  return result;
+  return true;
 }
 
-}  // namespace detail
-
 ////////////////////////////////////////////////////////////////////////////////
 
-bool ReadInfoFromFile(const std::string& path, Info& info) {
-  using namespace detail;
+// Element IDs are at most 4 bytes long, and data sizes 8 bytes
+constexpr size_t kMaxHeaderSize = 12;
+
+// Values that we read are short, and anything longer is considered corrupt
+constexpr uint64_t kMaxValueSize = 0x100000;
 
-  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
-  if (!file)
+struct ElementHeader {
+  uint32_t id = 0;
+  uint64_t offset = 0;  // of the data
+  uint64_t size = 0;
+
+  uint64_t end() const { return offset + size; }
+};
+
+// Elements whose size is unknown (e.g. those of a live stream), or exceeds
+// their parent (e.g. those of a file that is being downloaded), extend to the
+// end of their parent.
+bool ReadElementHeader(ByteSource& source, uint64_t offset, uint64_t end,
+                       ElementHeader& header) {
+  std::span<const uint8_t> bytes;
+  if (!source.View(offset, std::min<uint64_t>(kMaxHeaderSize, end - offset),
+                   bytes)) {
     return false;
+  }
 
-  // Determine file size
-  file.seekg(0, std::ios::end);
-  const auto file_size = static_cast<size_t>(file.tellg());
-  file.seekg(0, std::ios::beg);
+  Buffer buffer(bytes);
+  uint64_t id = 0;
+  uint64_t size = 0;
+  if (!buffer.read_encoded_value(id, false) || id > 0xFFFFFFFF)
+    return false;
+  const size_t size_pos = buffer.pos();
+  if (!buffer.read_encoded_value(size, true))
+    return false;
 
-  // Check EBML header
-  uint8_t m[sizeof(uint32_t)];
-  file.read(reinterpret_cast<char*>(m), sizeof(uint32_t));
-  const uint32_t magic = (m[0] << 24) | (m[1] << 16) | (m[2] << 8) | m[3];
-  if (magic != ElementId::kEBML)
-    return false;  // invalid Matroska file
+  const size_t size_length = buffer.pos() - size_pos;
+  const uint64_t unknown_size = (uint64_t{1} << (size_length * 7)) - 1;
 
-  uint32_t timecode_scale = kDefaultTimecodeScale;
-  uint32_t track_type = 0;
+  header.id = static_cast<uint32_t>(id);
+  header.offset = offset + buffer.pos();
+  if (header.offset > end)
+    return false;
+  header.size = (size == unknown_size || size > end - header.offset)
+                    ? end - header.offset
+                    : size;
 
-  for (size_t offset = 0; offset < file_size; ) {
-    // @TODO: Improve performance. fgetc takes a LOT of time (e.g. 5 seconds for
-    // a 1GB file) if the file isn't cached. mkvinfo is much faster.
-    Buffer buffer(0x1000);  // arbitrary size
-    file.seekg(offset);
-    file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+  return true;
+}
 
-    uint32_t element_id = 0;
-    uint32_t value_size = 0;
-    if (!buffer.read_encoded_value(element_id, false) ||
-        !buffer.read_encoded_value(value_size, true)) {
+// Calls `element_proc` for each element in the range, until it returns false.
+// Returns false if an element could not be read.
+template <typename Proc>
+bool ReadElements(ByteSource& source, uint64_t offset, uint64_t end,
+                  Proc element_proc) {
+  while (offset < end) {
+    ElementHeader header;
+    if (!ReadElementHeader(source, offset, end, header))
       return false;
-    }
+    if (!element_proc(header))
+      break;
+    offset = header.end();
+  }
 
-    switch (element_id) {
-      default:
-        buffer.skip(value_size);
-        break;
+  return true;
+}
 
-      case ElementId::kSegment:
-      case ElementId::kInfo:
-      case ElementId::kTracks:
-      case ElementId::kTrackEntry:
-        // We don't want to skip the data of these elements
-        break;
+bool ReadElementData(ByteSource& source, const ElementHeader& header,
+                     std::span<const uint8_t>& bytes) {
+  return header.size <= kMaxValueSize &&
+         source.View(header.offset, static_cast<size_t>(header.size), bytes);
+}
 
-      case ElementId::kTimecodeScale:
-        timecode_scale = buffer.read_uint32(value_size);
-        break;
-      case ElementId::kDuration:
-        info.duration = std::chrono::duration_cast<duration_t>(
-            timecode_scale_t{buffer.read_float(value_size) * timecode_scale});
-        break;
-      case ElementId::kTitle:
-        info.title = buffer.read_string(value_size);
-        break;
-      case ElementId::kTrackType:
-        track_type = buffer.read_uint32(value_size);
+bool ReadUInt(ByteSource& source, const ElementHeader& header,
+              uint64_t& value) {
+  std::span<const uint8_t> bytes;
+  return ReadElementData(source, header, bytes) &&
+         Buffer(bytes).read_uint(bytes.size(), value);
+}
+
+bool ReadFloat(ByteSource& source, const ElementHeader& header,
+               double& value) {
+  std::span<const uint8_t> bytes;
+  return ReadElementData(source, header, bytes) &&
+         Buffer(bytes).read_float(bytes.size(), value);
+}
+
+bool ReadString(ByteSource& source, const ElementHeader& header,
+                std::string& value) {
+  std::span<const uint8_t> bytes;
+  return ReadElementData(source, header, bytes) &&
+         Buffer(bytes).read_string(bytes.size(), value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ReadSegmentInfo(ByteSource& source, const ElementHeader& segment_info,
+                     Info& info) {
+  // Duration is a number of ticks, which may come before their scale
+  uint64_t timecode_scale = kDefaultTimecodeScale;
+  double duration = 0;
+
+  const bool success = ReadElements(
+      source, segment_info.offset, segment_info.end(),
+      [&](const ElementHeader& element) {
+        switch (element.id) {
+          case ElementId::kTimecodeScale:
+            ReadUInt(source, element, timecode_scale);
+            break;
+          case ElementId::kDuration:
+            ReadFloat(source, element, duration);
+            break;
+          case ElementId::kTitle:
+            ReadString(source, element, info.title);
+            break;
+        }
+        return true;
+      });
+
+  if (duration > 0) {
+    info.duration = std::chrono::duration_cast<duration_t>(
+        timecode_scale_t{duration * timecode_scale});
+  }
+
+  return success;
+}
+
+// Returns true if the entry is of a video track, whose name is then taken
+bool ReadTrackEntry(ByteSource& source, const ElementHeader& track_entry,
+                    Info& info) {
+  uint64_t track_type = 0;
+  std::string track_name;
+
+  ReadElements(source, track_entry.offset, track_entry.end(),
+               [&](const ElementHeader& element) {
+                 switch (element.id) {
+                   case ElementId::kTrackType:
+                     ReadUInt(source, element, track_type);
+                     break;
+                   case ElementId::kTrackName:
+                     ReadString(source, element, track_name);
+                     break;
+                 }
+                 return true;
+               });
+
+  if (track_type != TrackType::kVideo)
+    return false;
+
+  info.video_track_name = std::move(track_name);
+  return true;
+}
+
+bool ReadTracks(ByteSource& source, const ElementHeader& tracks, Info& info) {
+  // Only the first video track is of interest
+  return ReadElements(source, tracks.offset, tracks.end(),
+                      [&](const ElementHeader& element) {
+                        return element.id != ElementId::kTrackEntry ||
+                               !ReadTrackEntry(source, element, info);
+                      });
+}
+
+// Adds the position of each element that the index points to, relative to the
+// start of the segment data.
+bool ReadSeekHead(ByteSource& source, const ElementHeader& seek_head,
+                  std::vector<std::pair<uint32_t, uint64_t>>& positions) {
+  return ReadElements(
+      source, seek_head.offset, seek_head.end(),
+      [&](const ElementHeader& seek) {
+        if (seek.id != ElementId::kSeek)
+          return true;
+
+        uint64_t id = 0;
+        uint64_t position = 0;
+        bool has_id = false;
+        bool has_position = false;
+
+        ReadElements(source, seek.offset, seek.end(),
+                     [&](const ElementHeader& element) {
+                       switch (element.id) {
+                         case ElementId::kSeekID:
+                           has_id = ReadUInt(source, element, id);
+                           break;
+                         case ElementId::kSeekPosition:
+                           has_position = ReadUInt(source, element, position);
+                           break;
+                       }
+                       return true;
+                     });
+
+        if (has_id && has_position && id <= 0xFFFFFFFF)
+          positions.emplace_back(static_cast<uint32_t>(id), position);
+        return true;
+      });
+}
+
+// Segment Information and Tracks are what we are after. They are found through
+// the index (SeekHead) at the start of the segment, so that clusters, which
+// make up almost all of a file, are never walked. Files without an index, or
+// whose index is wrong, are scanned element by element until both are read.
+bool ReadSegment(ByteSource& source, const ElementHeader& segment,
+                 Info& info) {
+  bool found_info = false;
+  bool found_tracks = false;
+  bool success = true;
+
+  auto read_element = [&](const ElementHeader& element) {
+    switch (element.id) {
+      case ElementId::kInfo:
+        if (!found_info) {
+          found_info = true;
+          success &= ReadSegmentInfo(source, element, info);
+        }
         break;
-      case ElementId::kTrackName:
-        if (track_type == TrackType::kVideo) {
-          info.video_track_name = buffer.read_string(value_size);
-        } else {
-          buffer.skip(value_size);
+      case ElementId::kTracks:
+        if (!found_tracks) {
+          found_tracks = true;
+          success &= ReadTracks(source, element, info);
         }
         break;
     }
+    return found_info && found_tracks;
+  };
+
+  // The index comes first, but elements that precede it are read as well
+  std::vector<std::pair<uint32_t, uint64_t>> positions;
+  ReadElements(source, segment.offset, segment.end(),
+               [&](const ElementHeader& element) {
+                 if (element.id == ElementId::kSeekHead) {
+                   ReadSeekHead(source, element, positions);
+                   return false;
+                 }
+                 return !read_element(element) &&
+                        element.id != ElementId::kCluster;
+               });
+
+  // An index may point to another one (e.g. at the end of the file), which
+  // is followed once.
+  for (size_t i = 0; i < positions.size() && !(found_info && found_tracks);
+       ++i) {
+    const auto [id, position] = positions[i];
+    if (position >= segment.size)
+      continue;
+
+    ElementHeader element;
+    if (!ReadElementHeader(source, segment.offset + position, segment.end(),
+                           element) ||
+        element.id != id) {
+      continue;
+    }
 
-    offset += buffer.pos();
+    if (id == ElementId::kSeekHead) {
+      std::vector<std::pair<uint32_t, uint64_t>> more;
+      ReadSeekHead(source, element, more);
+      std::erase_if(more, [](const auto& item) {
+        return item.first == ElementId::kSeekHead;
+      });
+      positions.insert(positions.end(), more.begin(), more.end());
+    } else {
+      read_element(element);
+    }
   }
 
-  return true;
+  if (!(found_info && found_tracks)) {
+    ReadElements(source, segment.offset, segment.end(),
+                 [&](const ElementHeader& element) {
+                   return !read_element(element);
+                 });
+  }
+
+  return success;
+}
+
+bool ReadInfo(ByteSource& source, Info& info) {
+  // Check EBML header
+  ElementHeader header;
+  if (!ReadElementHeader(source, 0, source.size(), header) ||
+      header.id != ElementId::kEBML) {
+    return false;  // invalid Matroska file
+  }
+
+  bool success = false;
+
+  // Only the first segment is read
+  ReadElements(source, header.end(), source.size(),
+               [&](const ElementHeader& element) {
+                 if (element.id != ElementId::kSegment)
+                   return true;
+                 success = ReadSegment(source, element, info);
+                 return false;
+               });
+
+  return success;
+}
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ReadInfoFromFile(const std::string& path, Info& info) {
+  if (detail::MappedFileSource source; source.Open(path))
+    return detail::ReadInfo(source, info);
+
+  detail::FileSource source;
+  return source.Open(path) && detail::ReadInfo(source, info);
+}
+
+bool ReadInfoFromMemory(std::span<const uint8_t> data, Info& info) {
+  detail::MemorySource source(data);
+  return detail::ReadInfo(source, info);
 }
 
 }  // namespace anisthesia::matroska
@@ -1,6 +1,5 @@
-#include <map>
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <anisthesia/player.hpp>
@@ -16,11 +15,13 @@ enum class State {
   ExpectWindow,
   ExpectExecutable,
   ExpectStrategy,
+  ExpectOption,
+  ExpectExtension,
   ExpectType,
   ExpectWindowTitle,
 };
 
-size_t GetIndentation(const std::string& line) {
+size_t GetIndentation(std::string_view line) {
   return line.find_first_not_of('\t');
 }
 
@@ -38,6 +39,8 @@ bool HandleIndentation(const size_t current,
       case State::ExpectWindow:
       case State::ExpectExecutable:
       case State::ExpectStrategy:
+      case State::ExpectOption:
+      case State::ExpectExtension:
       case State::ExpectType:
         return 2;
       case State::ExpectWindowTitle:
@@ -68,6 +71,16 @@ bool HandleIndentation(const size_t current,
           return false;
         fix_state();
         break;
+      case State::ExpectOption:
+        if (players.back().options.empty())
+          return false;
+        fix_state();
+        break;
+      case State::ExpectExtension:
+        if (players.back().extensions.empty())
+          return false;
+        fix_state();
+        break;
       case State::ExpectType:
         fix_state();
         break;
@@ -79,69 +92,150 @@ bool HandleIndentation(const size_t current,
   return true;
 }
 
-bool HandleState(std::string& line, std::vector<Player>& players, State& state) {
+// Keywords are few and short, so they are recognized by their length and a
+// single comparison, rather than by a lookup in an associative container.
+bool ParseSection(std::string_view str, State& state) {
+  switch (str.size()) {
+    case 4:
+      if (str != "type")
+        return false;
+      state = State::ExpectType;
+      return true;
+    case 7:
+      if (str == "windows") {
+        state = State::ExpectWindow;
+        return true;
+      }
+      if (str == "options") {
+        state = State::ExpectOption;
+        return true;
+      }
+      return false;
+    case 10:
+      if (str == "strategies") {
+        state = State::ExpectStrategy;
+        return true;
+      }
+      if (str == "extensions") {
+        state = State::ExpectExtension;
+        return true;
+      }
+      return false;
+    case 11:
+      if (str != "executables")
+        return false;
+      state = State::ExpectExecutable;
+      return true;
+  }
+  return false;
+}
+
+bool ParseStrategy(std::string_view str, Strategy& strategy) {
+  switch (str.size()) {
+    case 5:
+      if (str != "mpris")
+        return false;
+      strategy = Strategy::Mpris;
+      return true;
+    case 10:
+      if (str != "open_files")
+        return false;
+      strategy = Strategy::OpenFiles;
+      return true;
+    case 12:
+      if (str != "window_title")
+        return false;
+      strategy = Strategy::WindowTitle;
+      return true;
+    case 13:
+      if (str != "ui_automation")
+        return false;
+      strategy = Strategy::UiAutomation;
+      return true;
+  }
+  return false;
+}
+
+bool ParsePlayerOption(std::string_view str, PlayerOption& option) {
+  switch (str.size()) {
+    case 10:
+      if (str != "exhaustive")
+        return false;
+      option = PlayerOption::Exhaustive;
+      return true;
+  }
+  return false;
+}
+
+bool ParsePlayerType(std::string_view str, PlayerType& type) {
+  switch (str.size()) {
+    case 7:
+      if (str != "default")
+        return false;
+      type = PlayerType::Default;
+      return true;
+    case 11:
+      if (str != "web_browser")
+        return false;
+      type = PlayerType::WebBrowser;
+      return true;
+  }
+  return false;
+}
+
+std::string_view TrimColons(std::string_view str) {
+  const auto pos = str.find_last_not_of(':');
+  return str.substr(0, pos != std::string_view::npos ? pos + 1 : 0);
+}
+
+bool HandleState(std::string_view line, std::vector<Player>& players,
+                 State& state) {
   switch (state) {
     case State::ExpectPlayerName:
-      players.push_back(Player());
-      players.back().name = line;
+      players.emplace_back().name = line;
       state = State::ExpectSection;
       break;
 
-    case State::ExpectSection: {
-      static const std::map<std::string, State> sections = {
-        {"windows", State::ExpectWindow},
-        {"executables", State::ExpectExecutable},
-        {"strategies", State::ExpectStrategy},
-        {"type", State::ExpectType},
-      };
-      util::TrimRight(line, ":");
-      const auto it = sections.find(line);
-      if (it == sections.end())
+    case State::ExpectSection:
+      if (!ParseSection(TrimColons(line), state))
         return false;
-      state = it->second;
       break;
-    }
 
     case State::ExpectWindow:
-      players.back().windows.push_back(line);
+      players.back().windows.emplace_back(line);
       break;
 
     case State::ExpectExecutable:
-      players.back().executables.push_back(line);
+      players.back().executables.emplace_back(line);
       break;
 
     case State::ExpectStrategy: {
-      static const std::map<std::string, Strategy> strategies = {
-        {"window_title", Strategy::WindowTitle},
-        {"open_files", Strategy::OpenFiles},
-        {"ui_automation", Strategy::UiAutomation},
-      };
-      util::TrimRight(line, ":");
-      const auto it = strategies.find(line);
-      if (it == strategies.end())
+      Strategy strategy;
+      if (!ParseStrategy(TrimColons(line), strategy))
         return false;
-      const auto strategy = it->second;
       players.back().strategies.push_back(strategy);
-      switch (strategy) {
-        case Strategy::WindowTitle:
-          state = State::ExpectWindowTitle;
-          break;
-      }
+      if (strategy == Strategy::WindowTitle)
+        state = State::ExpectWindowTitle;
       break;
     }
 
-    case State::ExpectType: {
-      static const std::map<std::string, PlayerType> types = {
-        {"default", PlayerType::Default},
-        {"web_browser", PlayerType::WebBrowser},
-      };
-      const auto it = types.find(line);
-      if (it == types.end())
+    case State::ExpectOption: {
+      PlayerOption option;
+      if (!ParsePlayerOption(line, option))
         return false;
-      players.back().type = it->second;
+      players.back().options.push_back(option);
       break;
     }
 
+    case State::ExpectExtension:
+      players.back().extensions.emplace_back(line);
+      break;
+
+    case State::ExpectType:
+      if (!ParsePlayerType(line, players.back().type))
+        return false;
+      break;
+
     case State::ExpectWindowTitle:
       players.back().window_title_format = line;
       state = State::ExpectStrategy;
@@ -151,30 +245,81 @@ bool HandleState(std::string& line, std::vector<Player>& players, State& state)
   return true;
 }
 
+// Splits the data into lines without copying. Trailing carriage returns are
+// excluded from the returned line.
+class LineReader {
+public:
+  explicit LineReader(std::string_view data) : data_(data) {}
+
+  bool Next(std::string_view& line) {
+    if (pos_ >= data_.size())
+      return false;
+
+    auto end = data_.find('\n', pos_);
+    if (end == std::string_view::npos)
+      end = data_.size();
+
+    line = data_.substr(pos_, end - pos_);
+    pos_ = end + 1;
+
+    while (!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+
+    return true;
+  }
+
+private:
+  std::string_view data_;
+  size_t pos_ = 0;
+};
+
+size_t CountPlayers(std::string_view data) {
+  // Player names are the only lines that begin with a non-whitespace
+  // character other than the comment sign.
+  size_t count = 0;
+  for (size_t pos = 0; pos < data.size(); ) {
+    const auto c = data[pos];
+    if (c != '\t' && c != '\r' && c != '\n' && c != '#')
+      ++count;
+    pos = data.find('\n', pos);
+    if (pos == std::string_view::npos)
+      break;
+    ++pos;
+  }
+  return count;
+}
+
 }  // namespace detail::parser
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool ParsePlayersData(const std::string& data, std::vector<Player>& players) {
+bool Player::has_option(PlayerOption option) const {
+  for (const auto value : options) {
+    if (value == option)
+      return true;
+  }
+  return false;
+}
+
+bool ParsePlayersData(std::string_view data, std::vector<Player>& players) {
   if (data.empty())
     return false;
 
-  std::istringstream stream(data);
-  std::string line;
-  size_t indentation = 0;
+  players.reserve(players.size() + detail::parser::CountPlayers(data));
+
+  detail::parser::LineReader reader(data);
+  std::string_view line;
   auto state = detail::parser::State::ExpectPlayerName;
 
-  while (std::getline(stream, line, '\n')) {
-    if (line.empty())
+  while (reader.Next(line)) {
+    const auto indentation = detail::parser::GetIndentation(line);
+    if (indentation == std::string_view::npos)
       continue;  // Ignore empty lines
 
-    indentation = detail::parser::GetIndentation(line);
-
-    detail::util::TrimLeft(line, "\t");
-    detail::util::TrimRight(line, "\n\r");
+    line.remove_prefix(indentation);
 
-    if (line.empty() || line.front() == '#')
-      continue;  // Ignore empty lines and comments
+    if (line.front() == '#')
+      continue;  // Ignore comments
 
     if (!detail::parser::HandleIndentation(indentation, players, state))
       return false;
@@ -0,0 +1,250 @@
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <anisthesia/builtin.hpp>
+#include <anisthesia/player.hpp>
+#include <anisthesia/player_table.hpp>
+#include <anisthesia/snapshot.hpp>
+
+namespace anisthesia {
+
+namespace detail::table {
+
+class Builder {
+public:
+  Builder(std::vector<PlayerRecord>& records,
+          std::vector<StringRef>& patterns,
+          std::string& strings)
+      : records_(records), patterns_(patterns), strings_(strings) {}
+
+  void Build(const std::vector<Player>& players);
+  void Build(std::span<const BuiltinPlayer> players);
+
+private:
+  StringRef Intern(std::string_view str);
+  template <typename Range>
+  void AddPatterns(const Range& patterns, uint32_t& begin, uint32_t& count);
+
+  std::vector<PlayerRecord>& records_;
+  std::vector<StringRef>& patterns_;
+  std::string& strings_;
+
+  // Keys refer to the source players, which outlive the builder
+  std::unordered_map<std::string_view, StringRef> interned_;
+};
+
+StringRef Builder::Intern(std::string_view str) {
+  const auto [it, inserted] = interned_.try_emplace(
+      str, StringRef{static_cast<uint32_t>(strings_.size()),
+                     static_cast<uint32_t>(str.size())});
+  if (inserted)
+    strings_.append(str);
+  return it->second;
+}
+
+template <typename Range>
+void Builder::AddPatterns(const Range& patterns,
+                          uint32_t& begin, uint32_t& count) {
+  begin = static_cast<uint32_t>(patterns_.size());
+  count = static_cast<uint32_t>(patterns.size());
+  for (const auto& pattern : patterns) {
+    patterns_.push_back(Intern(pattern));
+  }
+}
+
+void Builder::Build(const std::vector<Player>& players) {
+  size_t pattern_count = 0;
+  for (const auto& player : players) {
+    pattern_count += player.windows.size() + player.executables.size() +
+                     player.extensions.size();
+  }
+  records_.reserve(players.size());
+  patterns_.reserve(pattern_count);
+
+  for (const auto& player : players) {
+    PlayerRecord record = {};
+    record.name = Intern(player.name);
+    record.window_title_format = Intern(player.window_title_format);
+    AddPatterns(player.windows, record.windows_begin, record.windows_count);
+    AddPatterns(player.executables,
+                record.executables_begin, record.executables_count);
+    for (const auto strategy : player.strategies) {
+      record.strategies |= GetStrategyMask(strategy);
+    }
+    record.type = static_cast<uint32_t>(player.type);
+    for (const auto option : player.options) {
+      record.options |= GetPlayerOptionMask(option);
+    }
+    AddPatterns(player.extensions,
+                record.extensions_begin, record.extensions_count);
+    records_.push_back(record);
+  }
+
+  strings_.shrink_to_fit();
+}
+
+void Builder::Build(std::span<const BuiltinPlayer> players) {
+  size_t pattern_count = 0;
+  for (const auto& player : players) {
+    pattern_count += player.windows.size() + player.executables.size() +
+                     player.extensions.size();
+  }
+  records_.reserve(players.size());
+  patterns_.reserve(pattern_count);
+
+  for (const auto& player : players) {
+    PlayerRecord record = {};
+    record.name = Intern(player.name);
+    record.window_title_format = Intern(player.window_title_format);
+    AddPatterns(player.windows, record.windows_begin, record.windows_count);
+    AddPatterns(player.executables,
+                record.executables_begin, record.executables_count);
+    record.strategies = player.strategies;
+    record.type = static_cast<uint32_t>(player.type);
+    record.options = player.options;
+    AddPatterns(player.extensions,
+                record.extensions_begin, record.extensions_count);
+    records_.push_back(record);
+  }
+
+  strings_.shrink_to_fit();
+}
+
+}  // namespace detail::table
+
+////////////////////////////////////////////////////////////////////////////////
+
+PlayerType PlayerRef::type() const {
+  return static_cast<PlayerType>(record().type);
+}
+
+std::string_view PlayerRef::name() const {
+  return GetString(record().name);
+}
+
+std::string_view PlayerRef::window_title_format() const {
+  return GetString(record().window_title_format);
+}
+
+StringRefRange PlayerRef::windows() const {
+  return {strings_, patterns_ + record().windows_begin,
+          record().windows_count};
+}
+
+StringRefRange PlayerRef::executables() const {
+  return {strings_, patterns_ + record().executables_begin,
+          record().executables_count};
+}
+
+strategy_mask_t PlayerRef::strategies() const {
+  return record().strategies;
+}
+
+bool PlayerRef::has_strategy(Strategy strategy) const {
+  return (record().strategies & GetStrategyMask(strategy)) != 0;
+}
+
+player_option_mask_t PlayerRef::options() const {
+  return record().options;
+}
+
+bool PlayerRef::has_option(PlayerOption option) const {
+  return (record().options & GetPlayerOptionMask(option)) != 0;
+}
+
+StringRefRange PlayerRef::extensions() const {
+  return {strings_, patterns_ + record().extensions_begin,
+          record().extensions_count};
+}
+
+Player PlayerRef::ToPlayer() const {
+  Player player;
+  player.type = type();
+  player.name = name();
+  player.window_title_format = window_title_format();
+  for (const auto window : windows()) {
+    player.windows.emplace_back(window);
+  }
+  for (const auto executable : executables()) {
+    player.executables.emplace_back(executable);
+  }
+  for (const auto strategy : {Strategy::WindowTitle, Strategy::OpenFiles,
+                              Strategy::UiAutomation, Strategy::Mpris}) {
+    if (has_strategy(strategy))
+      player.strategies.push_back(strategy);
+  }
+  if (has_option(PlayerOption::Exhaustive))
+    player.options.push_back(PlayerOption::Exhaustive);
+  for (const auto extension : extensions()) {
+    player.extensions.emplace_back(extension);
+  }
+  return player;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct PlayerTable::Storage {
+  std::vector<detail::table::PlayerRecord> records;
+  std::vector<detail::table::StringRef> patterns;
+  std::string strings;
+};
+
+template <typename Players>
+std::shared_ptr<const PlayerTable::Storage> PlayerTable::Build(
+    const Players& players) {
+  auto storage = std::make_shared<Storage>();
+  detail::table::Builder builder(storage->records, storage->patterns,
+                                 storage->strings);
+  builder.Build(players);
+  return storage;
+}
+
+PlayerTable::PlayerTable(const std::vector<Player>& players)
+    : PlayerTable(Build(players)) {}
+
+PlayerTable::PlayerTable(std::span<const BuiltinPlayer> players)
+    : PlayerTable(Build(players)) {}
+
+PlayerTable::PlayerTable(std::shared_ptr<const Snapshot> snapshot) {
+  if (!snapshot)
+    return;
+  records_ = snapshot->records();
+  patterns_ = snapshot->patterns();
+  strings_ = snapshot->strings();
+  owner_ = std::move(snapshot);
+}
+
+PlayerTable::PlayerTable(std::shared_ptr<const Storage> storage)
+    : records_(storage->records), patterns_(storage->patterns),
+      strings_(storage->strings), owner_(std::move(storage)) {}
+
+bool PlayerTable::empty() const {
+  return records_.empty();
+}
+
+size_t PlayerTable::size() const {
+  return records_.size();
+}
+
+PlayerRef PlayerTable::operator[](size_t index) const {
+  return {records_.data(), static_cast<uint32_t>(index),
+          patterns_.data(), strings_.data()};
+}
+
+std::span<const detail::table::PlayerRecord> PlayerTable::records() const {
+  return records_;
+}
+
+std::span<const detail::table::StringRef> PlayerTable::patterns() const {
+  return patterns_;
+}
+
+std::string_view PlayerTable::strings() const {
+  return strings_;
+}
+
+}  // namespace anisthesia
@@ -0,0 +1,968 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include <anisthesia/regex.hpp>
+
+namespace anisthesia::regex {
+
+namespace detail {
+
+constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+// Counted repetitions are expanded by copying, so the program size must be
+// bounded to keep compilation cheap for patterns such as "(a{100}){100}".
+constexpr size_t kMaxInstructions = 10000;
+constexpr uint32_t kMaxRepeat = 1000;
+constexpr uint32_t kInfinite = std::numeric_limits<uint32_t>::max();
+
+struct Node {
+  enum class Type {
+    Empty,
+    Byte,
+    Any,
+    Class,
+    Concat,
+    Alternate,
+    Repeat,
+    Group,
+    Begin,
+    End,
+  };
+
+  Type type = Type::Empty;
+  uint8_t byte = 0;
+  size_t class_index = 0;
+  uint32_t min = 0;
+  uint32_t max = 0;
+  bool greedy = true;
+  size_t group = npos;  // npos for non-capturing groups
+  std::vector<std::unique_ptr<Node>> children;
+};
+
+using node_t = std::unique_ptr<Node>;
+
+node_t MakeNode(Node::Type type) {
+  auto node = std::make_unique<Node>();
+  node->type = type;
+  return node;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Parser {
+public:
+  Parser(std::string_view pattern, Program& program)
+      : pattern_(pattern), program_(program) {}
+
+  node_t Parse() {
+    auto node = ParseAlternation();
+    if (!node || pos_ != pattern_.size())
+      return nullptr;
+    return node;
+  }
+
+private:
+  bool AtEnd() const { return pos_ >= pattern_.size(); }
+  char Peek() const { return pattern_[pos_]; }
+
+  bool Consume(char c) {
+    if (AtEnd() || Peek() != c)
+      return false;
+    ++pos_;
+    return true;
+  }
+
+  node_t ParseAlternation();
+  node_t ParseConcatenation();
+  node_t ParseRepetition();
+  node_t ParseAtom();
+  node_t ParseGroup();
+  node_t ParseClass();
+  bool ParseEscape(byte_set_t& set, bool& is_set, uint8_t& byte);
+  bool ParseNumber(uint32_t& value);
+
+  node_t MakeClassNode(const byte_set_t& set) {
+    auto node = MakeNode(Node::Type::Class);
+    node->class_index = program_.classes.size();
+    program_.classes.push_back(set);
+    return node;
+  }
+
+  std::string_view pattern_;
+  size_t pos_ = 0;
+  Program& program_;
+};
+
+node_t Parser::ParseAlternation() {
+  auto first = ParseConcatenation();
+  if (!first)
+    return nullptr;
+  if (AtEnd() || Peek() != '|')
+    return first;
+
+  auto node = MakeNode(Node::Type::Alternate);
+  node->children.push_back(std::move(first));
+  while (Consume('|')) {
+    auto next = ParseConcatenation();
+    if (!next)
+      return nullptr;
+    node->children.push_back(std::move(next));
+  }
+  return node;
+}
+
+node_t Parser::ParseConcatenation() {
+  auto node = MakeNode(Node::Type::Concat);
+  while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+    auto child = ParseRepetition();
+    if (!child)
+      return nullptr;
+    node->children.push_back(std::move(child));
+  }
+  return node;
+}
+
+bool Parser::ParseNumber(uint32_t& value) {
+  const auto begin = pos_;
+  value = 0;
+  while (!AtEnd() && '0' <= Peek() && Peek() <= '9') {
+    value = value * 10 + (Peek() - '0');
+    if (value > kMaxRepeat)
+      return false;
+    ++pos_;
+  }
+  return pos_ > begin;
+}
+
+node_t Parser::ParseRepetition() {
+  auto atom = ParseAtom();
+  if (!atom)
+    return nullptr;
+
+  if (AtEnd())
+    return atom;
+
+  uint32_t min = 0;
+  uint32_t max = kInfinite;
+
+  switch (Peek()) {
+    case '*':
+      ++pos_;
+      break;
+    case '+':
+      ++pos_;
+      min = 1;
+      break;
+    case '?':
+      ++pos_;
+      max = 1;
+      break;
+    case '{':
+      ++pos_;
+      if (!ParseNumber(min))
+        return nullptr;
+      if (Consume(',')) {
+        if (!AtEnd() && Peek() != '}' && !ParseNumber(max))
+          return nullptr;
+      } else {
+        max = min;
+      }
+      if (!Consume('}') || min > max)
+        return nullptr;
+      break;
+    default:
+      return atom;
+  }
+
+  // Anchors cannot be quantified in ECMAScript
+  if (atom->type == Node::Type::Begin || atom->type == Node::Type::End)
+    return nullptr;
+
+  auto node = MakeNode(Node::Type::Repeat);
+  node->min = min;
+  node->max = max;
+  node->greedy = !Consume('?');
+  node->children.push_back(std::move(atom));
+
+  // Quantifiers cannot be stacked (e.g. "a**")
+  if (!AtEnd() && (Peek() == '*' || Peek() == '+' || Peek() == '?' ||
+                   Peek() == '{')) {
+    return nullptr;
+  }
+
+  return node;
+}
+
+node_t Parser::ParseAtom() {
+  const char c = Peek();
+
+  switch (c) {
+    case '(':
+      return ParseGroup();
+    case '[':
+      return ParseClass();
+    case '.':
+      ++pos_;
+      return MakeNode(Node::Type::Any);
+    case '^':
+      ++pos_;
+      return MakeNode(Node::Type::Begin);
+    case '$':
+      ++pos_;
+      return MakeNode(Node::Type::End);
+    case '\\': {
+      ++pos_;
+      byte_set_t set;
+      bool is_set = false;
+      uint8_t byte = 0;
+      if (!ParseEscape(set, is_set, byte))
+        return nullptr;
+      if (is_set)
+        return MakeClassNode(set);
+      auto node = MakeNode(Node::Type::Byte);
+      node->byte = byte;
+      return node;
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case ')':
+    case ']':
+    case '}':
+    case '|':
+      return nullptr;  // nothing to repeat, or unbalanced
+    default: {
+      ++pos_;
+      auto node = MakeNode(Node::Type::Byte);
+      node->byte = static_cast<uint8_t>(c);
+      return node;
+    }
+  }
+}
+
+node_t Parser::ParseGroup() {
+  ++pos_;  // (
+
+  auto node = MakeNode(Node::Type::Group);
+  if (Consume('?')) {
+    if (!Consume(':'))
+      return nullptr;  // lookarounds are not supported
+  } else {
+    node->group = ++program_.group_count;
+  }
+
+  auto child = ParseAlternation();
+  if (!child || !Consume(')'))
+    return nullptr;
+
+  node->children.push_back(std::move(child));
+  return node;
+}
+
+bool Parser::ParseEscape(byte_set_t& set, bool& is_set, uint8_t& byte) {
+  if (AtEnd())
+    return false;
+
+  const char c = pattern_[pos_++];
+
+  auto set_range = [&set](char first, char last) {
+    for (int i = first; i <= last; ++i)
+      set.set(static_cast<uint8_t>(i));
+  };
+  auto set_class = [&](char lower) {
+    is_set = true;
+    switch (lower) {
+      case 'd':
+        set_range('0', '9');
+        break;
+      case 'w':
+        set_range('0', '9');
+        set_range('A', 'Z');
+        set_range('a', 'z');
+        set.set('_');
+        break;
+      case 's':
+        for (const char s : {' ', '\t', '\n', '\v', '\f', '\r'})
+          set.set(static_cast<uint8_t>(s));
+        break;
+    }
+  };
+
+  auto parse_hex = [this, &byte](size_t digits) {
+    if (pos_ + digits > pattern_.size())
+      return false;
+    uint32_t value = 0;
+    for (size_t i = 0; i < digits; ++i) {
+      const char h = pattern_[pos_++];
+      value <<= 4;
+      if ('0' <= h && h <= '9') value |= h - '0';
+      else if ('a' <= h && h <= 'f') value |= h - 'a' + 10;
+      else if ('A' <= h && h <= 'F') value |= h - 'A' + 10;
+      else return false;
+    }
+    if (value > 0xFF)
+      return false;  // code points are not supported in byte mode
+    byte = static_cast<uint8_t>(value);
+    return true;
+  };
+
+  switch (c) {
+    case 'd':
+    case 'w':
+    case 's':
+      set_class(c);
+      return true;
+    case 'D':
+    case 'W':
+    case 'S':
+      set_class(static_cast<char>(c + ('a' - 'A')));
+      set.flip();
+      return true;
+    case 't': byte = '\t'; return true;
+    case 'n': byte = '\n'; return true;
+    case 'v': byte = '\v'; return true;
+    case 'f': byte = '\f'; return true;
+    case 'r': byte = '\r'; return true;
+    case '0': byte = '\0'; return true;
+    case 'x': return parse_hex(2);
+    case 'u': return parse_hex(4);
+    default:
+      // Backreferences, word boundaries and other letter escapes are not
+      // supported. Any other character stands for itself.
+      if (('0' <= c && c <= '9') || ('A' <= c && c <= 'Z') ||
+          ('a' <= c && c <= 'z')) {
+        return false;
+      }
+      byte = static_cast<uint8_t>(c);
+      return true;
+  }
+}
+
+node_t Parser::ParseClass() {
+  ++pos_;  // [
+
+  const bool negate = Consume('^');
+  byte_set_t set;
+
+  // Reads one class atom, which is either a single byte or a set escape
+  auto read_atom = [this](byte_set_t& atom_set, bool& is_set,
+                          uint8_t& byte) -> bool {
+    if (AtEnd())
+      return false;
+    const char c = pattern_[pos_++];
+    if (c == '\\') {
+      if (!AtEnd() && Peek() == 'b') {
+        ++pos_;
+        byte = '\b';  // backspace within a class
+        return true;
+      }
+      return ParseEscape(atom_set, is_set, byte);
+    }
+    byte = static_cast<uint8_t>(c);
+    return true;
+  };
+
+  while (!AtEnd() && Peek() != ']') {
+    byte_set_t first_set;
+    bool first_is_set = false;
+    uint8_t first = 0;
+    if (!read_atom(first_set, first_is_set, first))
+      return nullptr;
+
+    // Range, unless '-' is the last character of the class
+    if (!first_is_set && pos_ + 1 < pattern_.size() && Peek() == '-' &&
+        pattern_[pos_ + 1] != ']') {
+      ++pos_;
+      byte_set_t last_set;
+      bool last_is_set = false;
+      uint8_t last = 0;
+      if (!read_atom(last_set, last_is_set, last) || last_is_set ||
+          last < first) {
+        return nullptr;
+      }
+      for (int i = first; i <= last; ++i)
+        set.set(static_cast<uint8_t>(i));
+      continue;
+    }
+
+    if (first_is_set) {
+      set |= first_set;
+    } else {
+      set.set(first);
+    }
+  }
+
+  if (!Consume(']'))
+    return nullptr;
+
+  if (negate)
+    set.flip();
+
+  return MakeClassNode(set);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Emitter {
+public:
+  explicit Emitter(Program& program) : program_(program) {}
+
+  bool Emit(const Node& node);
+
+private:
+  uint32_t pc() const {
+    return static_cast<uint32_t>(program_.instructions.size());
+  }
+
+  uint32_t Add(Opcode opcode, uint32_t x = 0, uint32_t y = 0) {
+    Instruction instruction;
+    instruction.opcode = opcode;
+    instruction.x = x;
+    instruction.y = y;
+    program_.instructions.push_back(instruction);
+    return pc() - 1;
+  }
+
+  bool EmitRepeat(const Node& node);
+
+  Program& program_;
+};
+
+bool Emitter::Emit(const Node& node) {
+  if (program_.instructions.size() > kMaxInstructions)
+    return false;
+
+  switch (node.type) {
+    case Node::Type::Empty:
+      return true;
+
+    case Node::Type::Byte: {
+      const auto index = Add(Opcode::Byte);
+      program_.instructions[index].byte = node.byte;
+      return true;
+    }
+
+    case Node::Type::Any:
+      Add(Opcode::Any);
+      return true;
+
+    case Node::Type::Class:
+      Add(Opcode::Class, static_cast<uint32_t>(node.class_index));
+      return true;
+
+    case Node::Type::Begin:
+      Add(Opcode::AssertBegin);
+      return true;
+
+    case Node::Type::End:
+      Add(Opcode::AssertEnd);
+      return true;
+
+    case Node::Type::Concat:
+      for (const auto& child : node.children) {
+        if (!Emit(*child))
+          return false;
+      }
+      return true;
+
+    case Node::Type::Alternate: {
+      //     split L1, next
+      // L1: child 1
+      //     jump end
+      // ...
+      std::vector<uint32_t> jumps;
+      for (size_t i = 0; i < node.children.size(); ++i) {
+        const bool last = i + 1 == node.children.size();
+        const auto split = last ? 0 : Add(Opcode::Split);
+        if (!last)
+          program_.instructions[split].x = pc();
+        if (!Emit(*node.children[i]))
+          return false;
+        if (!last) {
+          jumps.push_back(Add(Opcode::Jump));
+          program_.instructions[split].y = pc();
+        }
+      }
+      for (const auto jump : jumps) {
+        program_.instructions[jump].x = pc();
+      }
+      return true;
+    }
+
+    case Node::Type::Group:
+      if (node.group != npos)
+        Add(Opcode::Save, static_cast<uint32_t>(node.group * 2));
+      if (!Emit(*node.children.front()))
+        return false;
+      if (node.group != npos)
+        Add(Opcode::Save, static_cast<uint32_t>(node.group * 2 + 1));
+      return true;
+
+    case Node::Type::Repeat:
+      return EmitRepeat(node);
+  }
+
+  return false;
+}
+
+bool Emitter::EmitRepeat(const Node& node) {
+  const auto& child = *node.children.front();
+
+  auto split = [&](uint32_t preferred, uint32_t other) {
+    return node.greedy ? Add(Opcode::Split, preferred, other)
+                       : Add(Opcode::Split, other, preferred);
+  };
+  auto patch_split = [&](uint32_t index, uint32_t preferred, uint32_t other) {
+    auto& instruction = program_.instructions[index];
+    instruction.x = node.greedy ? preferred : other;
+    instruction.y = node.greedy ? other : preferred;
+  };
+
+  // Mandatory copies
+  const uint32_t mandatory = node.max == kInfinite && node.min > 0
+                                 ? node.min - 1
+                                 : node.min;
+  for (uint32_t i = 0; i < mandatory; ++i) {
+    if (!Emit(child))
+      return false;
+  }
+
+  if (node.max == kInfinite) {
+    if (node.min > 0) {
+      // L1: child
+      //     split L1, L2
+      // L2:
+      const auto begin = pc();
+      if (!Emit(child))
+        return false;
+      split(begin, pc() + 1);
+    } else {
+      // L1: split L2, L3
+      // L2: child
+      //     jump L1
+      // L3:
+      const auto begin = split(0, 0);
+      if (!Emit(child))
+        return false;
+      Add(Opcode::Jump, begin);
+      patch_split(begin, begin + 1, pc());
+    }
+    return true;
+  }
+
+  // Optional copies, each nested in the previous one:
+  //     split L1, end
+  // L1: child
+  //     split L2, end
+  // L2: child
+  // end:
+  std::vector<uint32_t> splits;
+  for (uint32_t i = node.min; i < node.max; ++i) {
+    splits.push_back(split(0, 0));
+    if (!Emit(child))
+      return false;
+  }
+  for (const auto index : splits) {
+    patch_split(index, index + 1, pc());
+  }
+
+  return program_.instructions.size() <= kMaxInstructions;
+}
+
+bool Compile(std::string_view pattern, Program& program) {
+  program = Program();
+
+  Parser parser(pattern, program);
+  const auto root = parser.Parse();
+  if (!root)
+    return false;
+
+  // The whole match is saved as group 0
+  Emitter emitter(program);
+  program.instructions.push_back({Opcode::Save, 0, 0, 0});
+  if (!emitter.Emit(*root))
+    return false;
+  program.instructions.push_back({Opcode::Save, 0, 1, 0});
+  program.instructions.push_back({Opcode::Match});
+
+  return program.instructions.size() <= kMaxInstructions;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Consumes(const Program& program, const Instruction& instruction,
+              uint8_t byte) {
+  switch (instruction.opcode) {
+    case Opcode::Byte:
+      return instruction.byte == byte;
+    case Opcode::Any:
+      return byte != '\n' && byte != '\r';
+    case Opcode::Class:
+      return program.classes[instruction.x].test(byte);
+    default:
+      return false;
+  }
+}
+
+Dfa::Dfa(const Program& program, bool search)
+    : program_(program), search_(search) {
+  visited_.resize(program.instructions.size(), 0);
+
+  // Patterns can only match at the beginning of input after this point
+  ++generation_;
+  AddClosure(0, false, false, start_pcs_);
+  std::sort(start_pcs_.begin(), start_pcs_.end());
+
+  // State 0 is the initial state
+  std::vector<uint32_t> pcs;
+  ++generation_;
+  AddClosure(0, true, false, pcs);
+  GetState(pcs);
+}
+
+void Dfa::AddClosure(uint32_t pc, bool at_begin, bool at_end,
+                     std::vector<uint32_t>& pcs) {
+  // Explicit stack, because programs may be long
+  std::vector<uint32_t> stack{pc};
+
+  while (!stack.empty()) {
+    pc = stack.back();
+    stack.pop_back();
+
+    if (visited_[pc] == generation_)
+      continue;
+    visited_[pc] = generation_;
+
+    const auto& instruction = program_.instructions[pc];
+    switch (instruction.opcode) {
+      case Opcode::Split:
+        stack.push_back(instruction.y);
+        stack.push_back(instruction.x);
+        break;
+      case Opcode::Jump:
+        stack.push_back(instruction.x);
+        break;
+      case Opcode::Save:
+        stack.push_back(pc + 1);
+        break;
+      case Opcode::AssertBegin:
+        if (at_begin)
+          stack.push_back(pc + 1);
+        break;
+      case Opcode::AssertEnd:
+        if (at_end) {
+          stack.push_back(pc + 1);
+        } else {
+          pcs.push_back(pc);  // might be satisfied if input ends here
+        }
+        break;
+      default:
+        pcs.push_back(pc);
+        break;
+    }
+  }
+}
+
+int32_t Dfa::GetState(std::vector<uint32_t>& pcs) {
+  std::sort(pcs.begin(), pcs.end());
+
+  if (pcs.empty())
+    return kDead;
+
+  const auto it = state_map_.find(pcs);
+  if (it != state_map_.end())
+    return it->second;
+
+  if (states_.size() >= kMaxStates)
+    return kUnknown;
+
+  State state;
+  state.next.fill(kUnknown);
+  state.pcs = pcs;
+
+  std::vector<uint32_t> end_pcs;
+  ++generation_;
+  for (const auto pc : pcs) {
+    const auto opcode = program_.instructions[pc].opcode;
+    if (opcode == Opcode::Match) {
+      state.match = true;
+      end_pcs.push_back(pc);
+    } else if (opcode == Opcode::AssertEnd) {
+      AddClosure(pc + 1, false, true, end_pcs);
+    }
+  }
+  state.match_at_end = std::any_of(
+      end_pcs.begin(), end_pcs.end(), [this](uint32_t pc) {
+        return program_.instructions[pc].opcode == Opcode::Match;
+      });
+
+  const auto index = static_cast<int32_t>(states_.size());
+  states_.push_back(std::move(state));
+  state_map_.emplace(pcs, index);
+
+  return index;
+}
+
+int32_t Dfa::Step(int32_t state, uint8_t byte) {
+  const auto cached = states_[state].next[byte];
+  if (cached != kUnknown)
+    return cached;
+
+  std::vector<uint32_t> pcs;
+  ++generation_;
+  for (const auto pc : states_[state].pcs) {
+    if (Consumes(program_, program_.instructions[pc], byte))
+      AddClosure(pc + 1, false, false, pcs);
+  }
+  if (search_) {
+    for (const auto pc : start_pcs_) {
+      if (visited_[pc] != generation_) {
+        visited_[pc] = generation_;
+        pcs.push_back(pc);
+      }
+    }
+  }
+
+  const auto next = GetState(pcs);
+  if (next != kUnknown)
+    states_[state].next[byte] = next;
+
+  return next;
+}
+
+Dfa::Result Dfa::Run(std::string_view str) {
+  int32_t state = 0;
+
+  for (const auto c : str) {
+    if (search_ && states_[state].match)
+      return Result::Match;
+
+    state = Step(state, static_cast<uint8_t>(c));
+    if (state == kDead)
+      return Result::NoMatch;
+    if (state == kUnknown)
+      return Result::GaveUp;
+  }
+
+  const auto& last = states_[state];
+  return (last.match && search_) || last.match_at_end ? Result::Match
+                                                      : Result::NoMatch;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class PikeVm {
+public:
+  PikeVm(const Program& program, std::string_view str)
+      : program_(program), str_(str),
+        slot_count_(2 * (program.group_count + 1)) {
+    const auto size = program.instructions.size();
+    for (auto* list : {&current_, &next_}) {
+      list->pcs.reserve(size);
+      list->slots.resize(size * slot_count_);
+    }
+    visited_.resize(size, 0);
+  }
+
+  bool Run(bool search, std::vector<size_t>* result);
+
+private:
+  struct ThreadList {
+    std::vector<uint32_t> pcs;
+    std::vector<size_t> slots;  // slot_count_ entries per thread
+  };
+
+  void AddThread(ThreadList& list, uint32_t pc, size_t pos,
+                 std::vector<size_t>& slots);
+
+  const Program& program_;
+  std::string_view str_;
+  const size_t slot_count_;
+  ThreadList current_;
+  ThreadList next_;
+  std::vector<size_t> visited_;
+  size_t generation_ = 0;
+};
+
+void PikeVm::AddThread(ThreadList& list, uint32_t pc, size_t pos,
+                       std::vector<size_t>& slots) {
+  if (visited_[pc] == generation_)
+    return;
+  visited_[pc] = generation_;
+
+  const auto& instruction = program_.instructions[pc];
+  switch (instruction.opcode) {
+    case Opcode::Split:
+      AddThread(list, instruction.x, pos, slots);
+      AddThread(list, instruction.y, pos, slots);
+      break;
+    case Opcode::Jump:
+      AddThread(list, instruction.x, pos, slots);
+      break;
+    case Opcode::Save: {
+      const auto previous = slots[instruction.x];
+      slots[instruction.x] = pos;
+      AddThread(list, pc + 1, pos, slots);
+      slots[instruction.x] = previous;
+      break;
+    }
+    case Opcode::AssertBegin:
+      if (pos == 0)
+        AddThread(list, pc + 1, pos, slots);
+      break;
+    case Opcode::AssertEnd:
+      if (pos == str_.size())
+        AddThread(list, pc + 1, pos, slots);
+      break;
+    default: {
+      const auto index = list.pcs.size();
+      list.pcs.push_back(pc);
+      std::copy(slots.begin(), slots.end(),
+                list.slots.begin() + index * slot_count_);
+      break;
+    }
+  }
+}
+
+bool PikeVm::Run(bool search, std::vector<size_t>* result) {
+  std::vector<size_t> slots(slot_count_, npos);
+  bool matched = false;
+
+  current_.pcs.clear();
+  ++generation_;
+  AddThread(current_, 0, 0, slots);
+
+  for (size_t pos = 0; pos <= str_.size(); ++pos) {
+    if (current_.pcs.empty() && (!search || matched))
+      break;
+
+    next_.pcs.clear();
+    ++generation_;
+
+    for (size_t i = 0; i < current_.pcs.size(); ++i) {
+      const auto pc = current_.pcs[i];
+      const auto& instruction = program_.instructions[pc];
+      const auto thread_slots = current_.slots.begin() + i * slot_count_;
+
+      if (instruction.opcode == Opcode::Match) {
+        if (!search && pos != str_.size())
+          continue;  // must match the entire input
+        matched = true;
+        if (result)
+          result->assign(thread_slots, thread_slots + slot_count_);
+        break;  // lower priority threads are cut off
+      }
+
+      if (pos < str_.size() &&
+          Consumes(program_, instruction, static_cast<uint8_t>(str_[pos]))) {
+        std::copy(thread_slots, thread_slots + slot_count_, slots.begin());
+        AddThread(next_, pc + 1, pos + 1, slots);
+      }
+    }
+
+    // Unanchored searches start a new thread at each position, with the
+    // lowest priority, until a match is found.
+    if (search && !matched && pos < str_.size()) {
+      std::fill(slots.begin(), slots.end(), npos);
+      AddThread(next_, 0, pos + 1, slots);
+    }
+
+    std::swap(current_, next_);
+  }
+
+  return matched;
+}
+
+bool RunPikeVm(const Program& program, std::string_view str, bool search,
+               std::vector<size_t>* slots) {
+  PikeVm vm(program, str);
+  return vm.Run(search, slots);
+}
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////
+
+Regex::Regex(std::string_view pattern) {
+  auto program = std::make_shared<detail::Program>();
+  if (detail::Compile(pattern, *program)) {
+    program_ = std::move(program);
+    cache_ = std::make_unique<Cache>();
+  }
+}
+
+Regex::Regex(const Regex& other) : program_(other.program_) {
+  if (program_)
+    cache_ = std::make_unique<Cache>();
+}
+
+Regex& Regex::operator=(const Regex& other) {
+  if (this != &other) {
+    program_ = other.program_;
+    cache_ = program_ ? std::make_unique<Cache>() : nullptr;
+  }
+  return *this;
+}
+
+bool Regex::valid() const {
+  return program_ != nullptr;
+}
+
+size_t Regex::group_count() const {
+  return program_ ? program_->group_count : 0;
+}
+
+bool Regex::RunDfa(std::string_view str, bool search) const {
+  auto result = detail::Dfa::Result::GaveUp;
+
+  {
+    std::lock_guard lock(cache_->mutex);
+    auto& dfa = search ? cache_->search : cache_->match;
+    if (!dfa)
+      dfa = std::make_unique<detail::Dfa>(*program_, search);
+    result = dfa->Run(str);
+  }
+
+  if (result == detail::Dfa::Result::GaveUp)
+    return detail::RunPikeVm(*program_, str, search, nullptr);
+
+  return result == detail::Dfa::Result::Match;
+}
+
+bool Regex::Match(std::string_view str) const {
+  return program_ && RunDfa(str, false);
+}
+
+bool Regex::Match(std::string_view str,
+                  std::vector<std::string_view>& groups) const {
+  groups.clear();
+
+  if (!program_)
+    return false;
+
+  std::vector<size_t> slots;
+  if (!detail::RunPikeVm(*program_, str, false, &slots))
+    return false;
+
+  groups.reserve(slots.size() / 2);
+  for (size_t i = 0; i + 1 < slots.size(); i += 2) {
+    if (slots[i] == detail::npos || slots[i + 1] == detail::npos) {
+      groups.emplace_back();
+    } else {
+      groups.push_back(str.substr(slots[i], slots[i + 1] - slots[i]));
+    }
+  }
+
+  return true;
+}
+
+bool Regex::Search(std::string_view str) const {
+  return program_ && RunDfa(str, true);
+}
+
+}  // namespace anisthesia::regex
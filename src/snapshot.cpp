@@ -0,0 +1,235 @@
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <anisthesia/player.hpp>
+#include <anisthesia/player_table.hpp>
+#include <anisthesia/snapshot.hpp>
+#include <anisthesia/util.hpp>
+
+namespace anisthesia {
+
+namespace detail::snapshot {
+
+uint32_t Checksum(const char* data, size_t size) {
+  // 32-bit FNV-1a
+  uint32_t hash = 0x811C9DC5;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+template <typename T>
+void Append(std::string& data, const T* items, size_t count) {
+  data.append(reinterpret_cast<const char*>(items), sizeof(T) * count);
+}
+
+}  // namespace detail::snapshot
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Snapshot::Open(const std::string& path) {
+  using namespace detail::snapshot;
+
+  Close();
+
+  if (!file_.Open(path))
+    return false;
+
+  const auto data = file_.data();
+  const auto size = file_.size();
+
+  if (size < sizeof(Header)) {
+    Close();
+    return false;
+  }
+
+  // Sections are only located once the header is known to describe them
+  // within the file.
+  header_ = reinterpret_cast<const Header*>(data);
+  if (!ValidateHeader()) {
+    Close();
+    return false;
+  }
+
+  records_ = reinterpret_cast<const detail::table::PlayerRecord*>(
+      data + sizeof(Header));
+  patterns_ = reinterpret_cast<const detail::table::StringRef*>(
+      records_ + header_->player_count);
+  strings_ = reinterpret_cast<const char*>(
+      patterns_ + header_->pattern_count);
+
+  if (!ValidateOffsets()) {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+void Snapshot::Close() {
+  file_.Close();
+  header_ = nullptr;
+  records_ = nullptr;
+  patterns_ = nullptr;
+  strings_ = nullptr;
+}
+
+size_t Snapshot::size() const {
+  return header_ ? header_->player_count : 0;
+}
+
+PlayerRef Snapshot::operator[](size_t index) const {
+  return {records_, static_cast<uint32_t>(index), patterns_, strings_};
+}
+
+std::span<const detail::table::PlayerRecord> Snapshot::records() const {
+  if (!header_)
+    return {};
+  return {records_, header_->player_count};
+}
+
+std::span<const detail::table::StringRef> Snapshot::patterns() const {
+  if (!header_)
+    return {};
+  return {patterns_, header_->pattern_count};
+}
+
+std::string_view Snapshot::strings() const {
+  if (!header_)
+    return {};
+  return {strings_, header_->string_table_size};
+}
+
+bool Snapshot::ValidateHeader() const {
+  using namespace detail::snapshot;
+  using detail::table::PlayerRecord;
+  using detail::table::StringRef;
+
+  const auto& header = *header_;
+
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+    return false;
+  if (header.version != kVersion || header.byte_order != kByteOrderMark)
+    return false;
+
+  // Compute the expected size in 64 bits, so that malformed counts cannot
+  // overflow the calculation.
+  const uint64_t expected_size =
+      sizeof(Header) +
+      uint64_t{sizeof(PlayerRecord)} * header.player_count +
+      uint64_t{sizeof(StringRef)} * header.pattern_count +
+      header.string_table_size;
+  if (expected_size != file_.size())
+    return false;
+
+  if (Checksum(file_.data() + sizeof(Header),
+               file_.size() - sizeof(Header)) != header.checksum) {
+    return false;
+  }
+
+  return true;
+}
+
+bool Snapshot::ValidateOffsets() const {
+  using detail::table::StringRef;
+
+  const auto& header = *header_;
+
+  // Offsets are checked once here, so that accessors can trust them
+  const auto verify_string = [&header](const StringRef& ref) {
+    return uint64_t{ref.offset} + ref.size <= header.string_table_size;
+  };
+  const auto verify_patterns = [&header](uint32_t begin, uint32_t count) {
+    return uint64_t{begin} + count <= header.pattern_count;
+  };
+
+  for (uint32_t i = 0; i < header.pattern_count; ++i) {
+    if (!verify_string(patterns_[i]))
+      return false;
+  }
+
+  for (uint32_t i = 0; i < header.player_count; ++i) {
+    const auto& record = records_[i];
+    if (!verify_string(record.name) ||
+        !verify_string(record.window_title_format) ||
+        !verify_patterns(record.windows_begin, record.windows_count) ||
+        !verify_patterns(record.executables_begin, record.executables_count) ||
+        !verify_patterns(record.extensions_begin, record.extensions_count) ||
+        record.type > static_cast<uint32_t>(PlayerType::WebBrowser) ||
+        record.options > GetPlayerOptionMask(PlayerOption::Exhaustive)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool CompileSnapshot(const std::vector<Player>& players, std::string& data) {
+  return CompileSnapshot(PlayerTable(players), data);
+}
+
+bool CompileSnapshot(const PlayerTable& table, std::string& data) {
+  using namespace detail::snapshot;
+  using detail::table::PlayerRecord;
+  using detail::table::StringRef;
+
+  if (table.empty())
+    return false;
+
+  const auto& records = table.records();
+  const auto& patterns = table.patterns();
+  const auto& strings = table.strings();
+
+  // Offsets are stored as 32-bit values
+  if (strings.size() > std::numeric_limits<uint32_t>::max())
+    return false;
+
+  Header header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrderMark;
+  header.player_count = static_cast<uint32_t>(records.size());
+  header.pattern_count = static_cast<uint32_t>(patterns.size());
+  header.string_table_size = static_cast<uint32_t>(strings.size());
+
+  data.clear();
+  data.reserve(sizeof(Header) +
+               sizeof(PlayerRecord) * records.size() +
+               sizeof(StringRef) * patterns.size() +
+               strings.size());
+
+  Append(data, &header, 1);
+  Append(data, records.data(), records.size());
+  Append(data, patterns.data(), patterns.size());
+  data.append(strings);
+
+  header.checksum = Checksum(data.data() + sizeof(Header),
+                             data.size() - sizeof(Header));
+  std::memcpy(&data.front(), &header, sizeof(Header));
+
+  return true;
+}
+
+bool ReadSnapshotFile(const std::string& path, std::vector<Player>& players) {
+  Snapshot snapshot;
+
+  if (!snapshot.Open(path))
+    return false;
+
+  players.reserve(players.size() + snapshot.size());
+  for (size_t i = 0; i < snapshot.size(); ++i) {
+    players.push_back(snapshot[i].ToPlayer());
+  }
+
+  return !players.empty();
+}
+
+}  // namespace anisthesia
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/detector.hpp>
+#include <anisthesia/extension_set.hpp>
+#include <anisthesia/media.hpp>
+#include <anisthesia/platform.hpp>
+#include <anisthesia/strategy.hpp>
+#include <anisthesia/thread_pool.hpp>
+#include <anisthesia/title_cache.hpp>
+#include <anisthesia/util.hpp>
+
+namespace anisthesia::detail {
+
+// Applies a single strategy to a result. Media is reported through the context
+// rather than appended to the result, so that strategies of the same result
+// can run concurrently.
+class Strategist {
+public:
+  Strategist(const Result& result, Platform& platform,
+             TitleExtractor& titles, const OpenFileFilter& filter,
+             StrategyContext& context)
+      : result_(result), platform_(platform), titles_(titles),
+        filter_(filter), context_(context) {}
+
+  bool ApplyStrategy(Strategy strategy);
+
+private:
+  bool AddMedia(const MediaInfo media_information);
+
+  bool ApplyWindowTitleStrategy();
+  bool ApplyOpenFilesStrategy();
+  bool ApplyUiAutomationStrategy();
+  bool ApplyMprisStrategy();
+
+  const Result& result_;
+  Platform& platform_;
+  TitleExtractor& titles_;
+  OpenFileFilter filter_;
+  StrategyContext& context_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Strategist::ApplyStrategy(Strategy strategy) {
+  switch (strategy) {
+    case Strategy::WindowTitle:
+      return ApplyWindowTitleStrategy();
+    case Strategy::OpenFiles:
+      return ApplyOpenFilesStrategy();
+    case Strategy::UiAutomation:
+      return ApplyUiAutomationStrategy();
+    case Strategy::Mpris:
+      return ApplyMprisStrategy();
+  }
+
+  return false;
+}
+
+bool HasFile(const std::vector<Media>& media) {
+  for (const auto& item : media) {
+    for (const auto& information : item.information) {
+      if (information.type == MediaInfoType::File)
+        return true;
+    }
+  }
+  return false;
+}
+
+StrategyScheduler::StrategyScheduler(std::vector<Result> results,
+                                     media_proc_t media_proc,
+                                     ThreadPool& thread_pool,
+                                     strategy_timeout_t timeout,
+                                     StrategyStats* stats,
+                                     const StrategyEnvironment& environment)
+    : results_(std::move(results)),
+      platform_(environment.platform),
+      titles_(environment.titles),
+      excluded_directories_(environment.excluded_directories),
+      stats_(stats),
+      runner_(thread_pool, std::move(media_proc), timeout) {
+  queues_.resize(results_.size());
+
+  for (size_t i = 0; i < results_.size(); ++i) {
+    const auto& result = results_[i];
+    auto& queue = queues_[i];
+
+    // Tasks that are given up on may outlive the results, so they work on a
+    // copy.
+    queue.result = std::make_shared<const Result>(result);
+    if (environment.extensions)
+      queue.extensions = environment.extensions->Get(result.player.name);
+    queue.strategies = result.player.strategies;
+    queue.exhaustive =
+        !stats_ || result.player.has_option(PlayerOption::Exhaustive);
+    if (!queue.exhaustive)
+      stats_->Sort(result.player.name, queue.strategies);
+
+    if (queue.strategies.empty()) {
+      completed_.push_back(i);
+    } else {
+      SubmitNext(i);
+    }
+  }
+}
+
+bool StrategyScheduler::Next(size_t& index, bool wait) {
+  while (completed_.empty()) {
+    size_t task_index = 0;
+    StrategyOutcome outcome;
+    const bool available = wait ? runner_.WaitNext(task_index, outcome)
+                                : runner_.TryNext(task_index, outcome);
+    if (!available)
+      return false;
+    Process(task_index, std::move(outcome));
+  }
+
+  index = completed_.front();
+  completed_.pop_front();
+  return true;
+}
+
+bool StrategyScheduler::NotifyNext(
+    StrategyRunner::notify_proc_t notify_proc) {
+  return runner_.NotifyNext(std::move(notify_proc));
+}
+
+bool StrategyScheduler::done() const {
+  return completed_.empty() && !runner_.pending();
+}
+
+bool StrategyScheduler::success() const {
+  return success_;
+}
+
+std::vector<Result>& StrategyScheduler::results() {
+  return results_;
+}
+
+void StrategyScheduler::SubmitNext(size_t index) {
+  // Exhaustive players run every strategy at once. Otherwise strategies run
+  // one at a time, cheapest first.
+  auto& queue = queues_[index];
+  const size_t count = queue.exhaustive ? queue.strategies.size() : 1;
+
+  for (size_t i = 0; i < count; ++i) {
+    const auto strategy = queue.strategies[i];
+    const auto task_index = runner_.Submit(
+        [result = queue.result, platform = platform_, titles = titles_,
+         extensions = queue.extensions,
+         excluded_directories = excluded_directories_,
+         strategy](StrategyContext& context) {
+          const OpenFileFilter filter{extensions.get(),
+                                      excluded_directories.get()};
+          auto& extractor =
+              titles ? *titles : GetDefaultTitleExtractor();
+          return Strategist(*result, *platform, extractor, filter, context)
+              .ApplyStrategy(strategy);
+        });
+    tasks_.resize(task_index + 1);
+    tasks_[task_index] = {index, queue.outcomes.size()};
+    queue.outcomes.push_back({strategy, {}});
+    ++queue.running;
+  }
+
+  queue.strategies.erase(queue.strategies.begin(),
+                         queue.strategies.begin() + count);
+}
+
+void StrategyScheduler::Process(size_t task_index, StrategyOutcome outcome) {
+  const auto [index, slot] = tasks_[task_index];
+  auto& queue = queues_[index];
+  auto& result = results_[index];
+  const auto strategy = queue.outcomes[slot].first;
+
+  const bool found_file = HasFile(outcome.media);
+  if (stats_)
+    stats_->Record(result.player.name, strategy, outcome.cost, found_file);
+
+  success_ |= outcome.status == StrategyStatus::Found ||
+              !outcome.media.empty();
+  queue.outcomes[slot].second = std::move(outcome);
+  --queue.running;
+
+  // The remaining strategies are skipped once a file is found
+  if (found_file && !queue.exhaustive) {
+    queue.skipped = std::move(queue.strategies);
+    queue.strategies.clear();
+  }
+
+  if (!queue.strategies.empty()) {
+    SubmitNext(index);
+    return;
+  }
+  if (queue.running)
+    return;
+
+  // Media is merged in the order in which strategies were applied, regardless
+  // of the order in which they have finished.
+  for (auto& [applied, applied_outcome] : queue.outcomes) {
+    std::move(applied_outcome.media.begin(), applied_outcome.media.end(),
+              std::back_inserter(result.media));
+    result.strategies.push_back({applied, applied_outcome.status});
+  }
+  for (const auto skipped : queue.skipped) {
+    result.strategies.push_back({skipped, StrategyStatus::Skipped});
+  }
+  queue = {};
+
+  completed_.push_back(index);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ApplyStrategies(media_proc_t media_proc, std::vector<Result>& results,
+                     ThreadPool& thread_pool, strategy_timeout_t timeout,
+                     StrategyStats* stats,
+                     const StrategyEnvironment& environment) {
+  StrategyScheduler scheduler(std::move(results), std::move(media_proc),
+                              thread_pool, timeout, stats, environment);
+
+  size_t index = 0;
+  while (scheduler.Next(index, true)) {
+  }
+
+  results = std::move(scheduler.results());
+  return scheduler.success();
+}
+
+bool ApplyStrategies(media_proc_t media_proc, std::vector<Result>& results,
+                     const StrategyEnvironment& environment) {
+  ThreadPool thread_pool(0);
+  return ApplyStrategies(media_proc, results, thread_pool,
+                         strategy_timeout_t::zero(), nullptr, environment);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Strategist::ApplyWindowTitleStrategy() {
+  const auto value = titles_.Extract(result_.player.window_title_format,
+                                     result_.window.text);
+
+  return AddMedia({value.type, value.title});
+}
+
+bool Strategist::ApplyOpenFilesStrategy() {
+  bool success = false;
+
+  auto open_files_proc = [this, &success](const OpenFile& open_file) -> bool {
+    success |= AddMedia({MediaInfoType::File, open_file.path});
+    return !context_.stop_requested();
+  };
+
+  const std::set<process_id_t> process_ids{result_.process.id};
+  platform_.EnumerateOpenFiles(process_ids, open_files_proc, filter_,
+                               context_.stop_token());
+
+  return success;
+}
+
+bool Strategist::ApplyUiAutomationStrategy() {
+  auto web_browser_proc = [this](
+      const WebBrowserInformation& web_browser_information) {
+    const auto& value = web_browser_information.value;
+
+    switch (web_browser_information.type) {
+      case WebBrowserInformationType::Address:
+        AddMedia({MediaInfoType::Url, value});
+        break;
+      case WebBrowserInformationType::Title:
+        AddMedia({MediaInfoType::Title,
+                  titles_.Extract(result_.player.window_title_format, value)
+                      .title});
+        break;
+      case WebBrowserInformationType::Tab:
+        AddMedia({MediaInfoType::Tab, value});
+        break;
+    }
+  };
+
+  return platform_.GetWebBrowserInformation(result_.window, web_browser_proc,
+                                            context_.stop_token());
+}
+
+bool Strategist::ApplyMprisStrategy() {
+  bool success = false;
+
+  auto media_session_proc = [this, &success](const MediaSession& session) {
+    Media media;
+    media.state = session.state;
+    media.duration = session.duration;
+    media.position = session.position;
+    media.rate = session.rate;
+
+    if (!session.url.empty()) {
+      std::string path;
+      if (util::FileUrlToPath(session.url, path)) {
+        media.information.push_back({MediaInfoType::File, std::move(path)});
+      } else {
+        media.information.push_back({MediaInfoType::Url, session.url});
+      }
+    }
+    if (!session.title.empty())
+      media.information.push_back({MediaInfoType::Title, session.title});
+
+    success |= context_.AddMedia(std::move(media));
+    return !context_.stop_requested();
+  };
+
+  platform_.EnumerateMediaSessions(result_.process, media_session_proc,
+                                   context_.stop_token());
+
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool Strategist::AddMedia(const MediaInfo media_information) {
+  return context_.AddMedia(media_information);
+}
+
+}  // namespace anisthesia::detail
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace anisthesia {
+
+TitleCacheStats GetTitleCacheStats() {
+  return detail::GetDefaultTitleExtractor().stats();
+}
+
+}  // namespace anisthesia
@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/strategy.hpp>
+#include <anisthesia/thread_pool.hpp>
+
+namespace anisthesia::detail {
+
+using clock = std::chrono::steady_clock;
+
+struct StrategyTaskState {
+  std::stop_source stop_source;
+  clock::time_point deadline = clock::time_point::max();
+  clock::time_point start_time;
+  clock::time_point end_time;
+  bool started = false;
+  bool finished = false;
+  bool found = false;
+  bool timed_out = false;
+  ThreadPool::worker_id_t worker = 0;  // that runs the task, once started
+  std::vector<Media> media;  // guarded by media_mutex of the runner
+};
+
+// State that is shared between the runner, its watchdog and its tasks. Tasks
+// that are given up on keep it alive until they return.
+struct StrategyRunnerState {
+  std::mutex mutex;
+  std::condition_variable_any condition;
+  std::vector<std::shared_ptr<StrategyTaskState>> tasks;
+  std::deque<size_t> finished;  // outcomes that are yet to be taken
+  size_t pending = 0;
+  StrategyRunner::notify_proc_t notify_proc;
+  strategy_timeout_t timeout;
+
+  std::mutex media_mutex;
+  media_proc_t media_proc;
+  bool closed = false;  // media_proc is no longer valid
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+StrategyContext::StrategyContext(std::shared_ptr<StrategyRunnerState> runner,
+                                 std::shared_ptr<StrategyTaskState> task)
+    : runner_(std::move(runner)), task_(std::move(task)) {}
+
+bool StrategyContext::AddMedia(const MediaInfo& media_information) {
+  Media media;
+  media.information.push_back(media_information);
+  return AddMedia(std::move(media));
+}
+
+bool StrategyContext::AddMedia(Media media) {
+  std::lock_guard lock(runner_->media_mutex);
+
+  if (runner_->closed || task_->stop_source.stop_requested())
+    return false;
+
+  std::erase_if(media.information, [this](const MediaInfo& information) {
+    return information.value.empty() || !runner_->media_proc(information);
+  });
+  if (media.information.empty())
+    return false;
+
+  task_->media.push_back(std::move(media));
+
+  return true;
+}
+
+bool StrategyContext::stop_requested() const {
+  if (task_->stop_source.stop_requested())
+    return true;
+
+  // The deadline is only written by this thread before the task starts.
+  if (clock::now() >= task_->deadline) {
+    task_->stop_source.request_stop();
+    return true;
+  }
+
+  return false;
+}
+
+std::stop_token StrategyContext::stop_token() const {
+  return task_->stop_source.get_token();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+StrategyRunner::StrategyRunner(ThreadPool& thread_pool,
+                               media_proc_t media_proc,
+                               strategy_timeout_t timeout)
+    : thread_pool_(thread_pool),
+      state_(std::make_shared<StrategyRunnerState>()) {
+  state_->timeout = timeout;
+  state_->media_proc = std::move(media_proc);
+
+  // Without threads, tasks run on the calling thread, and can only be stopped
+  // cooperatively.
+  if (timeout.count() && thread_pool.thread_count()) {
+    watchdog_ = std::jthread(
+        [this](std::stop_token stop_token) { Watch(stop_token); });
+  }
+}
+
+StrategyRunner::~StrategyRunner() {
+  if (watchdog_.joinable()) {
+    watchdog_.request_stop();
+    {
+      // The watchdog checks for a stop under the lock before it waits
+      std::lock_guard lock(state_->mutex);
+    }
+    state_->condition.notify_all();
+    watchdog_.join();
+  }
+
+  std::lock_guard media_lock(state_->media_mutex);
+  state_->closed = true;
+
+  std::vector<ThreadPool::worker_id_t> running_workers;
+  {
+    std::lock_guard lock(state_->mutex);
+    state_->notify_proc = nullptr;
+    for (const auto& task : state_->tasks) {
+      if (task->finished || task->timed_out)
+        continue;
+      task->stop_source.request_stop();
+      if (task->started)
+        running_workers.push_back(task->worker);
+    }
+  }
+
+  // Running tasks might be stuck, like the ones that run out of time
+  for (const auto worker : running_workers) {
+    thread_pool_.Replace(worker);
+  }
+}
+
+size_t StrategyRunner::Submit(strategy_task_t task) {
+  auto task_state = std::make_shared<StrategyTaskState>();
+
+  size_t index = 0;
+  {
+    std::lock_guard lock(state_->mutex);
+    index = state_->tasks.size();
+    state_->tasks.push_back(task_state);
+    ++state_->pending;
+  }
+
+  thread_pool_.Submit([runner = state_, task_state, index,
+                       task = std::move(task)]() {
+    {
+      std::lock_guard lock(runner->mutex);
+      // Given up on before it could start
+      if (task_state->stop_source.stop_requested()) {
+        task_state->finished = true;
+        return;
+      }
+      task_state->started = true;
+      task_state->worker = ThreadPool::CurrentWorker();
+      task_state->start_time = clock::now();
+      if (runner->timeout.count())
+        task_state->deadline = task_state->start_time + runner->timeout;
+    }
+    runner->condition.notify_all();
+
+    StrategyContext context(runner, task_state);
+    const bool found = task(context);
+
+    notify_proc_t notify_proc;
+    {
+      std::lock_guard lock(runner->mutex);
+      task_state->finished = true;
+      task_state->found = found;
+      // Otherwise the watchdog has already reported it
+      if (!task_state->timed_out) {
+        task_state->end_time = clock::now();
+        if (task_state->end_time >= task_state->deadline)
+          task_state->timed_out = true;
+        runner->finished.push_back(index);
+        notify_proc = std::move(runner->notify_proc);
+        runner->notify_proc = nullptr;
+      }
+    }
+    runner->condition.notify_all();
+
+    if (notify_proc)
+      notify_proc();
+  });
+
+  return index;
+}
+
+size_t StrategyRunner::pending() const {
+  std::lock_guard lock(state_->mutex);
+  return state_->pending;
+}
+
+bool StrategyRunner::TryNext(size_t& index, StrategyOutcome& outcome) {
+  return TakeOutcome(index, outcome);
+}
+
+bool StrategyRunner::WaitNext(size_t& index, StrategyOutcome& outcome) {
+  {
+    std::unique_lock lock(state_->mutex);
+    state_->condition.wait(lock, [this]() {
+      return !state_->finished.empty() || !state_->pending;
+    });
+  }
+  return TakeOutcome(index, outcome);
+}
+
+bool StrategyRunner::NotifyNext(notify_proc_t notify_proc) {
+  std::lock_guard lock(state_->mutex);
+  if (!state_->finished.empty() || !state_->pending)
+    return false;
+  state_->notify_proc = std::move(notify_proc);
+  return true;
+}
+
+bool StrategyRunner::TakeOutcome(size_t& index, StrategyOutcome& outcome) {
+  // Media of a task that has run out of time may still be written to, until
+  // it is taken under the media lock.
+  std::lock_guard media_lock(state_->media_mutex);
+  std::lock_guard lock(state_->mutex);
+
+  if (state_->finished.empty())
+    return false;
+
+  index = state_->finished.front();
+  state_->finished.pop_front();
+  --state_->pending;
+
+  auto& task = *state_->tasks[index];
+  outcome.media = std::move(task.media);
+  outcome.cost = std::chrono::duration_cast<strategy_cost_t>(task.end_time -
+                                                             task.start_time);
+  if (task.timed_out) {
+    outcome.status = StrategyStatus::TimedOut;
+  } else if (task.found) {
+    outcome.status = StrategyStatus::Found;
+  } else {
+    outcome.status = StrategyStatus::NotFound;
+  }
+
+  return true;
+}
+
+void StrategyRunner::Watch(std::stop_token stop_token) {
+  std::unique_lock lock(state_->mutex);
+
+  while (!stop_token.stop_requested()) {
+    const auto now = clock::now();
+    auto next_deadline = clock::time_point::max();
+    std::vector<ThreadPool::worker_id_t> abandoned_workers;
+
+    for (size_t i = 0; i < state_->tasks.size(); ++i) {
+      auto& task = *state_->tasks[i];
+      if (!task.started || task.finished || task.timed_out)
+        continue;
+      if (now >= task.deadline) {
+        task.timed_out = true;
+        task.end_time = now;
+        task.stop_source.request_stop();
+        state_->finished.push_back(i);
+        abandoned_workers.push_back(task.worker);
+        continue;
+      }
+      next_deadline = std::min(next_deadline, task.deadline);
+    }
+
+    if (!abandoned_workers.empty()) {
+      auto notify_proc = std::move(state_->notify_proc);
+      state_->notify_proc = nullptr;
+      lock.unlock();
+      state_->condition.notify_all();
+
+      // Abandoned tasks may be stuck in calls that cannot be interrupted, so
+      // their threads are replaced rather than waited for. Tasks that are
+      // still queued would otherwise never start.
+      for (const auto worker : abandoned_workers) {
+        thread_pool_.Replace(worker);
+      }
+      if (notify_proc)
+        thread_pool_.Submit(std::move(notify_proc));
+
+      lock.lock();
+      continue;
+    }
+
+    // Tasks that start, and the destructor, notify the condition
+    if (next_deadline == clock::time_point::max()) {
+      state_->condition.wait(lock);
+    } else {
+      state_->condition.wait_until(lock, next_deadline);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void StrategyStats::Record(std::string_view player, Strategy strategy,
+                           strategy_cost_t cost, bool found_file) {
+  auto it = players_.find(player);
+  if (it == players_.end())
+    it = players_.emplace(std::string(player), entries_t{}).first;
+
+  auto& entry = it->second[static_cast<size_t>(strategy)];
+  const double sample_cost = static_cast<double>(cost.count());
+  const double sample_yield = found_file ? 1.0 : 0.0;
+
+  if (!entry.samples) {
+    entry.cost = sample_cost;
+    entry.yield = sample_yield;
+  } else {
+    entry.cost += kWeight * (sample_cost - entry.cost);
+    entry.yield += kWeight * (sample_yield - entry.yield);
+  }
+  ++entry.samples;
+}
+
+void StrategyStats::Sort(std::string_view player,
+                         std::vector<Strategy>& strategies) const {
+  const auto it = players_.find(player);
+  if (it == players_.end())
+    return;
+
+  auto expected_cost = [](const Entry& entry) {
+    return entry.cost / std::max(entry.yield, kMinYield);
+  };
+
+  const auto& entries = it->second;
+  std::stable_sort(strategies.begin(), strategies.end(),
+                   [&entries, &expected_cost](Strategy a, Strategy b) {
+                     const auto& x = entries[static_cast<size_t>(a)];
+                     const auto& y = entries[static_cast<size_t>(b)];
+                     if (!x.samples || !y.samples)
+                       return !x.samples && y.samples;
+                     return expected_cost(x) < expected_cost(y);
+                   });
+}
+
+StrategyStats::Entry StrategyStats::Get(std::string_view player,
+                                        Strategy strategy) const {
+  const auto it = players_.find(player);
+  if (it == players_.end())
+    return {};
+  return it->second[static_cast<size_t>(strategy)];
+}
+
+void StrategyStats::Clear() {
+  players_.clear();
+}
+
+}  // namespace anisthesia::detail
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <anisthesia/thread_pool.hpp>
+
+namespace anisthesia::detail {
+
+namespace {
+
+thread_local ThreadPool::worker_id_t current_worker = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t thread_count, thread_proc_t thread_begin,
+                       thread_proc_t thread_end)
+    : thread_count_(thread_count), state_(std::make_shared<State>()) {
+  state_->thread_begin = std::move(thread_begin);
+  state_->thread_end = std::move(thread_end);
+
+  for (size_t i = 0; i < thread_count; ++i) {
+    StartThread();
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  // Tasks that have not started yet are discarded.
+  std::unique_lock lock(state_->mutex);
+  state_->stop = true;
+  state_->tasks.clear();
+  state_->condition.notify_all();
+
+  state_->exit_condition.wait(lock, [this]() {
+    return state_->live_threads <= state_->abandoned_workers.size();
+  });
+}
+
+size_t ThreadPool::thread_count() const {
+  return thread_count_;
+}
+
+void ThreadPool::Submit(task_t task) {
+  if (!thread_count_) {
+    task();
+    return;
+  }
+
+  {
+    std::lock_guard lock(state_->mutex);
+    state_->tasks.push_back(std::move(task));
+  }
+  state_->condition.notify_one();
+}
+
+ThreadPool::worker_id_t ThreadPool::CurrentWorker() {
+  return current_worker;
+}
+
+void ThreadPool::Replace(worker_id_t worker) {
+  if (!thread_count_ || !worker)
+    return;
+
+  {
+    std::lock_guard lock(state_->mutex);
+    if (!state_->abandoned_workers.insert(worker).second)
+      return;
+  }
+  StartThread();
+}
+
+void ThreadPool::StartThread() {
+  // Unique across pools, as workers are identified by a thread-local variable
+  static std::atomic<worker_id_t> next_worker = 1;
+
+  {
+    std::lock_guard lock(state_->mutex);
+    ++state_->live_threads;
+  }
+  std::thread(Work, state_, next_worker++).detach();
+}
+
+void ThreadPool::Work(std::shared_ptr<State> state, worker_id_t worker) {
+  current_worker = worker;
+
+  if (state->thread_begin)
+    state->thread_begin();
+
+  while (true) {
+    task_t task;
+    {
+      std::unique_lock lock(state->mutex);
+      state->condition.wait(
+          lock, [&state]() { return state->stop || !state->tasks.empty(); });
+      if (state->stop)
+        break;
+      task = std::move(state->tasks.front());
+      state->tasks.pop_front();
+    }
+
+    task();
+
+    // Another thread has taken the place of this one
+    std::lock_guard lock(state->mutex);
+    if (state->abandoned_workers.count(worker))
+      break;
+  }
+
+  if (state->thread_end)
+    state->thread_end();
+
+  std::lock_guard lock(state->mutex);
+  state->abandoned_workers.erase(worker);
+  --state->live_threads;
+  state->exit_condition.notify_all();
+}
+
+}  // namespace anisthesia::detail
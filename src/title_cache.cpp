@@ -0,0 +1,170 @@
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <anisthesia/media.hpp>
+#include <anisthesia/regex.hpp>
+#include <anisthesia/title_cache.hpp>
+
+namespace anisthesia::detail {
+
+TitleCache::TitleCache(size_t capacity) : capacity_(capacity) {}
+
+TitleCache::Key TitleCache::MakeKey(std::string_view format,
+                                    std::string_view raw_title) {
+  const std::hash<std::string_view> hash;
+  return {hash(format), hash(raw_title)};
+}
+
+bool TitleCache::Lookup(std::string_view format, std::string_view raw_title,
+                        Value& value) {
+  const auto key = MakeKey(format, raw_title);
+
+  std::lock_guard lock(mutex_);
+
+  const auto it = map_.find(key);
+  if (it == map_.end() || it->second->format != format ||
+      it->second->raw_title != raw_title) {
+    ++misses_;
+    return false;
+  }
+
+  entries_.splice(entries_.begin(), entries_, it->second);
+  value = it->second->value;
+  ++hits_;
+
+  return true;
+}
+
+void TitleCache::Insert(std::string_view format, std::string_view raw_title,
+                        const Value& value) {
+  const auto key = MakeKey(format, raw_title);
+
+  std::lock_guard lock(mutex_);
+
+  if (!capacity_)
+    return;
+
+  const auto it = map_.find(key);
+  if (it != map_.end()) {
+    // Replaces the entry, even if it belongs to a colliding title
+    auto& entry = *it->second;
+    entry.format = format;
+    entry.raw_title = raw_title;
+    entry.value = value;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+
+  entries_.push_front({key, std::string(format), std::string(raw_title),
+                       value});
+  map_.emplace(key, entries_.begin());
+  Evict();
+}
+
+void TitleCache::Clear() {
+  std::lock_guard lock(mutex_);
+  entries_.clear();
+  map_.clear();
+  hits_ = 0;
+  misses_ = 0;
+}
+
+void TitleCache::SetCapacity(size_t capacity) {
+  std::lock_guard lock(mutex_);
+  capacity_ = capacity;
+  Evict();
+}
+
+TitleCacheStats TitleCache::stats() const {
+  std::lock_guard lock(mutex_);
+  return {hits_, misses_, entries_.size(), capacity_};
+}
+
+void TitleCache::Evict() {
+  while (entries_.size() > capacity_) {
+    map_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ApplyWindowTitleFormat(const regex::Regex& regex, std::string& title) {
+  std::vector<std::string_view> groups;
+  if (!regex.Match(title, groups))
+    return false;
+
+  // Use the first non-empty match result, because the regular expression may
+  // contain multiple sub-expressions.
+  for (size_t i = 1; i < groups.size(); ++i) {
+    if (!groups[i].empty()) {
+      title = std::string(groups[i]);
+      return true;
+    }
+  }
+
+  // Results are empty, but the match was successful
+  title.clear();
+  return true;
+}
+
+MediaInfoType InferMediaInformationType(const std::string& str) {
+  static const regex::Regex path_pattern(
+      R"(^(?:[A-Za-z]:[/\\]|\\\\)[^<>:"/\\|?*]+)");
+  if (path_pattern.Search(str)) {
+    return MediaInfoType::File;
+  }
+
+  return MediaInfoType::Unknown;
+}
+
+TitleCache::Value TitleExtractor::Extract(const std::string& format,
+                                          const std::string& raw_title) {
+  TitleCache::Value value;
+  if (cache_.Lookup(format, raw_title, value))
+    return value;
+
+  value.title = raw_title;
+  if (!format.empty())
+    value.formatted = ApplyWindowTitleFormat(*GetRegex(format), value.title);
+  value.type = InferMediaInformationType(value.title);
+
+  cache_.Insert(format, raw_title, value);
+  return value;
+}
+
+void TitleExtractor::Clear() {
+  {
+    std::lock_guard lock(mutex_);
+    regexes_.clear();
+  }
+  cache_.Clear();
+}
+
+void TitleExtractor::SetCapacity(size_t capacity) {
+  cache_.SetCapacity(capacity);
+}
+
+TitleCacheStats TitleExtractor::stats() const {
+  return cache_.stats();
+}
+
+std::shared_ptr<const regex::Regex> TitleExtractor::GetRegex(
+    const std::string& format) {
+  std::lock_guard lock(mutex_);
+  auto& regex = regexes_[format];
+  if (!regex)
+    regex = std::make_shared<const regex::Regex>(format);
+  return regex;
+}
+
+TitleExtractor& GetDefaultTitleExtractor() {
+  static TitleExtractor title_extractor;
+  return title_extractor;
+}
+
+}  // namespace anisthesia::detail
@@ -1,11 +1,118 @@
 #include <algorithm>
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <anisthesia/util.hpp>
 
 namespace anisthesia::detail::util {
 
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+bool MappedFile::Open(const std::string& path) {
+  Close();
+
+#ifdef _WIN32
+  const HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER file_size = {};
+  if (!::GetFileSizeEx(file, &file_size) || !file_size.QuadPart) {
+    ::CloseHandle(file);
+    return false;
+  }
+
+  // The view keeps a reference to the mapping object, which in turn keeps a
+  // reference to the file, so both handles can be closed right away.
+  const HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY,
+                                              0, 0, nullptr);
+  ::CloseHandle(file);
+  if (!mapping)
+    return false;
+
+  const auto view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  ::CloseHandle(mapping);
+  if (!view)
+    return false;
+
+  data_ = static_cast<const char*>(view);
+  size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat st = {};
+  if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+
+  const auto size = static_cast<size_t>(st.st_size);
+  void* view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (view == MAP_FAILED)
+    return false;
+
+  data_ = static_cast<const char*>(view);
+  size_ = size;
+#endif
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (!data_)
+    return;
+
+#ifdef _WIN32
+  ::UnmapViewOfFile(data_);
+#else
+  ::munmap(const_cast<char*>(data_), size_);
+#endif
+
+  data_ = nullptr;
+  size_ = 0;
+}
+
+const char* MappedFile::data() const {
+  return data_;
+}
+
+size_t MappedFile::size() const {
+  return size_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool ReadFile(const std::string& path, std::string& data) {
   std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
 
@@ -22,7 +129,20 @@ bool ReadFile(const std::string& path, std::string& data) {
   return true;
 }
 
-bool EqualStrings(const std::string& str1, const std::string& str2) {
+bool WriteFile(const std::string& path, const std::string& data) {
+  std::ofstream file(path.c_str(),
+                     std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if (!file)
+    return false;
+
+  file.write(data.data(), data.size());
+  file.close();
+
+  return !file.fail();
+}
+
+bool EqualStrings(std::string_view str1, std::string_view str2) {
   auto lower_char = [](const char c) -> char {
     return ('A' <= c && c <= 'Z') ? c + ('a' - 'A') : c;
   };
@@ -71,4 +191,52 @@ bool TrimRight(std::string& str, const char* chars) {
   return true;
 }
 
+bool FileUrlToPath(std::string_view url, std::string& path) {
+  constexpr std::string_view kScheme = "file://";
+  if (url.size() < kScheme.size() ||
+      !EqualStrings(url.substr(0, kScheme.size()), kScheme)) {
+    return false;
+  }
+  url.remove_prefix(kScheme.size());
+
+  // Only the local host is meaningful to us
+  if (url.starts_with("localhost/"))
+    url.remove_prefix(std::string_view{"localhost"}.size());
+  if (!url.starts_with('/'))
+    return false;
+
+  auto hex_value = [](char c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+
+  path.clear();
+  path.reserve(url.size());
+
+  for (size_t i = 0; i < url.size(); ++i) {
+    if (url[i] == '?' || url[i] == '#')
+      break;
+    if (url[i] == '%' && i + 2 < url.size()) {
+      const int high = hex_value(url[i + 1]);
+      const int low = hex_value(url[i + 2]);
+      if (high >= 0 && low >= 0) {
+        path.push_back(static_cast<char>(high * 16 + low));
+        i += 2;
+        continue;
+      }
+    }
+    path.push_back(url[i]);
+  }
+
+#ifdef _WIN32
+  // "file:///C:/path" refers to "C:/path"
+  if (path.size() > 2 && path[2] == ':')
+    path.erase(0, 1);
+#endif
+
+  return !path.empty();
+}
+
 }  // namespace anisthesia::detail::util
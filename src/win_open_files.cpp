@@ -1,9 +1,19 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <utility>
+#include <vector>
 
 #include <windows.h>
 #include <winternl.h>
 
+#include <anisthesia/handle_scan.hpp>
+#include <anisthesia/open_file_cache.hpp>
 #include <anisthesia/win_open_files.hpp>
 #include <anisthesia/win_util.hpp>
 
@@ -21,16 +31,13 @@ enum {
   SystemExtendedHandleInformation = 64,
 };
 
-struct SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX {
-  PVOID Object;
-  ULONG_PTR UniqueProcessId;
-  HANDLE HandleValue;
-  ACCESS_MASK GrantedAccess;
-  USHORT CreatorBackTraceIndex;
-  USHORT ObjectTypeIndex;
-  ULONG HandleAttributes;
-  ULONG Reserved;
-};
+// Defined in a platform-independent header, so that the table can be filtered
+// by the same code on any platform.
+using SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX = anisthesia::detail::HandleTableEntry;
+
+static_assert(sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX) ==
+              2 * sizeof(PVOID) + sizeof(ULONG_PTR) + sizeof(ACCESS_MASK) +
+                  2 * sizeof(USHORT) + 2 * sizeof(ULONG));
 
 struct SYSTEM_HANDLE_INFORMATION_EX {
   ULONG_PTR NumberOfHandles;
@@ -48,6 +55,9 @@ struct OBJECT_TYPE_INFORMATION {
 
 using buffer_t = std::unique_ptr<BYTE[]>;
 
+using anisthesia::detail::ExtensionSet;
+using anisthesia::detail::OpenFileStatus;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 PVOID GetNtProcAddress(LPCSTR proc_name) {
@@ -93,28 +103,40 @@ inline bool NtSuccess(NTSTATUS status) {
   return status >= 0;
 }
 
-buffer_t QuerySystemInformation(
-      SYSTEM_INFORMATION_CLASS system_information_class) {
-  ULONG size = 1 << 20;                //  1 MiB
+// The size that was last needed is kept as a hint, plus some room for the
+// table to grow, so that the first query usually succeeds.
+bool QuerySystemInformation(SYSTEM_INFORMATION_CLASS system_information_class,
+                            SnapshotBuffer& buffer,
+                            std::atomic<ULONG>& size_hint) {
   constexpr ULONG kMaxSize = 1 << 24;  // 16 MiB
 
-  buffer_t buffer(new BYTE[size]);
+  const auto reserve = [&buffer](ULONG size) {
+    if (buffer.size < size) {
+      buffer.data.reset();  // avoids holding both buffers at once
+      buffer.size = 0;
+      buffer.data.reset(new BYTE[size]);
+      buffer.size = size;
+    }
+  };
+
+  reserve(size_hint.load());
   NTSTATUS status = STATUS_SUCCESS;
 
   do {
     ULONG return_length = 0;
     status = win::detail::NtQuerySystemInformation(
-        system_information_class, buffer.get(), size, &return_length);
+        system_information_class, buffer.data.get(), buffer.size,
+        &return_length);
     if (status == STATUS_INFO_LENGTH_MISMATCH) {
-      size = (return_length > size) ? return_length : (size * 2);
-      buffer.reset(new BYTE[size]);
+      reserve((return_length > buffer.size) ? return_length
+                                            : (buffer.size * 2));
+    } else if (NtSuccess(status)) {
+      size_hint.store(
+          std::min(return_length + return_length / 8, kMaxSize));
     }
-  } while (status == STATUS_INFO_LENGTH_MISMATCH && size < kMaxSize);
-
-  if (!NtSuccess(status))
-    buffer.reset();
+  } while (status == STATUS_INFO_LENGTH_MISMATCH && buffer.size < kMaxSize);
 
-  return buffer;
+  return NtSuccess(status);
 }
 
 buffer_t QueryObject(HANDLE handle,
@@ -146,7 +168,8 @@ buffer_t QueryObject(HANDLE handle,
 HANDLE OpenProcess(DWORD process_id) {
   // If we try to open a SYSTEM process, this function fails and the last error
   // code is ERROR_ACCESS_DENIED.
-  return ::OpenProcess(PROCESS_DUP_HANDLE, false, process_id);
+  return ::OpenProcess(PROCESS_DUP_HANDLE | PROCESS_QUERY_LIMITED_INFORMATION,
+                       false, process_id);
 }
 
 HANDLE DuplicateHandle(HANDLE process_handle, HANDLE handle) {
@@ -156,9 +179,24 @@ HANDLE DuplicateHandle(HANDLE process_handle, HANDLE handle) {
   return result ? dup_handle : nullptr;
 }
 
-buffer_t GetSystemHandleInformation() {
+// Concurrent calls allocate their own buffer.
+SnapshotBuffer AcquireSnapshotBuffer(OpenFileState& state) {
+  std::lock_guard lock(state.snapshot_mutex);
+  return std::exchange(state.spare_snapshot, {});
+}
+
+void ReleaseSnapshotBuffer(OpenFileState& state, SnapshotBuffer buffer) {
+  std::lock_guard lock(state.snapshot_mutex);
+  if (buffer.size > state.spare_snapshot.size &&
+      buffer.size <= state.max_snapshot_size) {
+    state.spare_snapshot = std::move(buffer);
+  }
+}
+
+bool GetSystemHandleInformation(OpenFileState& state, SnapshotBuffer& buffer) {
   return QuerySystemInformation(
-      static_cast<SYSTEM_INFORMATION_CLASS>(SystemExtendedHandleInformation));
+      static_cast<SYSTEM_INFORMATION_CLASS>(SystemExtendedHandleInformation),
+      buffer, state.snapshot_size_hint);
 }
 
 std::wstring GetUnicodeString(const UNICODE_STRING& unicode_string) {
@@ -204,7 +242,8 @@ std::wstring GetFinalPathNameByHandle(HANDLE handle) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool VerifyObjectType(HANDLE handle, USHORT object_type_index) {
+bool VerifyObjectType(std::atomic<USHORT>& file_type_index, HANDLE handle,
+                      USHORT object_type_index) {
   // File type index varies between OS versions:
   //
   // Index | OS version
@@ -227,22 +266,24 @@ bool VerifyObjectType(HANDLE handle, USHORT object_type_index) {
   //
   // Here we initialize the value with 0, so that it is determined at run time.
   // This is more reliable than hard-coding the values for each OS version.
-  static USHORT file_type_index = 0;
-
-  if (file_type_index)
-    return object_type_index == file_type_index;
+  if (const auto index = file_type_index.load())
+    return object_type_index == index;
 
   if (!handle)
     return true;
 
   if (GetObjectTypeName(handle) == L"File") {
-    file_type_index = object_type_index;
+    file_type_index.store(object_type_index);
     return true;
   }
 
   return false;
 }
 
+constexpr ACCESS_MASK kRequiredAccess = FILE_READ_DATA;
+constexpr ACCESS_MASK kExcludedAccess =
+    FILE_APPEND_DATA | FILE_WRITE_EA | FILE_WRITE_ATTRIBUTES;
+
 bool VerifyAccessMask(ACCESS_MASK access_mask) {
   // Certain kinds of handles, mostly those which refer to named pipes, cause
   // some functions such as NtQueryObject and GetFinalPathNameByHandle to hang.
@@ -274,16 +315,13 @@ bool VerifyAccessMask(ACCESS_MASK access_mask) {
   //
   // Media players must have read-access in order to play a video file, so we
   // can safely skip a handle in the absence of this basic right:
-  if (!(access_mask & FILE_READ_DATA))
+  if (!(access_mask & kRequiredAccess))
     return false;
 
   // We further assume that media players do not have any kind of write access
   // to video files:
-  if ((access_mask & FILE_APPEND_DATA) ||
-      (access_mask & FILE_WRITE_EA) ||
-      (access_mask & FILE_WRITE_ATTRIBUTES)) {
+  if (access_mask & kExcludedAccess)
     return false;
-  }
 
   return true;
 }
@@ -293,6 +331,19 @@ bool VerifyFileType(HANDLE handle) {
   return ::GetFileType(handle) == FILE_TYPE_DISK;
 }
 
+bool VerifyExtension(const std::wstring& path,
+                     const ExtensionSet* extensions) {
+  return !extensions || extensions->ContainsPath(path);
+}
+
+bool VerifyExcludedDirectories(const std::wstring& path,
+                               const OpenFileFilter& filter) {
+  // Directories are given in UTF-8. Only accepted files are checked, and there
+  // are few of them.
+  return !filter.excluded_directories ||
+         !filter.excluded_directories->Match(ToUtf8String(path));
+}
+
 bool VerifyPath(const std::wstring& path) {
   if (path.empty())
     return false;
@@ -313,66 +364,100 @@ bool VerifyPath(const std::wstring& path) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool EnumerateOpenFiles(const std::set<DWORD>& process_ids,
-                        open_file_proc_t open_file_proc) {
-  if (!open_file_proc)
+// Returns false if the handle could not be duplicated (e.g. because it has
+// been closed in the meantime), in which case there is nothing to remember.
+bool ResolveHandle(OpenFileState& state, HANDLE process_handle,
+                   const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX& handle,
+                   const ExtensionSet* extensions,
+                   OpenFileCache::Entry& entry) {
+  // Duplicate the handle so that we can query it
+  Handle dup_handle(DuplicateHandle(process_handle, handle.HandleValue));
+  if (!dup_handle)
     return false;
 
-  std::map<DWORD, Handle> process_handles;
-  for (const auto& process_id : process_ids) {
-    const auto handle = OpenProcess(process_id);
-    if (handle)
-      process_handles[process_id] = Handle(handle);
+  // Skip if this is not a file handle, while determining file type index.
+  // Skip if this is not a disk file.
+  if (!VerifyObjectType(state.file_type_index, dup_handle.get(),
+                        handle.ObjectTypeIndex) ||
+      !VerifyFileType(dup_handle.get())) {
+    entry.status = OpenFileStatus::InvalidType;
+    return true;
   }
-  if (process_handles.empty())
-    return false;
 
-  auto system_handle_information_buffer = GetSystemHandleInformation();
-  if (!system_handle_information_buffer)
-    return false;
+  auto path = GetFinalPathNameByHandle(dup_handle.get());
 
-  const auto& system_handle_information =
-      *reinterpret_cast<SYSTEM_HANDLE_INFORMATION_EX*>(
-          system_handle_information_buffer.get());
-  if (!system_handle_information.NumberOfHandles)
-    return false;
+  // Skip files that the player is not expected to play, before the path is
+  // verified on disk and converted by the caller
+  if (!VerifyExtension(path, extensions)) {
+    entry.status = OpenFileStatus::InvalidExtension;
+    entry.path = std::move(path);
+    return true;
+  }
 
-  for (size_t i = 0; i < system_handle_information.NumberOfHandles; ++i) {
-    const auto& handle = system_handle_information.Handles[i];
+  if (!VerifyPath(path)) {
+    entry.status = OpenFileStatus::InvalidPath;
+    return true;
+  }
 
-    // Skip if this handle does not belong to one of our PIDs
-    const auto process_id = static_cast<DWORD>(handle.UniqueProcessId);
-    if (!process_ids.count(process_id))
-      continue;
+  entry.status = OpenFileStatus::Accepted;
+  entry.path = std::move(path);
+  return true;
+}
 
-    // Skip if this is not a file handle
-    if (!VerifyObjectType(nullptr, handle.ObjectTypeIndex))
-      continue;
+bool EnumerateHandles(OpenFileState& state,
+                      const SYSTEM_HANDLE_INFORMATION_EX& information,
+                      const std::vector<size_t>& candidates,
+                      std::map<DWORD, Handle>& process_handles,
+                      std::map<DWORD, OpenFileCache::Scan>& scans,
+                      const OpenFileFilter& filter,
+                      const open_file_proc_t& open_file_proc,
+                      const std::stop_token& stop_token) {
+  for (const auto i : candidates) {
+    const auto& handle = information.Handles[i];
+    const auto process_id = static_cast<DWORD>(handle.UniqueProcessId);
 
-    // Skip if the file handle has an inappropriate access mask
-    if (!VerifyAccessMask(handle.GrantedAccess))
-      continue;
+    if (stop_token.stop_requested())
+      return false;
 
-    // Duplicate the handle so that we can query it
-    const auto process_handle = process_handles[process_id].get();
-    Handle dup_handle(DuplicateHandle(process_handle, handle.HandleValue));
-    if (!dup_handle)
+    // Skip if this is not a file handle, in case the file type index has been
+    // determined since the table was filtered
+    if (!VerifyObjectType(state.file_type_index, nullptr,
+                          handle.ObjectTypeIndex)) {
       continue;
+    }
 
-    // Skip if this is not a file handle, while determining file type index
-    if (!VerifyObjectType(dup_handle.get(), handle.ObjectTypeIndex))
-      continue;
+    // Only handles that are new since the last scan are queried
+    auto& scan = scans.at(process_id);
+    const HandleKey key{reinterpret_cast<ULONG_PTR>(handle.HandleValue),
+                        handle.GrantedAccess,
+                        reinterpret_cast<ULONG_PTR>(handle.Object)};
+
+    // The extension set may have changed since the file was rejected
+    const auto* entry = scan.Find(key);
+    if (entry && entry->status == OpenFileStatus::InvalidExtension &&
+        VerifyExtension(entry->path, filter.extensions)) {
+      entry = nullptr;
+    }
+    if (!entry) {
+      OpenFileCache::Entry resolved;
+      if (!ResolveHandle(state, process_handles[process_id].get(), handle,
+                         filter.extensions, resolved)) {
+        continue;
+      }
+      entry = &scan.Insert(key, std::move(resolved));
+    }
 
-    // Skip if this is not a disk file
-    if (!VerifyFileType(dup_handle.get()))
+    // The filter may differ from the one that the entry was resolved with.
+    // Unlike system directories, excluded directories are not cached.
+    if (entry->status != OpenFileStatus::Accepted ||
+        !VerifyExtension(entry->path, filter.extensions) ||
+        !VerifyExcludedDirectories(entry->path, filter)) {
       continue;
+    }
 
     OpenFile open_file;
     open_file.process_id = process_id;
-    open_file.path = GetFinalPathNameByHandle(dup_handle.get());
-
-    if (!VerifyPath(open_file.path))
-      continue;
+    open_file.path = entry->path;
 
     if (!open_file_proc(open_file))
       return false;
@@ -381,4 +466,71 @@ bool EnumerateOpenFiles(const std::set<DWORD>& process_ids,
   return true;
 }
 
+bool EnumerateOpenFiles(OpenFileState& state,
+                        const std::set<DWORD>& process_ids,
+                        open_file_proc_t open_file_proc,
+                        const OpenFileFilter& filter,
+                        std::stop_token stop_token) {
+  if (!open_file_proc)
+    return false;
+
+  std::map<DWORD, Handle> process_handles;
+  for (const auto& process_id : process_ids) {
+    const auto handle = OpenProcess(process_id);
+    if (handle)
+      process_handles[process_id] = Handle(handle);
+  }
+  if (process_handles.empty())
+    return false;
+
+  auto& cache = state.cache;
+  std::map<DWORD, OpenFileCache::Scan> scans;
+  for (const auto& [process_id, process_handle] : process_handles) {
+    const ProcessKey key{process_id,
+                         GetProcessCreationTime(process_handle.get())};
+    scans.emplace(process_id, cache.Begin(key));
+  }
+
+  auto snapshot = AcquireSnapshotBuffer(state);
+  bool result = false;
+
+  if (GetSystemHandleInformation(state, snapshot)) {
+    const auto& system_handle_information =
+        *reinterpret_cast<SYSTEM_HANDLE_INFORMATION_EX*>(snapshot.data.get());
+
+    // Keep the handles that belong to one of our PIDs and have an appropriate
+    // access mask, and once it is known, the file type index.
+    std::vector<uint32_t> filter_process_ids;
+    for (const auto& [process_id, process_handle] : process_handles) {
+      filter_process_ids.push_back(process_id);
+    }
+    anisthesia::detail::HandleFilter handle_filter;
+    handle_filter.process_ids = filter_process_ids;
+    handle_filter.object_type_index = state.file_type_index.load();
+    handle_filter.required_access = kRequiredAccess;
+    handle_filter.excluded_access = kExcludedAccess;
+
+    std::vector<size_t> candidates;
+    anisthesia::detail::FilterHandles(
+        std::span<const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX>(
+            system_handle_information.Handles,
+            system_handle_information.NumberOfHandles),
+        handle_filter, candidates);
+
+    result = system_handle_information.NumberOfHandles &&
+             EnumerateHandles(state, system_handle_information, candidates,
+                              process_handles, scans, filter, open_file_proc,
+                              stop_token);
+  }
+
+  ReleaseSnapshotBuffer(state, std::move(snapshot));
+
+  // Handles of an incomplete scan may still exist
+  for (auto& [process_id, scan] : scans) {
+    cache.End(std::move(scan), result);
+  }
+
+  return result;
+}
+
 }  // namespace anisthesia::win::detail
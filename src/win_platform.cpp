@@ -1,71 +1,119 @@
-#include <regex>
-#include <string>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <utility>
 #include <vector>
 
-#include <anisthesia/media.hpp>
+#include <windows.h>
+
+#include <anisthesia/detector.hpp>
+#include <anisthesia/platform.hpp>
 #include <anisthesia/player.hpp>
-#include <anisthesia/util.hpp>
+#include <anisthesia/player_table.hpp>
 
+#include <anisthesia/win_open_files.hpp>
 #include <anisthesia/win_platform.hpp>
+#include <anisthesia/win_processes.hpp>
+#include <anisthesia/win_ui_automation.hpp>
 #include <anisthesia/win_util.hpp>
 #include <anisthesia/win_windows.hpp>
 
+namespace anisthesia {
+
+std::shared_ptr<Platform> CreateNativePlatform() {
+  return std::make_shared<win::WindowsPlatform>();
+}
+
+}  // namespace anisthesia
+
 namespace anisthesia::win {
 
-namespace detail {
+bool WindowsPlatform::EnumerateProcesses(process_proc_t process_proc) {
+  return detail::EnumerateProcesses(process_proc);
+}
 
-bool IsPlayerWindow(const Process& process, const Window& window,
-  const Player& player) {
-  auto check_pattern = [](const std::string& pattern, const std::string& str) {
-    if (pattern.empty())
-      return false;
-    if (pattern.front() == '^' && std::regex_match(str, std::regex(pattern)))
-      return true;
-    return anisthesia::detail::util::EqualStrings(pattern, str);
-  };
+bool WindowsPlatform::EnumerateWindows(window_proc_t window_proc) {
+  return detail::EnumerateWindows(processes_, window_proc);
+}
 
-  auto check_windows = [&]() {
-    for (const auto& pattern : player.windows) {
-      if (check_pattern(pattern, ToUtf8String(window.class_name)))
-        return true;
-    }
+bool WindowsPlatform::EnumerateOpenFiles(
+    const std::set<process_id_t>& process_ids, open_file_proc_t open_file_proc,
+    const OpenFileFilter& filter, std::stop_token stop_token) {
+  if (!open_file_proc)
     return false;
-  };
 
-  auto check_executables = [&]() {
-    for (const auto& pattern : player.executables) {
-      if (check_pattern(pattern, ToUtf8String(process.name)))
-        return true;
-    }
-    return false;
+  auto proc = [&open_file_proc](const detail::OpenFile& open_file) {
+    return open_file_proc({open_file.process_id,
+                           detail::ToUtf8String(open_file.path)});
   };
 
-  return check_windows() && check_executables();
+  const std::set<DWORD> ids(process_ids.begin(), process_ids.end());
+  return detail::EnumerateOpenFiles(open_files_, ids, proc, filter,
+                                    stop_token);
+}
+
+bool WindowsPlatform::GetWebBrowserInformation(
+    const Window& window, web_browser_proc_t web_browser_proc,
+    std::stop_token stop_token) {
+  return detail::GetWebBrowserInformation(ui_automation_, web_browsers_,
+                                          window, std::move(web_browser_proc),
+                                          stop_token);
 }
 
-}  // namespace detail
+void WindowsPlatform::InitializeThread() {
+  ::CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+}
+
+void WindowsPlatform::UninitializeThread() {
+  ::CoUninitialize();
+}
+
+void WindowsPlatform::SetCacheLimits(const CacheLimits& limits) {
+  open_files_.cache.SetMaxProcesses(limits.open_file_processes);
+  web_browsers_.SetCapacity(limits.web_browser_windows);
+
+  std::lock_guard lock(open_files_.snapshot_mutex);
+  open_files_.max_snapshot_size = static_cast<ULONG>(limits.snapshot_size);
+  if (open_files_.spare_snapshot.size > open_files_.max_snapshot_size)
+    open_files_.spare_snapshot = {};
+}
+
+void WindowsPlatform::ClearCaches() {
+  processes_.Clear();
+  open_files_.cache.Clear();
+  {
+    std::lock_guard lock(open_files_.snapshot_mutex);
+    open_files_.spare_snapshot = {};
+  }
+  open_files_.file_type_index.store(0);
+  ui_automation_.Reset();
+  web_browsers_.Clear();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 
+WindowsPlatform& GetDefaultPlatform() {
+  static WindowsPlatform platform;
+  return platform;
+}
+
 bool GetResults(const std::vector<Player>& players, media_proc_t media_proc,
                 std::vector<Result>& results) {
-  auto window_proc = [&](const Process& process, const Window& window) -> bool {
-    for (const auto& player : players) {
-      if (detail::IsPlayerWindow(process, window, player)) {
-        results.push_back({player, process, window, {}});
-        break;
-      }
-    }
-    return true;
-  };
-
-  if (!detail::EnumerateWindows(window_proc))
-    return false;
+  return anisthesia::GetResults(GetDefaultPlatform(), players, media_proc,
+                                results);
+}
 
-  if (!detail::ApplyStrategies(media_proc, results))
-    return false;
+bool GetResults(const PlayerTable& players, media_proc_t media_proc,
+                std::vector<Result>& results) {
+  return anisthesia::GetResults(GetDefaultPlatform(), players, media_proc,
+                                results);
+}
 
-  return true;
+bool GetResults(const PlayerTable& players, const PlayerMatcher& matcher,
+                media_proc_t media_proc, std::vector<Result>& results) {
+  return anisthesia::GetResults(GetDefaultPlatform(), players, matcher,
+                                media_proc, results);
 }
 
 }  // namespace anisthesia::win
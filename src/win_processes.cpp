@@ -0,0 +1,43 @@
+#include <string>
+
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <anisthesia/win_processes.hpp>
+#include <anisthesia/win_util.hpp>
+
+namespace anisthesia::win::detail {
+
+bool EnumerateProcesses(process_proc_t process_proc) {
+  if (!process_proc)
+    return false;
+
+  Handle snapshot(::CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0));
+  if (snapshot.get() == INVALID_HANDLE_VALUE) {
+    snapshot.release();
+    return false;
+  }
+
+  PROCESSENTRY32W entry = {};
+  entry.dwSize = sizeof(entry);
+
+  if (!::Process32FirstW(snapshot.get(), &entry))
+    return false;
+
+  do {
+    // Skip the System Idle Process
+    if (!entry.th32ProcessID)
+      continue;
+
+    Process process;
+    process.id = entry.th32ProcessID;
+    process.name = ToUtf8String(GetFileNameWithoutExtension(entry.szExeFile));
+
+    if (!process_proc(process))
+      break;
+  } while (::Process32NextW(snapshot.get(), &entry));
+
+  return true;
+}
+
+}  // namespace anisthesia::win::detail
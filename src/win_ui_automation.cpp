@@ -1,11 +1,15 @@
-#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
 #include <string>
-#include <vector>
+#include <utility>
 
 #include <windows.h>
 #include <unknwn.h>
 #include <uiautomation.h>
 
+#include <anisthesia/element_tree.hpp>
+#include <anisthesia/platform.hpp>
 #include <anisthesia/win_ui_automation.hpp>
 #include <anisthesia/win_util.hpp>
 
@@ -19,37 +23,49 @@ using Element = IUIAutomationElement;
 using TreeWalker = IUIAutomationTreeWalker;
 using ValuePattern = IUIAutomationValuePattern;
 
-using element_proc_t = std::function<TreeScope(Element&)>;
-using properties_t = std::vector<std::pair<long, bool>>;
-
-// The main interface that is used throughout this file. Must be initialized
-// before it can be used for the first time.
-ComInterface<IUIAutomation> ui_automation;
+using anisthesia::detail::ElementProperty;
+using anisthesia::detail::ElementType;
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool InitializeUIAutomation() {
-  if (ui_automation)
-    return true;
+ComInterface<IUIAutomation> UIAutomation::Get() {
+  // Strategies may run on several threads at once.
+  std::lock_guard lock(mutex_);
+
+  if (!interface_)
+    interface_ = Create();
+  if (interface_)
+    interface_->AddRef();
+
+  return ComInterface<IUIAutomation>(interface_.get());
+}
+
+void UIAutomation::Reset() {
+  std::lock_guard lock(mutex_);
+  interface_.reset();
+}
 
+ComInterface<IUIAutomation> UIAutomation::Create() {
   // COM library must be initialized on the current thread before calling
-  // CoCreateInstance.
+  // CoCreateInstance. This has no effect on worker threads, which have already
+  // joined the multithreaded apartment.
   ::CoInitialize(nullptr);
 
   IUIAutomation* ui_automation_interface = nullptr;
   const auto result = ::CoCreateInstance(
       CLSID_CUIAutomation, nullptr, CLSCTX_INPROC_SERVER, IID_IUIAutomation,
       reinterpret_cast<void**>(&ui_automation_interface));
-  ui_automation.reset(ui_automation_interface);
+  if (FAILED(result))
+    return nullptr;
 
-  return SUCCEEDED(result);
+  return ComInterface<IUIAutomation>(ui_automation_interface);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-Element* GetElementFromHandle(HWND hwnd) {
+Element* GetElementFromHandle(IUIAutomation& ui_automation, HWND hwnd) {
   Element* element = nullptr;
-  ui_automation->ElementFromHandle(static_cast<UIA_HWND>(hwnd), &element);
+  ui_automation.ElementFromHandle(static_cast<UIA_HWND>(hwnd), &element);
   return element;
 }
 
@@ -86,160 +102,114 @@ std::wstring GetElementValue(Element& element) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool VerifyElementProperties(Element& element, const properties_t& properties) {
-  VARIANT v = {};
-  for (const auto& pair : properties) {
-    if (FAILED(element.GetCurrentPropertyValue(pair.first, &v)))
-      return false;
-    if (v.boolVal != (pair.second ? VARIANT_TRUE : VARIANT_FALSE))
-      return false;
-  }
-
-  return true;
-}
-
-bool IsAddressBarElement(Element& element) {
-  static const properties_t properties = {
-    {UIA_IsEnabledPropertyId, true},
-    {UIA_IsKeyboardFocusablePropertyId, true},
-    {UIA_IsValuePatternAvailablePropertyId, true},
-    {UIA_ValueIsReadOnlyPropertyId, false},
-  };
-
-  return VerifyElementProperties(element, properties);
-}
-
-bool IsTabsElement(Element& element) {
-  static const properties_t properties = {
-    {UIA_ValueIsReadOnlyPropertyId, true},
-  };
-
-  return VerifyElementProperties(element, properties);
-}
-
-////////////////////////////////////////////////////////////////////////////////
+// Elements are navigated in the control view, and every call crosses into the
+// process that owns the window. The tree walker must outlive the element.
+// Within the class, `Element` refers to the base class rather than to
+// IUIAutomationElement.
+class UiaElement final : public anisthesia::detail::Element {
+public:
+  UiaElement(ComInterface<IUIAutomationElement> element,
+             TreeWalker& tree_walker)
+      : element_(std::move(element)), tree_walker_(tree_walker) {}
+
+  ElementType type() override {
+    CONTROLTYPEID control_type_id = 0;
+    element_->get_CurrentControlType(&control_type_id);
 
-void WalkElements(TreeWalker& tree_walker, Element& parent, TreeScope scope,
-                  size_t depth, element_proc_t element_proc) {
-  constexpr size_t kMaxTreeDepth = 16;  // arbitrary value
-  if (depth > kMaxTreeDepth)
-    return;
+    switch (control_type_id) {
+      case UIA_DocumentControlTypeId: return ElementType::Document;
+      case UIA_EditControlTypeId: return ElementType::Edit;
+      case UIA_MenuBarControlTypeId: return ElementType::MenuBar;
+      case UIA_TabControlTypeId: return ElementType::Tab;
+      case UIA_TabItemControlTypeId: return ElementType::TabItem;
+      case UIA_TitleBarControlTypeId: return ElementType::TitleBar;
+      default: return ElementType::Other;
+    }
+  }
 
-  if (scope & TreeScope_Element)
-    scope = element_proc(parent);
+  std::string name() override {
+    return ToUtf8String(GetElementName(*element_));
+  }
 
-  auto descend = [](TreeScope scope) {
-    return (scope & TreeScope_Children) || (scope & TreeScope_Descendants);
-  };
+  std::string value() override {
+    return ToUtf8String(GetElementValue(*element_));
+  }
 
-  if (descend(scope)) {
-    Element* first_element = nullptr;
-    tree_walker.GetFirstChildElement(&parent, &first_element);
-    ComInterface<Element> element(first_element);
+  bool GetProperty(ElementProperty property, bool& value) override {
+    VARIANT v = {};
+    if (FAILED(element_->GetCurrentPropertyValue(GetPropertyId(property), &v)))
+      return false;
+    value = v.boolVal == VARIANT_TRUE;
+    return true;
+  }
 
-    while (element) {
-      scope = element_proc(*element);
+  std::unique_ptr<anisthesia::detail::Element> FirstChild() override {
+    IUIAutomationElement* element = nullptr;
+    tree_walker_.GetFirstChildElement(element_.get(), &element);
+    return Create(element);
+  }
 
-      if (descend(scope))
-        WalkElements(tree_walker, *element, scope, depth + 1, element_proc);
+  std::unique_ptr<anisthesia::detail::Element> NextSibling() override {
+    IUIAutomationElement* element = nullptr;
+    tree_walker_.GetNextSiblingElement(element_.get(), &element);
+    return Create(element);
+  }
 
-      Element* next_element = nullptr;
-      tree_walker.GetNextSiblingElement(element.get(), &next_element);
-      element.reset(next_element);
+private:
+  static PROPERTYID GetPropertyId(ElementProperty property) {
+    switch (property) {
+      case ElementProperty::IsEnabled:
+        return UIA_IsEnabledPropertyId;
+      case ElementProperty::IsKeyboardFocusable:
+        return UIA_IsKeyboardFocusablePropertyId;
+      case ElementProperty::IsValuePatternAvailable:
+        return UIA_IsValuePatternAvailablePropertyId;
+      case ElementProperty::ValueIsReadOnly:
+        return UIA_ValueIsReadOnlyPropertyId;
     }
+    return 0;
   }
-}
 
-bool FindWebBrowserElements(Element& parent, std::wstring& address,
-                            std::vector<std::wstring>& tabs) {
-  TreeWalker* tree_walker_interface = nullptr;
-  ui_automation->get_ControlViewWalker(&tree_walker_interface);
-  ComInterface<TreeWalker> tree_walker(tree_walker_interface);
-
-  if (!tree_walker)
-    return false;
-
-  auto element_proc = [&](Element& element) -> TreeScope {
-    CONTROLTYPEID control_type_id = 0;
-    element.get_CurrentControlType(&control_type_id);
-
-    switch (control_type_id) {
-      default:
-        // Are we done?
-        if (!address.empty() && !tabs.empty())
-          return TreeScope_Element;
-        // Otherwise continue descending the tree.
-        return TreeScope_Descendants;
-
-      case UIA_DocumentControlTypeId:
-      case UIA_MenuBarControlTypeId:
-      case UIA_TitleBarControlTypeId:
-        // We do not need to walk through these nodes. In fact, skipping
-        // documents dramatically improves our performance on worst case
-        // scenarios. This is the whole reason we are walking the tree rather
-        // than using FindFirst and FindAll methods.
-        return TreeScope_Element;
-
-      case UIA_EditControlTypeId:
-        // Here we assume that the first edit control that fits our properties
-        // is the address bar (e.g. "Omnibox" on Chrome, "Awesome Bar" on
-        // Firefox). This element is named differently on each web browser
-        // (e.g. "Address and search bar" on Chrome, "Search or enter address"
-        // on Firefox). This name can change depending on the browser
-        // language. However, we are only interested in the element value,
-        // which usually gives us the URL of the current page.
-        if (address.empty() && IsAddressBarElement(element)) {
-          address = GetElementValue(element);
-          return TreeScope_Element;
-        } else {
-          // Opera has an edit control ("Address field") within another edit
-          // control ("Address bar").
-          return TreeScope_Descendants;
-        }
-
-      case UIA_TabControlTypeId:
-        if (tabs.empty() && IsTabsElement(element))
-          return TreeScope_Children;
-        return TreeScope_Element;
-
-      case UIA_TabItemControlTypeId:
-        tabs.push_back(GetElementName(element));
-        return TreeScope_Element;
-    }
-  };
+  std::unique_ptr<anisthesia::detail::Element> Create(
+      IUIAutomationElement* element) {
+    if (!element)
+      return nullptr;
+    return std::make_unique<UiaElement>(
+        ComInterface<IUIAutomationElement>(element), tree_walker_);
+  }
 
-  WalkElements(*tree_walker, parent, TreeScope_Subtree, 0, element_proc);
-  return true;
-}
+  ComInterface<IUIAutomationElement> element_;
+  TreeWalker& tree_walker_;
+};
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool GetWebBrowserInformation(HWND hwnd, web_browser_proc_t web_browser_proc) {
+bool GetWebBrowserInformation(UIAutomation& ui_automation,
+                              ElementPathCache& cache, const Window& window,
+                              web_browser_proc_t web_browser_proc,
+                              std::stop_token stop_token) {
   if (!web_browser_proc)
     return false;
 
-  if (!InitializeUIAutomation())
+  // A reference is held, so that the interface outlives a reset
+  const auto ui_automation_interface = ui_automation.Get();
+  if (!ui_automation_interface)
     return false;
 
-  ComInterface<Element> parent(GetElementFromHandle(hwnd));
+  ComInterface<Element> parent(GetElementFromHandle(
+      *ui_automation_interface, reinterpret_cast<HWND>(window.handle)));
   if (!parent)
     return false;
 
-  const std::wstring title = GetElementName(*parent);
-  web_browser_proc({WebBrowserInformationType::Title, title});
-
-  std::wstring address;
-  std::vector<std::wstring> tabs;
-
-  if (!FindWebBrowserElements(*parent, address, tabs))
+  TreeWalker* tree_walker_interface = nullptr;
+  ui_automation_interface->get_ControlViewWalker(&tree_walker_interface);
+  ComInterface<TreeWalker> tree_walker(tree_walker_interface);
+  if (!tree_walker)
     return false;
 
-  web_browser_proc({WebBrowserInformationType::Address, address});
-  for (const auto& tab : tabs) {
-    web_browser_proc({WebBrowserInformationType::Tab, tab});
-  }
-
-  return true;
+  UiaElement root(std::move(parent), *tree_walker);
+  return anisthesia::detail::GetWebBrowserInformation(
+      root, window, cache, std::move(web_browser_proc), stop_token);
 }
 
 }  // namespace anisthesia::win::detail
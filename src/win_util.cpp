@@ -1,4 +1,5 @@
 #include <string>
+#include <string_view>
 
 #include <windows.h>
 
@@ -16,11 +17,46 @@ std::wstring GetFileNameWithoutExtension(const std::wstring& filename) {
   return pos != std::wstring::npos ? filename.substr(0, pos) : filename;
 }
 
-bool IsSystemDirectory(const std::wstring& path) {
-  // @TODO: Use %windir% environment variable
-  static const std::wstring windir = L"C:\\Windows";
-  const size_t pos = path.find_first_not_of(L"\\?");
-  return path.substr(pos, windir.size()) == windir;
+const anisthesia::detail::WidePathTrie& GetSystemDirectories() {
+  static const auto directories = []() {
+    anisthesia::detail::WidePathTrie directories;
+
+    std::wstring buffer(MAX_PATH, L'\0');
+    auto size = ::GetEnvironmentVariableW(L"windir", buffer.data(),
+                                          static_cast<DWORD>(buffer.size()));
+    if (size > 0 && size < buffer.size())
+      directories.Insert(std::wstring_view(buffer.data(), size));
+
+    // In case the variable is not set, or has been tampered with
+    size = ::GetWindowsDirectoryW(buffer.data(),
+                                  static_cast<UINT>(buffer.size()));
+    if (size > 0 && size < buffer.size())
+      directories.Insert(std::wstring_view(buffer.data(), size));
+
+    if (directories.empty())
+      directories.Insert(L"C:\\Windows");
+
+    return directories;
+  }();
+
+  return directories;
+}
+
+bool IsSystemDirectory(std::wstring_view path) {
+  return GetSystemDirectories().Match(path);
+}
+
+ULONGLONG GetProcessCreationTime(HANDLE process_handle) {
+  FILETIME creation_time = {};
+  FILETIME exit_time = {};
+  FILETIME kernel_time = {};
+  FILETIME user_time = {};
+  if (!::GetProcessTimes(process_handle, &creation_time, &exit_time,
+                         &kernel_time, &user_time)) {
+    return 0;
+  }
+  return (static_cast<ULONGLONG>(creation_time.dwHighDateTime) << 32) |
+         creation_time.dwLowDateTime;
 }
 
 std::string ToUtf8String(const std::wstring& str) {
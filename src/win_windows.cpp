@@ -1,9 +1,11 @@
+#include <map>
 #include <set>
 #include <string>
+#include <utility>
 
 #include <windows.h>
 
-#include <anisthesia/win_platform.hpp>
+#include <anisthesia/platform.hpp>
 #include <anisthesia/win_util.hpp>
 #include <anisthesia/win_windows.hpp>
 
@@ -35,28 +37,14 @@ DWORD GetWindowProcessId(HWND hwnd) {
   return process_id;
 }
 
-std::wstring GetProcessPath(DWORD process_id) {
-  // If we try to open a SYSTEM process, this function fails and the last error
-  // code is ERROR_ACCESS_DENIED.
-  //
-  // Note that if we requested PROCESS_QUERY_INFORMATION access right instead
-  // of PROCESS_QUERY_LIMITED_INFORMATION, this function would fail when used
-  // to open an elevated process.
-  Handle process_handle(::OpenProcess(
-      PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process_id));
-
-  if (!process_handle)
-    return std::wstring();
-
+std::wstring GetProcessPath(HANDLE process_handle) {
   WCHAR buffer[MAX_PATH];
   DWORD buffer_size = MAX_PATH;
 
   // Note that this function requires Windows Vista or above. You may use
   // GetProcessImageFileName or GetModuleFileNameEx on earlier versions.
-  if (!::QueryFullProcessImageName(process_handle.get(), 0,
-                                   buffer, &buffer_size)) {
+  if (!::QueryFullProcessImageName(process_handle, 0, buffer, &buffer_size))
     return std::wstring();
-  }
 
   return std::wstring(buffer, buffer_size);
 }
@@ -121,6 +109,47 @@ bool VerifyProcessFileName(const std::wstring& name) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+ProcessInfo ResolveProcess(ProcessCache& cache, DWORD process_id) {
+  // If we try to open a SYSTEM process, this function fails and the last error
+  // code is ERROR_ACCESS_DENIED.
+  //
+  // Note that if we requested PROCESS_QUERY_INFORMATION access right instead
+  // of PROCESS_QUERY_LIMITED_INFORMATION, this function would fail when used
+  // to open an elevated process.
+  Handle process_handle(::OpenProcess(
+      PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process_id));
+
+  if (!process_handle)
+    return {};
+
+  // Only processes that are new since the last enumeration are queried
+  const ProcessKey key{process_id,
+                       GetProcessCreationTime(process_handle.get())};
+  if (auto info = cache.Find(key))
+    return std::move(*info);
+
+  ProcessInfo info;
+  info.path = GetProcessPath(process_handle.get());
+  const auto name =
+      GetFileNameWithoutExtension(GetFileNameFromPath(info.path));
+  info.name = ToUtf8String(name);
+  info.valid = VerifyProcessPath(info.path) && VerifyProcessFileName(name);
+
+  // A path that could not be read (e.g. while the process is starting) is
+  // not remembered, so that the process is queried again next time.
+  if (!info.path.empty())
+    cache.Insert(key, info);
+  return info;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct EnumWindowsContext {
+  ProcessCache& cache;
+  window_proc_t window_proc;
+  std::map<DWORD, ProcessInfo> processes;  // processes often own many windows
+};
+
 BOOL CALLBACK EnumWindowsProc(HWND hwnd, LPARAM param) {
   if (!::IsWindowVisible(hwnd))
     return TRUE;
@@ -128,41 +157,51 @@ BOOL CALLBACK EnumWindowsProc(HWND hwnd, LPARAM param) {
   if (!VerifyWindowStyle(hwnd))
     return TRUE;
 
-  Window window;
-  window.handle = hwnd;
-  window.text = GetWindowText(hwnd);
-
-  window.class_name = GetWindowClassName(hwnd);
-  if (!VerifyClassName(window.class_name))
+  const auto class_name = GetWindowClassName(hwnd);
+  if (!VerifyClassName(class_name))
     return TRUE;
 
-  Process process;
-  process.id = GetWindowProcessId(hwnd);
+  auto& context = *reinterpret_cast<EnumWindowsContext*>(param);
 
-  const auto path = GetProcessPath(process.id);
-  if (!VerifyProcessPath(path))
+  const auto process_id = GetWindowProcessId(hwnd);
+  auto [it, inserted] = context.processes.try_emplace(process_id);
+  if (inserted)
+    it->second = ResolveProcess(context.cache, process_id);
+  if (!it->second.valid)
     return TRUE;
 
-  process.name = GetFileNameWithoutExtension(GetFileNameFromPath(path));
-  if (!VerifyProcessFileName(process.name))
-    return TRUE;
+  Window window;
+  window.handle = reinterpret_cast<window_handle_t>(hwnd);
+  window.class_name = ToUtf8String(class_name);
+  window.text = ToUtf8String(GetWindowText(hwnd));
 
-  auto& window_proc = *reinterpret_cast<window_proc_t*>(param);
-  if (!window_proc(process, window))
+  Process process;
+  process.id = process_id;
+  process.name = it->second.name;
+
+  if (!context.window_proc(process, window))
     return FALSE;
 
   return TRUE;
 }
 
-bool EnumerateWindows(window_proc_t window_proc) {
+bool EnumerateWindows(ProcessCache& cache, window_proc_t window_proc) {
   if (!window_proc)
     return false;
 
-  const auto param = reinterpret_cast<LPARAM>(&window_proc);
+  EnumWindowsContext context{cache, std::move(window_proc)};
+  const auto param = reinterpret_cast<LPARAM>(&context);
 
   // Note that EnumWindows enumerates only top-level windows of desktop apps
   // (as opposed to UWP apps) on Windows 8 and above.
-  return ::EnumWindows(EnumWindowsProc, param) != FALSE;
+  const bool result = ::EnumWindows(EnumWindowsProc, param) != FALSE;
+
+  // Processes that were not looked up no longer have any windows. The result
+  // is also false if the enumeration was stopped.
+  if (result)
+    cache.Sweep();
+
+  return result;
 }
 
 }  // namespace anisthesia::win::detail
@@ -0,0 +1,177 @@
+// Times detection on a fake platform that runs the players of a players file,
+// so that changes to matching and to the detector can be measured without the
+// cost of a real system. Each window belongs to a process of its own, whose
+// player is taken in turn from the file, and which has a video open. Windows
+// are titled the way most players title them.
+//
+// GetResults is timed on a detector that has seen the windows before, and Poll
+// both after a reset, when every result is new, and when nothing has changed.
+//
+// Usage: anisthesia-bench-detector [--iterations <count>]
+//                                  [--windows <count>] <players file>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <anisthesia.hpp>
+#include <anisthesia/fake_platform.hpp>
+
+namespace {
+
+using namespace anisthesia;
+
+constexpr process_id_t kFirstProcessId = 1000;
+
+bool ParseCount(const std::string& str, size_t& count) {
+  const auto end = str.data() + str.size();
+  const auto [ptr, ec] = std::from_chars(str.data(), end, count);
+  return ec == std::errc{} && ptr == end && count;
+}
+
+// Patterns (i.e. those that begin with '^') cannot be named
+const std::string* GetLiteral(const std::vector<std::string>& strings) {
+  for (const auto& str : strings) {
+    if (!str.starts_with('^'))
+      return &str;
+  }
+  return nullptr;
+}
+
+// Returns the number of windows that were added
+size_t AddWindows(FakePlatform& platform, const std::vector<Player>& players,
+                  size_t window_count) {
+  std::vector<const Player*> candidates;
+  for (const auto& player : players) {
+    if (GetLiteral(player.windows) && GetLiteral(player.executables))
+      candidates.push_back(&player);
+  }
+  if (candidates.empty())
+    return 0;
+
+  for (size_t i = 0; i < window_count; ++i) {
+    const auto& player = *candidates[i % candidates.size()];
+    const auto process_id = static_cast<process_id_t>(kFirstProcessId + i);
+    const auto episode = std::to_string(i % 24 + 1);
+    platform.AddProcess({process_id, *GetLiteral(player.executables)});
+    platform.AddWindow(process_id, {i + 1, *GetLiteral(player.windows),
+                                    "Show - " + episode + " - " + player.name});
+    platform.AddOpenFile({process_id, "/videos/Show - " + episode + ".mkv"});
+  }
+
+  return window_count;
+}
+
+struct Timing {
+  double best = 0.0;
+  double median = 0.0;
+};
+
+Timing Summarize(std::vector<double> times) {
+  std::sort(times.begin(), times.end());
+  return {times.front(), times[times.size() / 2]};
+}
+
+template <typename Function>
+bool Time(Function function, double& time) {
+  const auto start = std::chrono::steady_clock::now();
+  const bool success = function();
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  time = elapsed.count();
+  return success;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  size_t iterations = 10;
+  size_t window_count = 1000;
+  bool valid = args.size() % 2 == 1;
+  for (size_t i = 0; valid && i + 1 < args.size(); i += 2) {
+    if (args[i] == "--iterations") {
+      valid = ParseCount(args[i + 1], iterations);
+    } else if (args[i] == "--windows") {
+      valid = ParseCount(args[i + 1], window_count);
+    } else {
+      valid = false;
+    }
+  }
+  if (!valid) {
+    std::fprintf(stderr,
+                 "Usage: %s [--iterations <count>] [--windows <count>] "
+                 "<players file>\n",
+                 argv[0]);
+    return 1;
+  }
+
+  std::vector<Player> players;
+  if (!ParsePlayersFile(args.back(), players)) {
+    std::fprintf(stderr, "Could not parse %s\n", args.back().c_str());
+    return 1;
+  }
+
+  auto platform = std::make_shared<FakePlatform>();
+  if (!AddWindows(*platform, players, window_count)) {
+    std::fprintf(stderr, "Could not find a player with a window class\n");
+    return 1;
+  }
+
+  Detector detector(platform, PlayerTable(players));
+  const auto media_proc = [](const MediaInfo&) { return true; };
+
+  // Detected once beforehand, so that every iteration does the same work
+  std::vector<Result> results;
+  ChangeSet changes;
+  if (!detector.GetResults(media_proc, results) || results.empty()) {
+    std::fprintf(stderr, "Could not detect any of %zu windows\n",
+                 window_count);
+    return 1;
+  }
+  const size_t result_count = results.size();
+
+  std::vector<double> get_times(iterations);
+  std::vector<double> new_poll_times(iterations);
+  std::vector<double> unchanged_poll_times(iterations);
+  bool success = true;
+  for (size_t i = 0; success && i < iterations; ++i) {
+    results.clear();
+    success =
+        Time([&] { return detector.GetResults(media_proc, results); },
+             get_times[i]) &&
+        results.size() == result_count;
+
+    detector.Reset();
+    success = success &&
+              Time([&] { return detector.Poll(media_proc, changes); },
+                   new_poll_times[i]) &&
+              changes.appeared.size() == result_count;
+
+    success = success &&
+              Time([&] { return detector.Poll(media_proc, changes); },
+                   unchanged_poll_times[i]) &&
+              changes.empty();
+  }
+  if (!success) {
+    std::fprintf(stderr, "Results changed between iterations\n");
+    return 1;
+  }
+
+  const auto get = Summarize(get_times);
+  const auto new_poll = Summarize(new_poll_times);
+  const auto unchanged_poll = Summarize(unchanged_poll_times);
+  std::printf(
+      "%zu windows (%zu detected): GetResults best %.2f ms, median %.2f ms; "
+      "new Poll best %.2f ms, median %.2f ms; unchanged Poll best %.2f ms, "
+      "median %.2f ms\n",
+      window_count, result_count, get.best, get.median, new_poll.best,
+      new_poll.median, unchanged_poll.best, unchanged_poll.median);
+
+  return 0;
+}
@@ -0,0 +1,256 @@
+// Times the Linux open_files scan on a child process that holds thousands of
+// descriptors, as a player with many libraries, sockets and caches might, with
+// a cold cache and with a warm one. Descriptors are a mix of character devices,
+// pipes, and files opened for reading or writing, of which one is a video.
+//
+// Usage: anisthesia-bench-open-files [--iterations <count>]
+//                                    [--descriptors <count>]
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <anisthesia/extension_set.hpp>
+#include <anisthesia/linux_open_files.hpp>
+
+namespace {
+
+using namespace anisthesia;
+
+constexpr size_t kDataFiles = 256;
+constexpr rlim_t kSpareDescriptors = 64;
+
+bool ParseCount(const std::string& str, size_t& count) {
+  const auto end = str.data() + str.size();
+  const auto [ptr, ec] = std::from_chars(str.data(), end, count);
+  return ec == std::errc{} && ptr == end && count;
+}
+
+bool RaiseDescriptorLimit(size_t descriptor_count) {
+  struct rlimit limit = {};
+  if (::getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    return false;
+
+  const rlim_t required = descriptor_count + kSpareDescriptors;
+  if (limit.rlim_cur >= required)
+    return true;
+  if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < required)
+    return false;
+
+  limit.rlim_cur = required;
+  return ::setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+bool CreateFiles(const std::filesystem::path& directory) {
+  for (size_t i = 0; i < kDataFiles; ++i) {
+    std::ofstream file(directory / ("data" + std::to_string(i) + ".dat"));
+    if (!file)
+      return false;
+  }
+  std::ofstream file(directory / "video.mkv");
+  return static_cast<bool>(file);
+}
+
+// Runs in the child. Descriptors are left open on purpose.
+bool OpenDescriptors(const std::filesystem::path& directory,
+                     size_t descriptor_count) {
+  int pipe_fds[2];
+  if (::pipe(pipe_fds) != 0)
+    return false;
+
+  const auto video = directory / "video.mkv";
+  if (::open(video.c_str(), O_RDONLY) < 0)
+    return false;
+
+  for (size_t i = 3; i < descriptor_count; ++i) {
+    int fd = -1;
+    const auto data = directory / ("data" + std::to_string(i % kDataFiles) +
+                                   ".dat");
+    switch (i % 4) {
+      case 0:
+        fd = ::open("/dev/null", O_RDONLY);
+        break;
+      case 1:
+        fd = ::dup(pipe_fds[i % 2]);
+        break;
+      case 2:
+        fd = ::open(data.c_str(), O_RDONLY);
+        break;
+      case 3:
+        fd = ::open(data.c_str(), O_RDWR);
+        break;
+    }
+    if (fd < 0)
+      return false;
+  }
+
+  return true;
+}
+
+// Holds the descriptors until it is killed. Returns 0 if it could not start.
+pid_t StartChild(const std::filesystem::path& directory,
+                 size_t descriptor_count) {
+  int ready_fds[2];
+  if (::pipe(ready_fds) != 0)
+    return 0;
+
+  const pid_t pid = ::fork();
+  if (pid < 0) {
+    ::close(ready_fds[0]);
+    ::close(ready_fds[1]);
+    return 0;
+  }
+
+  if (pid == 0) {
+    ::close(ready_fds[0]);
+    const char status = OpenDescriptors(directory, descriptor_count);
+    if (::write(ready_fds[1], &status, 1) != 1 || !status)
+      ::_exit(1);
+    while (true) {
+      ::pause();
+    }
+  }
+
+  ::close(ready_fds[1]);
+  char status = 0;
+  const bool ready = ::read(ready_fds[0], &status, 1) == 1 && status;
+  ::close(ready_fds[0]);
+  if (!ready) {
+    ::kill(pid, SIGKILL);
+    ::waitpid(pid, nullptr, 0);
+    return 0;
+  }
+
+  return pid;
+}
+
+struct Timing {
+  double best = 0.0;
+  double median = 0.0;
+};
+
+Timing Summarize(std::vector<double> times) {
+  std::sort(times.begin(), times.end());
+  return {times.front(), times[times.size() / 2]};
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  size_t iterations = 10;
+  size_t descriptor_count = 10000;
+  bool valid = args.size() % 2 == 0;
+  for (size_t i = 0; valid && i < args.size(); i += 2) {
+    if (args[i] == "--iterations") {
+      valid = ParseCount(args[i + 1], iterations);
+    } else if (args[i] == "--descriptors") {
+      valid = ParseCount(args[i + 1], descriptor_count) &&
+              descriptor_count > 3;
+    } else {
+      valid = false;
+    }
+  }
+  if (!valid) {
+    std::fprintf(stderr,
+                 "Usage: %s [--iterations <count>] [--descriptors <count>]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  if (!RaiseDescriptorLimit(descriptor_count)) {
+    std::fprintf(stderr, "Could not raise the descriptor limit to %zu\n",
+                 descriptor_count + kSpareDescriptors);
+    return 1;
+  }
+
+  std::error_code ec;
+  std::string directory_template =
+      (std::filesystem::temp_directory_path(ec) / "anisthesia-XXXXXX")
+          .string();
+  if (ec || !::mkdtemp(directory_template.data())) {
+    std::fprintf(stderr, "Could not create a temporary directory\n");
+    return 1;
+  }
+  const std::filesystem::path directory = directory_template;
+
+  int result = 0;
+  const pid_t pid = CreateFiles(directory) ? StartChild(directory,
+                                                        descriptor_count)
+                                           : 0;
+  if (!pid) {
+    std::fprintf(stderr, "Could not start a process with %zu descriptors\n",
+                 descriptor_count);
+    result = 1;
+  }
+
+  const detail::ExtensionSet extensions(GetDefaultMediaExtensions());
+  OpenFileFilter filter;
+  filter.extensions = &extensions;
+  const std::set<process_id_t> process_ids{static_cast<process_id_t>(pid)};
+
+  // Each scan must find the video, and nothing else
+  auto time_scan = [&](lin::detail::OpenFileCache& cache, double& time) {
+    size_t found = 0;
+    const auto start = std::chrono::steady_clock::now();
+    const bool success = lin::detail::EnumerateOpenFiles(
+        cache, process_ids,
+        [&found](const OpenFile& open_file) {
+          found += open_file.path.ends_with("/video.mkv") ? 1 : 2;
+          return true;
+        },
+        filter);
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    time = elapsed.count();
+    return success && found == 1;
+  };
+
+  std::vector<double> cold_times(iterations);
+  std::vector<double> warm_times(iterations);
+  lin::detail::OpenFileCache warm_cache;
+  double time = 0.0;
+  bool success = pid && time_scan(warm_cache, time);
+  for (size_t i = 0; success && i < iterations; ++i) {
+    lin::detail::OpenFileCache cold_cache;
+    success = time_scan(cold_cache, cold_times[i]) &&
+              time_scan(warm_cache, warm_times[i]);
+  }
+
+  if (pid) {
+    ::kill(pid, SIGKILL);
+    ::waitpid(pid, nullptr, 0);
+  }
+  std::filesystem::remove_all(directory, ec);
+
+  if (pid && !success) {
+    std::fprintf(stderr, "Could not find the open video of process %d\n",
+                 static_cast<int>(pid));
+    result = 1;
+  }
+  if (result)
+    return result;
+
+  const auto cold = Summarize(cold_times);
+  const auto warm = Summarize(warm_times);
+  std::printf(
+      "%zu descriptors: cold best %.2f ms, median %.2f ms; "
+      "warm best %.2f ms, median %.2f ms\n",
+      descriptor_count, cold.best, cold.median, warm.best, warm.median);
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+// Times ParsePlayersData on synthetic players files, so that changes to the
+// parser can be measured on databases much larger than the stock one. Each
+// player has the sections of a typical entry, with a few of the optional ones.
+//
+// Usage: anisthesia-bench-players [--iterations <count>] [<players>...]
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <anisthesia/player.hpp>
+
+namespace {
+
+using namespace anisthesia;
+
+bool ParseCount(const std::string& str, size_t& count) {
+  const auto end = str.data() + str.size();
+  const auto [ptr, ec] = std::from_chars(str.data(), end, count);
+  return ec == std::errc{} && ptr == end && count;
+}
+
+std::string GeneratePlayersData(size_t player_count) {
+  std::string data =
+      "# Synthetic players file\n"
+      "#\n"
+      "# Generated by anisthesia-bench-players.\n"
+      "\n";
+
+  char buffer[32];
+  for (size_t i = 0; i < player_count; ++i) {
+    std::snprintf(buffer, sizeof(buffer), "%06zu", i);
+    const std::string id = buffer;
+
+    data += "Player " + id;
+    data += "\n\twindows:\n\t\tQt5QWindowIcon\n";
+    if (i % 4 == 0)
+      data += "\t\t^Player" + id + R"(Window\d+$)" "\n";
+    data += "\texecutables:\n\t\tplayer" + id + "\n";
+    if (i % 2 == 0)
+      data += "\t\tplayer" + id + "_x64\n";
+    data += "\tstrategies:\n";
+    if (i % 3 == 0)
+      data += "\t\tui_automation\n";
+    data += "\t\topen_files\n";
+    data += "\t\twindow_title:\n\t\t\t^(.+) - Player " + id + "$\n";
+    data += "\ttype:\n\t\t";
+    data += i % 10 == 0 ? "web_browser\n" : "default\n";
+    if (i % 5 == 0)
+      data += "\toptions:\n\t\texhaustive\n";
+    if (i % 7 == 0)
+      data += "\textensions:\n\t\tm2ts\n\t\tvob\n";
+    data += "\n";
+  }
+
+  return data;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  bool valid = true;
+  size_t iterations = 10;
+  if (args.size() >= 2 && args.front() == "--iterations") {
+    valid = ParseCount(args[1], iterations);
+    args.erase(args.begin(), args.begin() + 2);
+  }
+
+  std::vector<size_t> player_counts;
+  for (const auto& arg : args) {
+    size_t count = 0;
+    valid = valid && ParseCount(arg, count);
+    player_counts.push_back(count);
+  }
+
+  if (!valid) {
+    std::fprintf(stderr, "Usage: %s [--iterations <count>] [<players>...]\n",
+                 argv[0]);
+    return 1;
+  }
+  if (player_counts.empty())
+    player_counts = {10000, 100000};
+
+  for (const auto player_count : player_counts) {
+    const auto data = GeneratePlayersData(player_count);
+
+    std::vector<double> times;
+    for (size_t i = 0; i < iterations; ++i) {
+      std::vector<Player> players;
+      const auto start = std::chrono::steady_clock::now();
+      const bool success = ParsePlayersData(data, players);
+      const std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+
+      if (!success || players.size() != player_count) {
+        std::fprintf(stderr, "Could not parse %zu players\n", player_count);
+        return 1;
+      }
+      times.push_back(elapsed.count());
+    }
+
+    std::sort(times.begin(), times.end());
+    const auto best = times.front();
+    const auto median = times[times.size() / 2];
+    const auto megabytes = data.size() / (1024.0 * 1024.0);
+
+    std::printf(
+        "%zu players (%.1f MiB): best %.2f ms (%.0f MiB/s), median %.2f ms\n",
+        player_count, megabytes, best, megabytes / (best / 1000), median);
+  }
+
+  return 0;
+}
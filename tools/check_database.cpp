@@ -0,0 +1,162 @@
+// Checks that a detector picks up the players that a watched database reloads:
+// a file that is rewritten in place, or replaced by another one, is swapped in
+// by the next poll, and one that fails to parse leaves the players as they are.
+//
+// Usage: anisthesia-check-database
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <anisthesia.hpp>
+#include <anisthesia/database.hpp>
+#include <anisthesia/fake_platform.hpp>
+#include <anisthesia/util.hpp>
+
+namespace {
+
+using namespace anisthesia;
+
+constexpr auto kReloadTimeout = std::chrono::seconds(5);
+// A reload takes milliseconds, so one that has not happened by then won't
+constexpr auto kNoReloadTimeout = std::chrono::milliseconds(500);
+
+int failures = 0;
+
+void Expect(bool condition, const char* description) {
+  std::printf("%s: %s\n", condition ? "ok" : "FAILED", description);
+  if (!condition)
+    ++failures;
+}
+
+std::string PlayersData(const char* name, const char* extensions) {
+  std::string data = name;
+  data +=
+      "\n"
+      "\twindows:\n"
+      "\t\tplayer\n"
+      "\texecutables:\n"
+      "\t\tplayer\n"
+      "\tstrategies:\n"
+      "\t\topen_files\n";
+  if (*extensions) {
+    data += "\textensions:\n\t\t";
+    data += extensions;
+    data += "\n";
+  }
+  return data;
+}
+
+// Editors that save atomically write another file and rename it
+bool ReplaceFile(const std::filesystem::path& path, const std::string& data) {
+  auto temporary_path = path;
+  temporary_path += ".tmp";
+  if (!detail::util::WriteFile(temporary_path.string(), data))
+    return false;
+
+  std::error_code ec;
+  std::filesystem::rename(temporary_path, path, ec);
+  return !ec;
+}
+
+bool WaitForGeneration(const PlayersDatabase& database, uint64_t generation,
+                       std::chrono::milliseconds timeout = kReloadTimeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (database.generation() < generation) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
+bool HasPlayer(const std::vector<Result>& results, const char* name) {
+  return results.size() == 1 && results.front().player.name == name;
+}
+
+void CheckReload(const std::filesystem::path& path) {
+  auto platform = std::make_shared<FakePlatform>();
+  platform->AddProcess({100, "player"});
+  platform->AddWindow(100, {1, "player", "Player"});
+  platform->AddOpenFile({100, "/videos/Show - 01.mkv"});
+  platform->AddOpenFile({100, "/videos/Show - 01.xyz"});
+
+  auto database = std::make_shared<PlayersDatabase>();
+  if (!detail::util::WriteFile(path.string(), PlayersData("Old", "")) ||
+      !database->Load(path.string()) || !database->Watch()) {
+    Expect(false, "database is loaded and watched");
+    return;
+  }
+
+  DetectorOptions options;
+  options.worker_count = 0;
+  Detector detector(platform, database, options);
+  const auto media_proc = [](const MediaInfo&) { return true; };
+
+  ChangeSet changes;
+  Expect(detector.Poll(media_proc, changes) &&
+             HasPlayer(changes.appeared, "Old"),
+         "players of the database are detected");
+  Expect(detector.Poll(media_proc, changes) && changes.empty(),
+         "poll without a reload is empty");
+
+  // Rewritten in place
+  auto generation = database->generation();
+  Expect(detail::util::WriteFile(path.string(), PlayersData("New", "")) &&
+             WaitForGeneration(*database, generation + 1),
+         "file that is rewritten in place is reloaded");
+  Expect(detector.Poll(media_proc, changes) &&
+             HasPlayer(changes.disappeared, "Old") &&
+             HasPlayer(changes.appeared, "New") && changes.changed.empty(),
+         "renamed player is swapped in by the next poll");
+
+  // Replaced, with an extension that reveals another file of the same window
+  generation = database->generation();
+  Expect(ReplaceFile(path, PlayersData("New", "xyz")) &&
+             WaitForGeneration(*database, generation + 1),
+         "file that is replaced is reloaded");
+  Expect(detector.Poll(media_proc, changes) && changes.appeared.empty() &&
+             changes.disappeared.empty() && changes.changed.size() == 1 &&
+             changes.changed.front().added.size() == 1 &&
+             changes.changed.front().removed.empty(),
+         "window of a changed player is detected again");
+
+  // Excessive indentation cannot be parsed
+  generation = database->generation();
+  Expect(ReplaceFile(path, "Broken\n\t\t\t\t\tplayer\n") &&
+             !WaitForGeneration(*database, generation + 1, kNoReloadTimeout),
+         "file that fails to parse is not published");
+  Expect(detector.Poll(media_proc, changes) && changes.empty(),
+         "players are kept when the file fails to parse");
+
+  database->Unwatch();
+}
+
+}  // namespace
+
+int main() {
+  std::error_code ec;
+  const auto directory =
+      std::filesystem::temp_directory_path(ec) /
+      ("anisthesia-check-database-" + std::to_string(std::random_device{}()));
+  if (ec || !std::filesystem::create_directory(directory, ec)) {
+    std::fprintf(stderr, "Could not create a temporary directory\n");
+    return 1;
+  }
+
+  CheckReload(directory / "players.anisthesia");
+
+  std::filesystem::remove_all(directory, ec);
+
+  if (failures) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,178 @@
+// Checks FilterHandles against the scalar reference on random handle tables,
+// including every length that is not a multiple of the vector width, then
+// times both on a large table in which few handles belong to the players.
+//
+// Usage: anisthesia-check-handle-scan [--entries <count>] [--seed <seed>]
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <anisthesia/handle_scan.hpp>
+
+namespace {
+
+using namespace anisthesia::detail;
+
+constexpr size_t kIterations = 10;
+
+template <typename T>
+bool ParseNumber(const std::string& str, T& value) {
+  const auto end = str.data() + str.size();
+  const auto [ptr, ec] = std::from_chars(str.data(), end, value);
+  return ec == std::errc{} && ptr == end;
+}
+
+class TableGenerator {
+public:
+  explicit TableGenerator(uint32_t seed) : random_(seed) {}
+
+  // Process IDs are drawn from a small range, so that filters match some of
+  // them. The upper half of UniqueProcessId must be ignored.
+  std::vector<HandleTableEntry> Entries(size_t count, uint32_t process_count) {
+    std::vector<HandleTableEntry> entries(count);
+    for (auto& entry : entries) {
+      uint64_t process_id = Next() % process_count + 1;
+      if (Next() % 4 == 0)
+        process_id |= uint64_t{Next()} << 32;
+      entry.UniqueProcessId = static_cast<uintptr_t>(process_id);
+      entry.HandleValue = reinterpret_cast<void*>(uintptr_t{Next() & ~3u});
+      entry.GrantedAccess = Next() & Next();  // sparse bits
+      entry.ObjectTypeIndex = static_cast<uint16_t>(Next() % 8);
+    }
+    return entries;
+  }
+
+  HandleFilter Filter(std::vector<uint32_t>& process_ids,
+                      uint32_t process_count) {
+    process_ids.resize(Next() % 5);
+    for (auto& process_id : process_ids) {
+      process_id = Next() % (process_count + 1) + 1;  // may match none
+    }
+
+    HandleFilter filter;
+    filter.process_ids = process_ids;
+    filter.object_type_index =
+        Next() % 2 ? static_cast<uint16_t>(Next() % 8) : 0;
+    filter.required_access = Next() % 2 ? 1u << (Next() % 32) : 0;
+    filter.excluded_access = Next() % 2 ? 1u << (Next() % 32) : 0;
+    return filter;
+  }
+
+private:
+  uint32_t Next() { return static_cast<uint32_t>(random_()); }
+
+  std::mt19937 random_;
+};
+
+bool Compare(const std::vector<HandleTableEntry>& entries,
+             const HandleFilter& filter) {
+  // Indices are appended to what the vector already holds
+  std::vector<size_t> expected{SIZE_MAX};
+  std::vector<size_t> actual{SIZE_MAX};
+  FilterHandlesScalar(entries, filter, 0, expected);
+  FilterHandles(entries, filter, actual);
+
+  if (actual == expected)
+    return true;
+
+  std::fprintf(stderr,
+               "Mismatch on %zu entries (%zu process IDs, type %u, required "
+               "%08X, excluded %08X): %zu indices, expected %zu\n",
+               entries.size(), filter.process_ids.size(),
+               filter.object_type_index, filter.required_access,
+               filter.excluded_access, actual.size() - 1, expected.size() - 1);
+  return false;
+}
+
+template <typename Function>
+double Time(Function function) {
+  double best = 0.0;
+  for (size_t i = 0; i < kIterations; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (!i || elapsed.count() < best)
+      best = elapsed.count();
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  size_t entry_count = 2000000;
+  uint32_t seed = 1;
+  bool valid = args.size() % 2 == 0;
+  for (size_t i = 0; valid && i < args.size(); i += 2) {
+    if (args[i] == "--entries") {
+      valid = ParseNumber(args[i + 1], entry_count);
+    } else if (args[i] == "--seed") {
+      valid = ParseNumber(args[i + 1], seed);
+    } else {
+      valid = false;
+    }
+  }
+  if (!valid) {
+    std::fprintf(stderr, "Usage: %s [--entries <count>] [--seed <seed>]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  TableGenerator generator(seed);
+  std::vector<uint32_t> process_ids;
+  size_t tables = 0;
+  size_t mismatches = 0;
+
+  // Every length up to several vector widths, and then some longer ones
+  for (size_t size = 0; size < 64; ++size) {
+    for (int i = 0; i < 50; ++i) {
+      const auto entries = generator.Entries(size, 4);
+      mismatches += !Compare(entries, generator.Filter(process_ids, 4));
+      ++tables;
+    }
+  }
+  for (int i = 0; i < 200; ++i) {
+    const auto entries = generator.Entries(1000 + i, 16);
+    mismatches += !Compare(entries, generator.Filter(process_ids, 16));
+    ++tables;
+  }
+
+  std::printf("%zu tables, %zu mismatches\n", tables, mismatches);
+  if (mismatches)
+    return 1;
+
+  // Most handles of a busy system belong to processes other than the players
+  const auto entries = generator.Entries(entry_count, 2000);
+  const uint32_t player_ids[] = {1, 2};
+  HandleFilter filter;
+  filter.process_ids = player_ids;
+  filter.object_type_index = 3;
+  filter.required_access = 1;
+
+  std::vector<size_t> indices;
+  indices.reserve(entry_count);
+  const auto scalar = Time([&]() {
+    indices.clear();
+    FilterHandlesScalar(entries, filter, 0, indices);
+  });
+  const auto vectorized = Time([&]() {
+    indices.clear();
+    FilterHandles(entries, filter, indices);
+  });
+
+  std::printf(
+      "%zu entries, %zu matches: scalar %.2f ms, FilterHandles %.2f ms "
+      "(%.1fx)\n",
+      entry_count, indices.size(), scalar, vectorized, scalar / vectorized);
+
+  return 0;
+}
@@ -0,0 +1,436 @@
+// Checks the mpris client against a stub player on a private session bus: the
+// player is matched by the process that owns it, or else by its bus name, its
+// properties are read when it appears, a pushed PropertiesChanged or Seeked
+// signal updates them, and the player is forgotten when it leaves the bus.
+//
+// Usage: anisthesia-check-mpris
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <dbus/dbus.h>
+
+#include <anisthesia/linux_mpris.hpp>
+
+namespace {
+
+using namespace anisthesia;
+
+constexpr const char* kBusName = "org.mpris.MediaPlayer2.stub";
+constexpr const char* kObjectPath = "/org/mpris/MediaPlayer2";
+constexpr const char* kPlayerInterface = "org.mpris.MediaPlayer2.Player";
+constexpr const char* kPropertiesInterface = "org.freedesktop.DBus.Properties";
+
+// Signals are delivered asynchronously, so the client is polled until then
+constexpr auto kSignalTimeout = std::chrono::seconds(5);
+
+int failures = 0;
+
+void Expect(bool condition, const char* description) {
+  std::printf("%s: %s\n", condition ? "ok" : "FAILED", description);
+  if (!condition)
+    ++failures;
+}
+
+// Runs a bus of its own, so that the players of the session are not seen
+class Bus {
+public:
+  Bus() = default;
+  Bus(const Bus&) = delete;
+  ~Bus() { Stop(); }
+
+  Bus& operator=(const Bus&) = delete;
+
+  bool Start() {
+    int fds[2];
+    if (::pipe(fds) != 0)
+      return false;
+
+    pid_ = ::fork();
+    if (pid_ < 0) {
+      pid_ = 0;
+      ::close(fds[0]);
+      ::close(fds[1]);
+      return false;
+    }
+
+    if (pid_ == 0) {
+      ::close(fds[0]);
+      ::dup2(fds[1], STDOUT_FILENO);
+      ::execlp("dbus-daemon", "dbus-daemon", "--session", "--nofork",
+               "--print-address", nullptr);
+      ::_exit(127);
+    }
+
+    ::close(fds[1]);
+    std::string address;
+    char c = 0;
+    while (::read(fds[0], &c, 1) == 1 && c != '\n')
+      address += c;
+    ::close(fds[0]);
+
+    return !address.empty() &&
+           ::setenv("DBUS_SESSION_BUS_ADDRESS", address.c_str(), 1) == 0;
+  }
+
+  void Stop() {
+    if (!pid_)
+      return;
+    ::kill(pid_, SIGTERM);
+    ::waitpid(pid_, nullptr, 0);
+    pid_ = 0;
+  }
+
+private:
+  pid_t pid_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct StubState {
+  std::string status = "Playing";
+  std::string title;
+  std::string url;
+  int64_t length = 0;    // microseconds
+  int64_t position = 0;  // microseconds
+  double rate = 1.0;
+};
+
+void AppendEntry(DBusMessageIter* dict, const char* key, int type,
+                 const void* value) {
+  const char signature[] = {static_cast<char>(type), '\0'};
+  DBusMessageIter entry;
+  DBusMessageIter variant;
+  ::dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, nullptr,
+                                     &entry);
+  ::dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  ::dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, signature,
+                                     &variant);
+  ::dbus_message_iter_append_basic(&variant, type, value);
+  ::dbus_message_iter_close_container(&entry, &variant);
+  ::dbus_message_iter_close_container(dict, &entry);
+}
+
+void AppendMetadata(DBusMessageIter* dict, const StubState& state) {
+  const char* key = "Metadata";
+  const char* title = state.title.c_str();
+  const char* url = state.url.c_str();
+  DBusMessageIter entry;
+  DBusMessageIter variant;
+  DBusMessageIter metadata;
+  ::dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, nullptr,
+                                     &entry);
+  ::dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  ::dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, "a{sv}",
+                                     &variant);
+  ::dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, "{sv}",
+                                     &metadata);
+  AppendEntry(&metadata, "xesam:title", DBUS_TYPE_STRING, &title);
+  AppendEntry(&metadata, "xesam:url", DBUS_TYPE_STRING, &url);
+  AppendEntry(&metadata, "mpris:length", DBUS_TYPE_INT64, &state.length);
+  ::dbus_message_iter_close_container(&variant, &metadata);
+  ::dbus_message_iter_close_container(&entry, &variant);
+  ::dbus_message_iter_close_container(dict, &entry);
+}
+
+// PlaybackStatus and Metadata, and Position and Rate if `all` is set
+void AppendProperties(DBusMessageIter* iter, const StubState& state,
+                      bool all) {
+  const char* status = state.status.c_str();
+  DBusMessageIter dict;
+  ::dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+  AppendEntry(&dict, "PlaybackStatus", DBUS_TYPE_STRING, &status);
+  AppendMetadata(&dict, state);
+  if (all) {
+    AppendEntry(&dict, "Position", DBUS_TYPE_INT64, &state.position);
+    AppendEntry(&dict, "Rate", DBUS_TYPE_DOUBLE, &state.rate);
+  }
+  ::dbus_message_iter_close_container(iter, &dict);
+}
+
+// Answers the property calls of the client on a thread of its own, as the
+// client blocks on them while it is polled.
+class StubPlayer {
+public:
+  StubPlayer() = default;
+  StubPlayer(const StubPlayer&) = delete;
+  ~StubPlayer() { Stop(); }
+
+  StubPlayer& operator=(const StubPlayer&) = delete;
+
+  bool Start(const StubState& state) {
+    state_ = state;
+
+    DBusError error;
+    ::dbus_error_init(&error);
+    connection_ = ::dbus_bus_get_private(DBUS_BUS_SESSION, &error);
+    const bool owned =
+        connection_ &&
+        ::dbus_bus_request_name(connection_, kBusName,
+                                DBUS_NAME_FLAG_DO_NOT_QUEUE, &error) ==
+            DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER;
+    ::dbus_error_free(&error);
+    if (!owned) {
+      Stop();
+      return false;
+    }
+    ::dbus_connection_set_exit_on_disconnect(connection_, false);
+
+    thread_ = std::jthread([this](std::stop_token stop_token) {
+      while (!stop_token.stop_requested() &&
+             ::dbus_connection_read_write(connection_, 50)) {
+        while (DBusMessage* message =
+                   ::dbus_connection_pop_message(connection_)) {
+          HandleMessage(message);
+          ::dbus_message_unref(message);
+        }
+      }
+    });
+    return true;
+  }
+
+  // Leaves the bus, as a player that exits would
+  void Stop() {
+    if (thread_.joinable()) {
+      thread_.request_stop();
+      thread_.join();
+    }
+    if (connection_) {
+      ::dbus_connection_close(connection_);
+      ::dbus_connection_unref(connection_);
+      connection_ = nullptr;
+    }
+  }
+
+  // Changes the state, and signals PlaybackStatus and Metadata
+  void Change(const std::function<void(StubState&)>& change) {
+    DBusMessage* signal = ::dbus_message_new_signal(
+        kObjectPath, kPropertiesInterface, "PropertiesChanged");
+    DBusMessageIter iter;
+    DBusMessageIter invalidated;
+    ::dbus_message_iter_init_append(signal, &iter);
+    ::dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING,
+                                     &kPlayerInterface);
+    {
+      std::lock_guard lock(mutex_);
+      change(state_);
+      AppendProperties(&iter, state_, false);
+    }
+    ::dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "s",
+                                       &invalidated);
+    ::dbus_message_iter_close_container(&iter, &invalidated);
+    Send(signal);
+  }
+
+  void Seek(int64_t position) {
+    {
+      std::lock_guard lock(mutex_);
+      state_.position = position;
+    }
+    DBusMessage* signal =
+        ::dbus_message_new_signal(kObjectPath, kPlayerInterface, "Seeked");
+    ::dbus_message_append_args(signal, DBUS_TYPE_INT64, &position,
+                               DBUS_TYPE_INVALID);
+    Send(signal);
+  }
+
+private:
+  void Send(DBusMessage* message) {
+    ::dbus_connection_send(connection_, message, nullptr);
+    ::dbus_connection_flush(connection_);
+    ::dbus_message_unref(message);
+  }
+
+  void HandleMessage(DBusMessage* message) {
+    if (::dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+      return;
+
+    const char* interface = nullptr;
+    const char* property = nullptr;
+    DBusMessage* reply = nullptr;
+
+    if (::dbus_message_is_method_call(message, kPropertiesInterface,
+                                      "GetAll") &&
+        ::dbus_message_get_args(message, nullptr, DBUS_TYPE_STRING,
+                                &interface, DBUS_TYPE_INVALID) &&
+        std::string_view{interface} == kPlayerInterface) {
+      reply = ::dbus_message_new_method_return(message);
+      DBusMessageIter iter;
+      ::dbus_message_iter_init_append(reply, &iter);
+      std::lock_guard lock(mutex_);
+      AppendProperties(&iter, state_, true);
+
+    } else if (::dbus_message_is_method_call(message, kPropertiesInterface,
+                                             "Get") &&
+               ::dbus_message_get_args(message, nullptr, DBUS_TYPE_STRING,
+                                       &interface, DBUS_TYPE_STRING,
+                                       &property, DBUS_TYPE_INVALID) &&
+               std::string_view{interface} == kPlayerInterface &&
+               std::string_view{property} == "Position") {
+      reply = ::dbus_message_new_method_return(message);
+      DBusMessageIter iter;
+      DBusMessageIter variant;
+      ::dbus_message_iter_init_append(reply, &iter);
+      ::dbus_message_iter_open_container(&iter, DBUS_TYPE_VARIANT, "x",
+                                         &variant);
+      {
+        std::lock_guard lock(mutex_);
+        ::dbus_message_iter_append_basic(&variant, DBUS_TYPE_INT64,
+                                         &state_.position);
+      }
+      ::dbus_message_iter_close_container(&iter, &variant);
+
+    } else {
+      reply = ::dbus_message_new_error(message, DBUS_ERROR_UNKNOWN_METHOD,
+                                       "Not implemented by the stub");
+    }
+
+    Send(reply);
+  }
+
+  DBusConnection* connection_ = nullptr;
+  std::jthread thread_;
+  std::mutex mutex_;
+  StubState state_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::vector<MediaSession> GetSessions(lin::detail::MprisClient& client,
+                                      const Process& process) {
+  std::vector<MediaSession> sessions;
+  client.EnumerateMediaSessions(process,
+                                [&sessions](const MediaSession& session) {
+                                  sessions.push_back(session);
+                                  return true;
+                                });
+  return sessions;
+}
+
+bool WaitForSessions(
+    lin::detail::MprisClient& client, const Process& process,
+    const std::function<bool(const std::vector<MediaSession>&)>& condition) {
+  const auto deadline = std::chrono::steady_clock::now() + kSignalTimeout;
+  while (!condition(GetSessions(client, process))) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
+bool HasTitle(const std::vector<MediaSession>& sessions, const char* title) {
+  return sessions.size() == 1 && sessions.front().title == title;
+}
+
+void CheckPlayer() {
+  using std::chrono::seconds;
+
+  StubState state;
+  state.status = "Paused";  // so that positions are not extrapolated
+  state.title = "Show - 01";
+  state.url = "file:///videos/Show%20-%2001.mkv";
+  state.length = 1440'000'000;
+  state.position = 10'000'000;
+
+  StubPlayer stub;
+  if (!stub.Start(state)) {
+    Expect(false, "stub player owns its bus name");
+    return;
+  }
+
+  lin::detail::MprisClient client;
+  const Process owner{static_cast<process_id_t>(::getpid()), "check"};
+  const Process sandboxed{1, "stub"};
+  const Process other{1, "other"};
+
+  auto sessions = GetSessions(client, owner);
+  Expect(sessions.size() == 1,
+         "player is matched by the process that owns it");
+  Expect(sessions.size() == 1 && sessions.front().title == "Show - 01" &&
+             sessions.front().url == state.url &&
+             sessions.front().state == MediaState::Paused &&
+             sessions.front().duration == seconds(1440) &&
+             sessions.front().position == seconds(10) &&
+             sessions.front().rate == 1.0,
+         "properties are read when the player appears");
+  Expect(HasTitle(GetSessions(client, sandboxed), "Show - 01"),
+         "player is matched by its bus name otherwise");
+  Expect(GetSessions(client, other).empty(),
+         "player is not matched by another process");
+
+  stub.Change([](StubState& state) {
+    state.title = "Show - 02";
+    state.position = 0;
+  });
+  Expect(WaitForSessions(client, owner,
+                         [](const std::vector<MediaSession>& sessions) {
+                           return HasTitle(sessions, "Show - 02") &&
+                                  sessions.front().position ==
+                                      media_time_t::zero();
+                         }),
+         "pushed metadata is read, along with the position");
+
+  stub.Seek(600'000'000);
+  Expect(WaitForSessions(client, owner,
+                         [](const std::vector<MediaSession>& sessions) {
+                           return sessions.size() == 1 &&
+                                  sessions.front().position == seconds(600);
+                         }),
+         "seeked position is read from the signal");
+
+  stub.Change([](StubState& state) { state.status = "Playing"; });
+  Expect(WaitForSessions(client, owner,
+                         [](const std::vector<MediaSession>& sessions) {
+                           return sessions.size() == 1 &&
+                                  sessions.front().state ==
+                                      MediaState::Playing;
+                         }),
+         "pushed playback status is read");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  sessions = GetSessions(client, owner);
+  Expect(sessions.size() == 1 && sessions.front().position > seconds(600),
+         "position of a playing player is extrapolated");
+
+  stub.Stop();
+  Expect(WaitForSessions(client, owner,
+                         [](const std::vector<MediaSession>& sessions) {
+                           return sessions.empty();
+                         }) &&
+             GetSessions(client, sandboxed).empty(),
+         "player that leaves the bus is forgotten");
+}
+
+}  // namespace
+
+int main() {
+  Bus bus;
+  if (!bus.Start()) {
+    std::fprintf(stderr, "Could not start dbus-daemon\n");
+    return 1;
+  }
+
+  CheckPlayer();
+
+  bus.Stop();
+
+  if (failures) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,278 @@
+// Checks what Detector::Poll reports between consecutive polls of a fake
+// platform: every result appears on the first poll, an unchanged poll is empty
+// and applies no strategies, a changed title is reported as changed, a closed
+// window disappears, and a window whose strategy timed out is detected again.
+// Media that is read from the player (i.e. mpris) changes when it is seeked,
+// paused, or played at another rate, but not as it merely plays on.
+//
+// Usage: anisthesia-check-poll
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <latch>
+#include <memory>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <anisthesia.hpp>
+#include <anisthesia/fake_platform.hpp>
+
+namespace {
+
+using namespace anisthesia;
+
+constexpr strategy_timeout_t kTimeout{50};
+constexpr auto kDelay = std::chrono::milliseconds(300);
+
+int failures = 0;
+
+void Expect(bool condition, const char* description) {
+  std::printf("%s: %s\n", condition ? "ok" : "FAILED", description);
+  if (!condition)
+    ++failures;
+}
+
+bool HasInformation(const std::vector<Media>& media, MediaInfoType type,
+                    const char* value) {
+  return media.size() == 1 && media.front().information.size() == 1 &&
+         media.front().information.front().type == type &&
+         media.front().information.front().value == value;
+}
+
+// Fake platform whose first call for open files takes longer than the time
+// budget of a strategy, without regard to stop requests.
+class DelayingPlatform final : public Platform {
+public:
+  FakePlatform& fake() { return fake_; }
+  std::latch& returned() { return returned_; }
+  int open_file_calls() const { return open_file_calls_.load(); }
+
+  bool EnumerateProcesses(process_proc_t process_proc) override {
+    return fake_.EnumerateProcesses(std::move(process_proc));
+  }
+
+  bool EnumerateWindows(window_proc_t window_proc) override {
+    return fake_.EnumerateWindows(std::move(window_proc));
+  }
+
+  bool EnumerateOpenFiles(const std::set<process_id_t>& process_ids,
+                          open_file_proc_t open_file_proc,
+                          const OpenFileFilter& filter,
+                          std::stop_token stop_token = {}) override {
+    if (open_file_calls_++ == 0) {
+      std::this_thread::sleep_for(kDelay);
+      const bool result = fake_.EnumerateOpenFiles(
+          process_ids, std::move(open_file_proc), filter, stop_token);
+      returned_.count_down();
+      return result;
+    }
+    return fake_.EnumerateOpenFiles(process_ids, std::move(open_file_proc),
+                                    filter, stop_token);
+  }
+
+  bool GetWebBrowserInformation(const Window& window,
+                                web_browser_proc_t web_browser_proc,
+                                std::stop_token stop_token = {}) override {
+    return fake_.GetWebBrowserInformation(window, std::move(web_browser_proc),
+                                          stop_token);
+  }
+
+private:
+  FakePlatform fake_;
+  std::latch returned_{1};
+  std::atomic<int> open_file_calls_ = 0;
+};
+
+// Windows are replaced as a whole, as they would be between two enumerations
+void SetWindows(FakePlatform& fake, const char* title, bool slow_window) {
+  fake.Clear();
+  fake.AddProcess({100, "titled"});
+  fake.AddProcess({200, "slow"});
+  fake.AddWindow(100, {1, "titled", title});
+  if (slow_window)
+    fake.AddWindow(200, {2, "slow", "Slow"});
+  fake.AddOpenFile({200, "/videos/Slow.mkv"});
+}
+
+std::vector<Player> GetPlayers() {
+  std::vector<Player> players(2);
+  players[0].name = "Titled";
+  players[0].window_title_format = "^(.+) - Titled$";
+  players[0].windows = {"titled"};
+  players[0].executables = {"titled"};
+  players[0].strategies = {Strategy::WindowTitle};
+  players[1].name = "Slow";
+  players[1].windows = {"slow"};
+  players[1].executables = {"slow"};
+  players[1].strategies = {Strategy::OpenFiles};
+  return players;
+}
+
+void CheckWindows() {
+  std::printf("Windows\n");
+
+  auto platform = std::make_shared<DelayingPlatform>();
+  auto& fake = platform->fake();
+  SetWindows(fake, "Show - 01 - Titled", true);
+
+  DetectorOptions options;
+  options.worker_count = 1;
+  options.strategy_timeout = kTimeout;
+  const auto media_proc = [](const MediaInfo&) { return true; };
+
+  {
+    Detector detector(platform, PlayerTable(GetPlayers()), options);
+    ChangeSet changes;
+
+    Expect(detector.Poll(media_proc, changes) &&
+               changes.appeared.size() == 2 && changes.changed.empty() &&
+               changes.disappeared.empty(),
+           "every result appears on the first poll");
+    Expect(changes.appeared.size() == 2 &&
+               changes.appeared[1].strategies.size() == 1 &&
+               changes.appeared[1].strategies.front().status ==
+                   StrategyStatus::TimedOut,
+           "slow strategy times out on the first poll");
+
+    Expect(detector.Poll(media_proc, changes) && changes.appeared.empty() &&
+               changes.disappeared.empty() && changes.changed.size() == 1 &&
+               changes.changed.front().result.player.name == "Slow" &&
+               HasInformation(changes.changed.front().added,
+                              MediaInfoType::File, "/videos/Slow.mkv") &&
+               changes.changed.front().removed.empty(),
+           "window whose strategy timed out is detected again");
+    Expect(platform->open_file_calls() == 2,
+           "open files are read again after the timeout");
+
+    Expect(detector.Poll(media_proc, changes) && changes.empty(),
+           "unchanged poll is empty");
+    Expect(platform->open_file_calls() == 2,
+           "strategies are not applied to unchanged windows");
+
+    SetWindows(fake, "Show - 02 - Titled", true);
+    Expect(detector.Poll(media_proc, changes) && changes.appeared.empty() &&
+               changes.disappeared.empty() && changes.changed.size() == 1 &&
+               changes.changed.front().result.player.name == "Titled" &&
+               HasInformation(changes.changed.front().added,
+                              MediaInfoType::Unknown, "Show - 02") &&
+               HasInformation(changes.changed.front().removed,
+                              MediaInfoType::Unknown, "Show - 01"),
+           "title change is reported as changed");
+
+    SetWindows(fake, "Show - 02 - Titled", false);
+    Expect(detector.Poll(media_proc, changes) && changes.appeared.empty() &&
+               changes.changed.empty() && changes.disappeared.size() == 1 &&
+               changes.disappeared.front().player.name == "Slow" &&
+               HasInformation(changes.disappeared.front().media,
+                              MediaInfoType::File, "/videos/Slow.mkv"),
+           "closed window disappears as it was last reported");
+
+    detector.Reset();
+    Expect(detector.title_cache_stats().hits == 0 &&
+               detector.title_cache_stats().misses == 0,
+           "reset clears title cache statistics");
+    Expect(detector.Poll(media_proc, changes) &&
+               changes.appeared.size() == 1 && changes.changed.empty() &&
+               changes.disappeared.empty(),
+           "every result appears again after a reset");
+  }
+
+  platform->returned().wait();
+}
+
+void CheckLiveMedia() {
+  std::printf("Live media\n");
+
+  auto platform = std::make_shared<FakePlatform>();
+  platform->AddProcess({100, "live"});
+  platform->AddWindow(100, {1, "live", "Live"});
+
+  std::vector<Player> players(1);
+  players[0].name = "Live";
+  players[0].windows = {"live"};
+  players[0].executables = {"live"};
+  players[0].strategies = {Strategy::Mpris};
+
+  DetectorOptions options;
+  options.worker_count = 0;
+  Detector detector(platform, PlayerTable(players), options);
+  const auto media_proc = [](const MediaInfo&) { return true; };
+
+  using std::chrono::seconds;
+  MediaSession session;
+  session.state = MediaState::Playing;
+  session.duration = seconds(1440);
+  session.position = seconds(10);
+  session.title = "Show - 01";
+
+  auto poll = [&](const MediaSession& media_session, ChangeSet& changes) {
+    platform->SetMediaSessions(100, {media_session});
+    return detector.Poll(media_proc, changes);
+  };
+  auto is_change = [](const ChangeSet& changes, media_time_t from,
+                      media_time_t to) {
+    return changes.appeared.empty() && changes.disappeared.empty() &&
+           changes.changed.size() == 1 &&
+           changes.changed.front().added.size() == 1 &&
+           changes.changed.front().added.front().position == to &&
+           changes.changed.front().removed.size() == 1 &&
+           changes.changed.front().removed.front().position == from;
+  };
+
+  ChangeSet changes;
+  Expect(poll(session, changes) && changes.appeared.size() == 1,
+         "playing media appears");
+
+  // Further than the tolerance, which a position that stood still would miss
+  const auto start = std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  session.position += std::chrono::duration_cast<media_time_t>(
+      std::chrono::steady_clock::now() - start);
+  const auto position = session.position;
+  Expect(poll(session, changes) && changes.empty(),
+         "media that plays on is unchanged");
+
+  session.position = seconds(600);
+  Expect(poll(session, changes) && is_change(changes, position,
+                                             seconds(600)),
+         "seeked media is reported as changed");
+  Expect(poll(session, changes) && changes.empty(),
+         "seeked media is unchanged on the next poll");
+
+  session.state = MediaState::Paused;
+  Expect(poll(session, changes) && changes.changed.size() == 1,
+         "paused media is reported as changed");
+  Expect(poll(session, changes) && changes.empty(),
+         "paused media is unchanged on the next poll");
+
+  session.position = seconds(900);
+  Expect(poll(session, changes) && is_change(changes, seconds(600),
+                                             seconds(900)),
+         "media that is seeked while paused is reported as changed");
+
+  session.state = MediaState::Playing;
+  poll(session, changes);
+  session.rate = 2.0;
+  Expect(poll(session, changes) && changes.changed.size() == 1 &&
+             changes.changed.front().added.size() == 1 &&
+             changes.changed.front().added.front().rate == 2.0,
+         "media that is played at another rate is reported as changed");
+}
+
+}  // namespace
+
+int main() {
+  CheckWindows();
+  CheckLiveMedia();
+
+  if (failures) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,423 @@
+// Checks the regular expression engine against std::regex, on every pattern
+// and window title format of a players file. Inputs are generated by walking
+// the compiled program of each pattern, so that most of them match, and are
+// then mutated into near misses. Matches, searches and groups must agree.
+//
+// Loops that can match empty are checked as well. Only their matches and
+// searches are compared with std::regex, as captures in them follow ECMAScript
+// instead (see regex.hpp). Their captures are compared with those reported by
+// JavaScript engines.
+//
+// Usage: anisthesia-check-regex [--inputs <count>] [--seed <seed>] <file>
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <anisthesia/player.hpp>
+#include <anisthesia/regex.hpp>
+
+namespace {
+
+using namespace anisthesia;
+using regex::detail::Opcode;
+
+constexpr size_t kMaxInputSize = 256;  // std::regex recurses on the input
+constexpr size_t kMaxReports = 20;
+
+// Titles as players show them, which generated inputs might not resemble
+const char* const kSampleInputs[] = {
+    "",
+    "mpv",
+    "[Group] Show - 01 [1080p].mkv - mpv",
+    "Show - 01.mkv - VLC media player",
+    "Show - 01.mkv - MPC-HC",
+    "Show - 01 - Media Player Classic Home Cinema",
+    "Watch Show Episode 1 - Google Chrome",
+    "Show - 01 - Mozilla Firefox",
+    "C:\\Videos\\Show - 01.mkv",
+    "/home/user/Videos/Show - 01.mkv",
+};
+
+struct EmptyLoopCase {
+  const char* pattern;
+  const char* input;
+  std::vector<const char*> groups;  // as RegExp.prototype.exec reports them
+};
+
+const EmptyLoopCase kEmptyLoopCases[] = {
+    {"(a*)*b", "aab", {"aab", "aa"}},
+    {"(a*)*b", "ab", {"ab", "a"}},
+    {"(a*)*b", "b", {"b", ""}},
+    {"(a*)+$", "aa", {"aa", "aa"}},
+    {"(a*)+$", "", {"", ""}},
+    {"(a|)+b", "aab", {"aab", "a"}},
+    {"(a|)+b", "b", {"b", ""}},
+    {"(a*)?b", "aab", {"aab", "aa"}},
+    {"(a?)*?b", "aab", {"aab", "a"}},
+    {"((a)|b?)*c", "bac", {"bac", "a", "a"}},
+    {"((a)|b?)*c", "c", {"c", "", ""}},
+};
+
+template <typename T>
+bool ParseNumber(const std::string& str, T& value) {
+  const auto end = str.data() + str.size();
+  const auto [ptr, ec] = std::from_chars(str.data(), end, value);
+  return ec == std::errc{} && ptr == end;
+}
+
+std::string Escape(std::string_view str) {
+  std::string escaped;
+  for (const auto c : str) {
+    const auto u = static_cast<unsigned char>(c);
+    if (u < 0x20 || u >= 0x7F || c == '"' || c == '\\') {
+      char buffer[5];
+      std::snprintf(buffer, sizeof(buffer), "\\x%02X", u);
+      escaped += buffer;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Generator {
+public:
+  explicit Generator(uint32_t seed) : random_(seed) {}
+
+  // Follows a random path through the program. Paths that do not reach Match
+  // within the size limit are cut short.
+  std::string Walk(const regex::detail::Program& program) {
+    std::string str;
+    uint32_t pc = 0;
+    for (size_t steps = 0; steps < kMaxInputSize * 4; ++steps) {
+      const auto& instruction = program.instructions[pc];
+      switch (instruction.opcode) {
+        case Opcode::Byte:
+          str += static_cast<char>(instruction.byte);
+          break;
+        case Opcode::Any:
+          str += RandomByte([](uint8_t b) { return b != '\n' && b != '\r'; });
+          break;
+        case Opcode::Class: {
+          const auto& set = program.classes[instruction.x];
+          if (set.none())
+            return str;
+          str += RandomByte([&set](uint8_t b) { return set.test(b); });
+          break;
+        }
+        case Opcode::Split:
+          pc = Chance(2) ? instruction.x : instruction.y;
+          continue;
+        case Opcode::Jump:
+          pc = instruction.x;
+          continue;
+        case Opcode::Save:
+        case Opcode::AssertBegin:
+        case Opcode::AssertEnd:
+          break;
+        case Opcode::Match:
+          return str;
+      }
+      if (str.size() >= kMaxInputSize)
+        return str;
+      ++pc;
+    }
+    return str;
+  }
+
+  // Replaces, inserts, removes or swaps the case of a byte, or cuts the end
+  std::string Mutate(std::string str) {
+    const auto pos = str.empty() ? 0 : Index(str.size());
+    switch (Index(5)) {
+      case 0:
+        if (!str.empty())
+          str[pos] = RandomByte([](uint8_t) { return true; });
+        break;
+      case 1:
+        str.insert(str.begin() + pos, RandomPrintable());
+        break;
+      case 2:
+        if (!str.empty())
+          str.erase(pos, 1);
+        break;
+      case 3:
+        if (!str.empty())
+          str[pos] ^= 0x20;
+        break;
+      case 4:
+        str.resize(pos);
+        break;
+    }
+    return str;
+  }
+
+private:
+  bool Chance(size_t n) { return Index(n) == 0; }
+
+  size_t Index(size_t n) {
+    return std::uniform_int_distribution<size_t>(0, n - 1)(random_);
+  }
+
+  char RandomPrintable() { return static_cast<char>(0x20 + Index(0x5F)); }
+
+  // Mostly printable, as titles are
+  template <typename Predicate>
+  char RandomByte(Predicate predicate) {
+    for (int i = 0; i < 64; ++i) {
+      const auto b = static_cast<uint8_t>(Chance(8) ? Index(256)
+                                                    : 0x20 + Index(0x5F));
+      if (predicate(b))
+        return static_cast<char>(b);
+    }
+    for (size_t b = 0; b < 256; ++b) {
+      if (predicate(static_cast<uint8_t>(b)))
+        return static_cast<char>(b);
+    }
+    return '\0';
+  }
+
+  std::mt19937 random_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Checker {
+public:
+  bool Check(const std::string& pattern,
+             const std::vector<std::string>& inputs, bool check_groups = true);
+  bool Check(const EmptyLoopCase& test);
+
+  size_t inputs() const { return inputs_; }
+  size_t mismatches() const { return mismatches_; }
+
+private:
+  void Report(const std::string& pattern, const std::string& input,
+              const char* check, const std::string& expected,
+              const std::string& actual);
+
+  size_t inputs_ = 0;
+  size_t mismatches_ = 0;
+};
+
+bool Checker::Check(const std::string& pattern,
+                    const std::vector<std::string>& inputs,
+                    bool check_groups) {
+  std::regex expected_regex;
+  try {
+    expected_regex.assign(pattern);
+  } catch (const std::regex_error&) {
+    std::fprintf(stderr, "std::regex rejects pattern: %s\n",
+                 Escape(pattern).c_str());
+    return false;
+  }
+
+  const regex::Regex regex(pattern);
+  if (!regex.valid()) {
+    Report(pattern, "", "compile", "valid", "invalid");
+    return false;
+  }
+
+  const auto previous_mismatches = mismatches_;
+
+  for (const auto& input : inputs) {
+    bool expected_match = false;
+    bool expected_search = false;
+    std::smatch expected_groups;
+    try {
+      expected_match = std::regex_match(input, expected_groups, expected_regex);
+      expected_search = std::regex_search(input, expected_regex);
+    } catch (const std::regex_error&) {
+      continue;  // e.g. too complex for std::regex
+    }
+    ++inputs_;
+
+    auto to_string = [](bool value) -> std::string {
+      return value ? "true" : "false";
+    };
+
+    if (regex.Match(input) != expected_match) {
+      Report(pattern, input, "match", to_string(expected_match),
+             to_string(!expected_match));
+    }
+    if (regex.Search(input) != expected_search) {
+      Report(pattern, input, "search", to_string(expected_search),
+             to_string(!expected_search));
+    }
+
+    std::vector<std::string_view> groups;
+    if (regex.Match(input, groups) != expected_match) {
+      Report(pattern, input, "match with groups", to_string(expected_match),
+             to_string(!expected_match));
+      continue;
+    }
+    if (!expected_match || !check_groups)
+      continue;
+    if (groups.size() != expected_groups.size()) {
+      Report(pattern, input, "group count",
+             std::to_string(expected_groups.size()),
+             std::to_string(groups.size()));
+      continue;
+    }
+    for (size_t i = 0; i < groups.size(); ++i) {
+      // Groups that did not participate are empty
+      const auto expected = expected_groups[i].matched
+                                ? expected_groups[i].str()
+                                : std::string();
+      if (groups[i] != expected) {
+        Report(pattern, input, ("group " + std::to_string(i)).c_str(),
+               '"' + Escape(expected) + '"',
+               '"' + Escape(groups[i]) + '"');
+      }
+    }
+  }
+
+  return mismatches_ == previous_mismatches;
+}
+
+bool Checker::Check(const EmptyLoopCase& test) {
+  ++inputs_;
+
+  auto join = [](const auto& groups) {
+    std::string str;
+    for (const std::string_view group : groups) {
+      if (!str.empty())
+        str += ", ";
+      str += '"' + Escape(group) + '"';
+    }
+    return str;
+  };
+
+  const auto expected = join(test.groups);
+  std::vector<std::string_view> groups;
+  const auto actual = regex::Regex(test.pattern).Match(test.input, groups)
+                          ? join(groups)
+                          : std::string("no match");
+
+  if (actual == expected)
+    return true;
+
+  if (++mismatches_ <= kMaxReports) {
+    std::fprintf(stderr,
+                 "Mismatch in groups of an empty loop\n"
+                 "  pattern: %s\n"
+                 "  input: \"%s\"\n"
+                 "  ECMAScript: %s, regex::Regex: %s\n",
+                 test.pattern, Escape(test.input).c_str(), expected.c_str(),
+                 actual.c_str());
+  }
+  return false;
+}
+
+void Checker::Report(const std::string& pattern, const std::string& input,
+                     const char* check, const std::string& expected,
+                     const std::string& actual) {
+  if (++mismatches_ > kMaxReports)
+    return;
+  std::fprintf(stderr,
+               "Mismatch in %s\n"
+               "  pattern: %s\n"
+               "  input: \"%s\"\n"
+               "  std::regex: %s, regex::Regex: %s\n",
+               check, Escape(pattern).c_str(), Escape(input).c_str(),
+               expected.c_str(), actual.c_str());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  size_t input_count = 1000;
+  uint32_t seed = 1;
+  bool valid = true;
+  while (valid && args.size() > 2 && args.front().starts_with("--")) {
+    if (args[0] == "--inputs") {
+      valid = ParseNumber(args[1], input_count);
+    } else if (args[0] == "--seed") {
+      valid = ParseNumber(args[1], seed);
+    } else {
+      valid = false;
+    }
+    args.erase(args.begin(), args.begin() + 2);
+  }
+
+  if (!valid || args.size() != 1) {
+    std::fprintf(stderr,
+                 "Usage: %s [--inputs <count>] [--seed <seed>] <file>\n",
+                 argv[0]);
+    return 1;
+  }
+
+  std::vector<Player> players;
+  if (!ParsePlayersFile(args[0], players)) {
+    std::fprintf(stderr, "Could not read players file: %s\n", args[0].c_str());
+    return 1;
+  }
+
+  // Window and executable patterns are regular expressions only if they are
+  // anchored, while every window title format is one.
+  std::vector<std::string> patterns;
+  for (const auto& player : players) {
+    for (const auto* list : {&player.windows, &player.executables}) {
+      for (const auto& pattern : *list) {
+        if (!pattern.empty() && pattern.front() == '^')
+          patterns.push_back(pattern);
+      }
+    }
+    if (!player.window_title_format.empty())
+      patterns.push_back(player.window_title_format);
+  }
+
+  // Followed by those of empty loops, whose groups are checked separately
+  const auto file_pattern_count = patterns.size();
+  for (const auto& test : kEmptyLoopCases) {
+    if (patterns.empty() || patterns.back() != test.pattern)
+      patterns.push_back(test.pattern);
+  }
+
+  Generator generator(seed);
+  Checker checker;
+  size_t failed = 0;
+
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    const auto& pattern = patterns[i];
+    const bool check_groups = i < file_pattern_count;
+
+    regex::detail::Program program;
+    if (!regex::detail::Compile(pattern, program)) {
+      std::fprintf(stderr, "Could not compile pattern: %s\n",
+                   Escape(pattern).c_str());
+      ++failed;
+      continue;
+    }
+
+    std::vector<std::string> inputs(std::begin(kSampleInputs),
+                                    std::end(kSampleInputs));
+    while (inputs.size() < input_count) {
+      auto input = generator.Walk(program);
+      inputs.push_back(generator.Mutate(input));
+      inputs.push_back(std::move(input));
+    }
+
+    if (!checker.Check(pattern, inputs, check_groups))
+      ++failed;
+  }
+
+  for (const auto& test : kEmptyLoopCases) {
+    if (!checker.Check(test))
+      ++failed;
+  }
+
+  std::printf("%zu patterns, %zu inputs, %zu mismatches\n", patterns.size(),
+              checker.inputs(), checker.mismatches());
+
+  return failed ? 1 : 0;
+}
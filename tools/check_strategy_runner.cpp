@@ -0,0 +1,286 @@
+// Checks that a strategy which blocks past its time budget, without regard to
+// stop requests, is given up on: it is reported as TimedOut along with the
+// media it found before it blocked, and its thread is replaced, so that tasks
+// queued behind it still run. Checked both on StrategyRunner itself, and
+// through Detector on a platform whose open files block. Also checks the order
+// that measured strategies are tried in.
+//
+// Usage: anisthesia-check-strategy-runner
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <vector>
+
+#include <anisthesia.hpp>
+#include <anisthesia/fake_platform.hpp>
+#include <anisthesia/strategy.hpp>
+#include <anisthesia/thread_pool.hpp>
+
+namespace {
+
+using namespace anisthesia;
+
+constexpr strategy_timeout_t kTimeout{50};
+
+int failures = 0;
+
+void Expect(bool condition, const char* description) {
+  std::printf("%s: %s\n", condition ? "ok" : "FAILED", description);
+  if (!condition)
+    ++failures;
+}
+
+bool HasFile(const Media& media, const char* path) {
+  return media.information.size() == 1 &&
+         media.information.front().type == MediaInfoType::File &&
+         media.information.front().value == path;
+}
+
+// Blocks callers until it is opened, as a call into another process might
+class Gate {
+public:
+  void Pass() {
+    std::unique_lock lock(mutex_);
+    condition_.wait(lock, [this]() { return open_; });
+  }
+
+  void Open() {
+    {
+      std::lock_guard lock(mutex_);
+      open_ = true;
+    }
+    condition_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool open_ = false;
+};
+
+// Fake platform whose open files block for one process, after the first file
+// of that process has been reported.
+class BlockingPlatform final : public Platform {
+public:
+  explicit BlockingPlatform(process_id_t blocking_process_id)
+      : blocking_process_id_(blocking_process_id) {}
+
+  FakePlatform& fake() { return fake_; }
+  Gate& gate() { return gate_; }
+  std::latch& returned() { return returned_; }
+  int thread_count() const { return thread_count_.load(); }
+
+  bool EnumerateProcesses(process_proc_t process_proc) override {
+    return fake_.EnumerateProcesses(std::move(process_proc));
+  }
+
+  bool EnumerateWindows(window_proc_t window_proc) override {
+    return fake_.EnumerateWindows(std::move(window_proc));
+  }
+
+  bool EnumerateOpenFiles(const std::set<process_id_t>& process_ids,
+                          open_file_proc_t open_file_proc,
+                          const OpenFileFilter& filter,
+                          std::stop_token stop_token = {}) override {
+    if (!process_ids.count(blocking_process_id_)) {
+      return fake_.EnumerateOpenFiles(process_ids, std::move(open_file_proc),
+                                      filter, stop_token);
+    }
+
+    // The stop token is deliberately ignored while blocked
+    const bool result = fake_.EnumerateOpenFiles(
+        process_ids,
+        [this, &open_file_proc](const OpenFile& open_file) {
+          if (!open_file_proc(open_file))
+            return false;
+          gate_.Pass();
+          return true;
+        },
+        filter, stop_token);
+    returned_.count_down();
+    return result;
+  }
+
+  bool GetWebBrowserInformation(const Window& window,
+                                web_browser_proc_t web_browser_proc,
+                                std::stop_token stop_token = {}) override {
+    return fake_.GetWebBrowserInformation(window, std::move(web_browser_proc),
+                                          stop_token);
+  }
+
+  void InitializeThread() override { ++thread_count_; }
+
+private:
+  FakePlatform fake_;
+  const process_id_t blocking_process_id_;
+  Gate gate_;
+  std::latch returned_{1};
+  std::atomic<int> thread_count_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+void CheckStrategyRunner() {
+  std::printf("StrategyRunner\n");
+
+  std::atomic<int> thread_count = 0;
+  detail::ThreadPool thread_pool(1, [&thread_count]() { ++thread_count; });
+
+  Gate gate;
+  std::latch returned(1);
+  bool late_media_added = true;
+
+  std::vector<detail::StrategyOutcome> outcomes(2);
+  {
+    detail::StrategyRunner runner(
+        thread_pool, [](const MediaInfo&) { return true; }, kTimeout);
+
+    runner.Submit([&](detail::StrategyContext& context) {
+      context.AddMedia(MediaInfo{MediaInfoType::File, "/partial.mkv"});
+      gate.Pass();
+      late_media_added =
+          context.AddMedia(MediaInfo{MediaInfoType::File, "/late.mkv"});
+      returned.count_down();
+      return true;
+    });
+    // Queued behind the blocking task on the only thread of the pool
+    runner.Submit([](detail::StrategyContext& context) {
+      return context.AddMedia(MediaInfo{MediaInfoType::File, "/queued.mkv"});
+    });
+
+    size_t index = 0;
+    detail::StrategyOutcome outcome;
+    while (runner.WaitNext(index, outcome)) {
+      outcomes[index] = std::move(outcome);
+    }
+  }
+
+  Expect(outcomes[0].status == StrategyStatus::TimedOut,
+         "blocking task is reported as TimedOut");
+  Expect(outcomes[0].media.size() == 1 &&
+             HasFile(outcomes[0].media.front(), "/partial.mkv"),
+         "blocking task keeps the media it found before it blocked");
+  Expect(outcomes[0].cost >= kTimeout,
+         "blocking task is charged its whole budget");
+  Expect(outcomes[1].status == StrategyStatus::Found &&
+             outcomes[1].media.size() == 1,
+         "queued task runs on a replacement thread");
+  Expect(thread_count == 2, "thread pool has replaced the blocked thread");
+
+  gate.Open();
+  returned.wait();
+  Expect(!late_media_added, "media reported after the timeout is rejected");
+}
+
+void CheckDetector() {
+  std::printf("Detector\n");
+
+  auto platform = std::make_shared<BlockingPlatform>(100);
+  auto& fake = platform->fake();
+  fake.AddProcess({100, "blocking"});
+  fake.AddProcess({200, "quick"});
+  fake.AddWindow(100, {1, "blocking", "Blocking"});
+  fake.AddWindow(200, {2, "quick", "Quick"});
+  fake.AddOpenFile({100, "/partial.mkv"});
+  fake.AddOpenFile({100, "/late.mkv"});
+  fake.AddOpenFile({200, "/quick.mkv"});
+
+  std::vector<Player> players(2);
+  players[0].name = "Blocking";
+  players[0].windows = {"blocking"};
+  players[0].executables = {"blocking"};
+  players[0].strategies = {Strategy::OpenFiles};
+  players[1].name = "Quick";
+  players[1].windows = {"quick"};
+  players[1].executables = {"quick"};
+  players[1].strategies = {Strategy::OpenFiles};
+
+  DetectorOptions options;
+  options.worker_count = 1;
+  options.strategy_timeout = kTimeout;
+
+  std::vector<Result> results;
+  {
+    Detector detector(platform, PlayerTable(players), options);
+    detector.GetResults([](const MediaInfo&) { return true; }, results);
+  }
+
+  Expect(results.size() == 2, "both windows have a result");
+  if (results.size() == 2) {
+    const auto& blocking = results[0];
+    Expect(blocking.strategies.size() == 1 &&
+               blocking.strategies.front().status == StrategyStatus::TimedOut,
+           "blocking open_files is reported as TimedOut");
+    Expect(blocking.media.size() == 1 &&
+               HasFile(blocking.media.front(), "/partial.mkv"),
+           "blocking open_files keeps the file found before it blocked");
+
+    const auto& quick = results[1];
+    Expect(quick.strategies.size() == 1 &&
+               quick.strategies.front().status == StrategyStatus::Found &&
+               quick.media.size() == 1 &&
+               HasFile(quick.media.front(), "/quick.mkv"),
+           "open_files of the other window runs on a replacement thread");
+  }
+  Expect(platform->thread_count() == 2,
+         "worker pool has replaced the blocked thread");
+
+  platform->gate().Open();
+  platform->returned().wait();
+}
+
+void CheckStrategyStats() {
+  std::printf("StrategyStats\n");
+
+  using std::chrono::microseconds;
+  detail::StrategyStats stats;
+  const std::vector<Strategy> strategies{
+      Strategy::WindowTitle, Strategy::OpenFiles, Strategy::UiAutomation};
+
+  // Window titles are cheap but never have a file, and UI Automation is yet
+  // to be measured.
+  for (int i = 0; i < 4; ++i) {
+    stats.Record("Player", Strategy::WindowTitle, microseconds(10), false);
+    stats.Record("Player", Strategy::OpenFiles, microseconds(500), true);
+  }
+  auto sorted = strategies;
+  stats.Sort("Player", sorted);
+  Expect(sorted == std::vector<Strategy>{Strategy::UiAutomation,
+                                         Strategy::OpenFiles,
+                                         Strategy::WindowTitle},
+         "unmeasured first, then by expected cost of finding a file");
+
+  // Once open files stop finding anything, window titles are cheaper again
+  for (int i = 0; i < 20; ++i) {
+    stats.Record("Player", Strategy::OpenFiles, microseconds(500), false);
+  }
+  stats.Record("Player", Strategy::UiAutomation, microseconds(100), true);
+  sorted = strategies;
+  stats.Sort("Player", sorted);
+  Expect(sorted == std::vector<Strategy>{Strategy::UiAutomation,
+                                         Strategy::WindowTitle,
+                                         Strategy::OpenFiles},
+         "fruitless strategies are ordered by cost");
+}
+
+}  // namespace
+
+int main() {
+  CheckStrategyRunner();
+  CheckDetector();
+  CheckStrategyStats();
+
+  if (failures) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
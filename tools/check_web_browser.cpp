@@ -0,0 +1,366 @@
+// Checks how many element calls it takes to read a web browser window on a
+// fake platform, whose tree has a tab strip, a toolbar with the address bar and
+// a decoy edit control, a page, and panels. A read through the cache follows
+// the paths that the first walk found, at a fraction of the calls. Paths that
+// have shifted (e.g. as an infobar opens) fall back to a walk that finds the
+// same as a fresh one, and an element that a walk did not find is not walked
+// for again until a while later. Calls are printed for a larger tree as well.
+//
+// Usage: anisthesia-check-web-browser
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/element_tree.hpp>
+#include <anisthesia/fake_platform.hpp>
+
+namespace {
+
+using namespace anisthesia;
+using detail::ElementProperty;
+using detail::ElementType;
+using detail::MemoryElement;
+
+constexpr window_handle_t kWindow = 7;
+
+int failures = 0;
+
+void Expect(bool condition, const char* description) {
+  std::printf("%s: %s\n", condition ? "ok" : "FAILED", description);
+  if (!condition)
+    ++failures;
+}
+
+MemoryElement Node(ElementType type, std::string name,
+                   std::vector<MemoryElement> children = {}) {
+  MemoryElement element;
+  element.type = type;
+  element.name = std::move(name);
+  element.children = std::move(children);
+  return element;
+}
+
+struct TreeOptions {
+  size_t tabs = 12;
+  size_t decoys = 40;     // buttons of the toolbar, and panels of the window
+  bool tab_strip = true;  // or a window without tabs (e.g. a popup)
+  bool infobar = false;   // which shifts both paths
+  bool bookmarks = false; // which shifts the address bar only
+};
+
+MemoryElement CreateTree(const TreeOptions& options) {
+  auto address = Node(ElementType::Edit, "Address and search bar");
+  address.value = "https://example.com/watch?v=" + std::to_string(options.tabs);
+  address.properties = {
+    {ElementProperty::IsEnabled, true},
+    {ElementProperty::IsKeyboardFocusable, true},
+    {ElementProperty::IsValuePatternAvailable, true},
+    {ElementProperty::ValueIsReadOnly, false},
+  };
+  auto search = address;
+  search.value = "decoy";
+  search.properties[ElementProperty::IsEnabled] = false;
+
+  auto toolbar = Node(ElementType::Other, "Toolbar");
+  for (size_t i = 0; i < options.decoys; ++i) {
+    toolbar.children.push_back(Node(ElementType::Other, "Button",
+                                    {Node(ElementType::Other, "Icon"),
+                                     Node(ElementType::Other, "Label")}));
+  }
+  toolbar.children.push_back(std::move(search));
+  toolbar.children.push_back(std::move(address));
+
+  auto tab_strip = Node(ElementType::Tab, "Tab strip");
+  tab_strip.properties = {{ElementProperty::ValueIsReadOnly, true}};
+  for (size_t i = 0; i < options.tabs; ++i) {
+    tab_strip.children.push_back(
+        Node(ElementType::TabItem, "Tab " + std::to_string(i)));
+  }
+  tab_strip.children.push_back(Node(ElementType::Other, "New Tab"));
+
+  auto page = Node(ElementType::Document, "Page");
+  for (size_t i = 0; i < 200; ++i) {
+    page.children.push_back(Node(ElementType::Other, "Paragraph"));
+  }
+
+  auto client = Node(ElementType::Other, "");
+  if (options.infobar) {
+    client.children.push_back(Node(ElementType::Other, "Infobar",
+                                   {Node(ElementType::Other, "Close")}));
+  }
+  if (options.tab_strip) {
+    client.children.push_back(
+        Node(ElementType::Other, "Tabs", {std::move(tab_strip)}));
+  }
+  if (options.bookmarks) {
+    client.children.push_back(Node(ElementType::Other, "Bookmarks",
+                                   {Node(ElementType::Other, "Bookmark")}));
+  }
+  client.children.push_back(std::move(toolbar));
+  client.children.push_back(std::move(page));
+  for (size_t i = 0; i < options.decoys; ++i) {
+    client.children.push_back(
+        Node(ElementType::Other, "Panel",
+             {Node(ElementType::Other, "Pane",
+                   {Node(ElementType::Other, "Content")})}));
+  }
+
+  return Node(ElementType::Other, "Page - Web Browser",
+              {Node(ElementType::TitleBar, "Title bar",
+                    {Node(ElementType::Other, "Close")}),
+               std::move(client)});
+}
+
+// Requests a stop once the elements that are reached through it have been
+// called a number of times, as a poll that times out mid-walk would
+class StoppingElement final : public detail::Element {
+public:
+  StoppingElement(std::unique_ptr<detail::Element> element,
+                  std::stop_source& stop_source, uint64_t& remaining_calls)
+      : element_(std::move(element)), stop_source_(stop_source),
+        remaining_calls_(remaining_calls) {}
+
+  ElementType type() override {
+    Count();
+    return element_->type();
+  }
+
+  std::string name() override {
+    Count();
+    return element_->name();
+  }
+
+  std::string value() override {
+    Count();
+    return element_->value();
+  }
+
+  bool GetProperty(ElementProperty property, bool& value) override {
+    Count();
+    return element_->GetProperty(property, value);
+  }
+
+  std::unique_ptr<detail::Element> FirstChild() override {
+    Count();
+    return Wrap(element_->FirstChild());
+  }
+
+  std::unique_ptr<detail::Element> NextSibling() override {
+    Count();
+    return Wrap(element_->NextSibling());
+  }
+
+private:
+  void Count() {
+    if (remaining_calls_ && !--remaining_calls_)
+      stop_source_.request_stop();
+  }
+
+  std::unique_ptr<detail::Element> Wrap(
+      std::unique_ptr<detail::Element> element) {
+    if (!element)
+      return nullptr;
+    return std::make_unique<StoppingElement>(std::move(element), stop_source_,
+                                             remaining_calls_);
+  }
+
+  std::unique_ptr<detail::Element> element_;
+  std::stop_source& stop_source_;
+  uint64_t& remaining_calls_;
+};
+
+struct Information {
+  std::string address;
+  std::vector<std::string> tabs;
+
+  bool operator==(const Information&) const = default;
+};
+
+class Browser {
+public:
+  void SetTree(const TreeOptions& options) {
+    platform_.SetWebBrowserTree(kWindow, CreateTree(options));
+  }
+
+  Information Read() {
+    Information information;
+    const auto calls = platform_.element_calls();
+    platform_.GetWebBrowserInformation(
+        window_, [&information](const WebBrowserInformation& item) {
+          if (item.type == WebBrowserInformationType::Address)
+            information.address = item.value;
+          if (item.type == WebBrowserInformationType::Tab)
+            information.tabs.push_back(item.value);
+        });
+    calls_ = platform_.element_calls() - calls;
+    return information;
+  }
+
+  // Of the last read
+  uint64_t calls() const { return calls_; }
+
+private:
+  FakePlatform platform_;
+  Window window_{kWindow, "Chrome_WidgetWin_1", "Page - Web Browser"};
+  uint64_t calls_ = 0;
+};
+
+Information ReadFresh(const TreeOptions& options) {
+  Browser browser;
+  browser.SetTree(options);
+  return browser.Read();
+}
+
+void CheckCache() {
+  std::printf("Cache\n");
+
+  Browser browser;
+  TreeOptions options;
+  browser.SetTree(options);
+
+  const auto walked = browser.Read();
+  const auto walk_calls = browser.calls();
+  Expect(walked.address == "https://example.com/watch?v=12" &&
+             walked.tabs.size() == 12,
+         "walk finds the address bar and the tabs");
+
+  const auto cached = browser.Read();
+  const auto cached_calls = browser.calls();
+  Expect(cached == walked, "cached read finds the same");
+  Expect(cached_calls * 4 < walk_calls,
+         "cached read takes a fraction of the calls of a walk");
+
+  // An infobar shifts every path by one
+  options.infobar = true;
+  options.tabs = 13;
+  browser.SetTree(options);
+  const auto shifted = browser.Read();
+  const auto shifted_calls = browser.calls();
+  Expect(shifted == ReadFresh(options),
+         "shifted paths fall back to a walk that finds the same");
+  const auto reread = browser.Read();
+  const auto reread_calls = browser.calls();
+  Expect(reread == shifted && reread_calls * 4 < walk_calls,
+         "paths that the fallback found are read from the cache");
+
+  // A bookmarks bar shifts the address bar, but not the tab strip
+  options.bookmarks = true;
+  browser.SetTree(options);
+  const auto partial = browser.Read();
+  const auto partial_calls = browser.calls();
+  Expect(partial == ReadFresh(options),
+         "walk for the address bar alone finds the same");
+
+  std::printf("Calls: walk %llu, cached %llu, shifted %llu then %llu, "
+              "address bar shifted %llu\n",
+              static_cast<unsigned long long>(walk_calls),
+              static_cast<unsigned long long>(cached_calls),
+              static_cast<unsigned long long>(shifted_calls),
+              static_cast<unsigned long long>(reread_calls),
+              static_cast<unsigned long long>(partial_calls));
+}
+
+void CheckMissingElements() {
+  std::printf("Missing elements\n");
+
+  Browser browser;
+  TreeOptions options;
+  options.tab_strip = false;
+  browser.SetTree(options);
+
+  const auto walked = browser.Read();
+  const auto walk_calls = browser.calls();
+  Expect(!walked.address.empty() && walked.tabs.empty(),
+         "walk of a window without tabs finds the address bar");
+  const auto cached = browser.Read();
+  Expect(cached == walked && browser.calls() * 4 < walk_calls,
+         "tabs that the walk did not find are not walked for again");
+
+  // The time of the walk is moved back, rather than waited for
+  const auto tree = CreateTree(options);
+  const auto root = detail::CreateMemoryElement(tree);
+  detail::WebBrowserElementPaths paths;
+  std::string address;
+  std::vector<std::string> tabs;
+  detail::FindWebBrowserElements(*root, paths, address, tabs);
+
+  options.tab_strip = true;
+  const auto tabbed_tree = CreateTree(options);
+  const auto tabbed_root = detail::CreateMemoryElement(tabbed_tree);
+  detail::FindWebBrowserElements(*tabbed_root, paths, address, tabs);
+  Expect(tabs.empty() && paths.tabs.empty(),
+         "tabs that appear are not looked for before the interval");
+
+  paths.walked -= detail::kElementWalkInterval;
+  tabs.clear();
+  detail::FindWebBrowserElements(*tabbed_root, paths, address, tabs);
+  Expect(tabs.size() == 12 && !paths.tabs.empty(),
+         "tabs that appear are found after the interval");
+
+  // Paths are kept as they were, rather than taken as wrong
+  const auto found = paths;
+  std::stop_source stop_source;
+  stop_source.request_stop();
+  tabs.clear();
+  Expect(!detail::FindWebBrowserElements(*tabbed_root, paths, address, tabs,
+                                         stop_source.get_token()) &&
+             paths.address == found.address && paths.tabs == found.tabs &&
+             paths.walked == found.walked,
+         "stopped read leaves the paths as they were");
+
+  // Elements that a stopped walk did not reach are not taken as missing
+  paths = {};
+  address.clear();
+  tabs.clear();
+  std::stop_source walk_stop_source;
+  uint64_t remaining_calls = 20;
+  StoppingElement stopping_root(detail::CreateMemoryElement(tabbed_tree),
+                                walk_stop_source, remaining_calls);
+  detail::FindWebBrowserElements(stopping_root, paths, address, tabs,
+                                 walk_stop_source.get_token());
+  address.clear();
+  tabs.clear();
+  detail::FindWebBrowserElements(*tabbed_root, paths, address, tabs);
+  Expect(!address.empty() && tabs.size() == 12,
+         "elements are walked for again after a stopped walk");
+}
+
+// Calls of a walk and of a cached read, on a larger tree
+void MeasureCalls() {
+  Browser browser;
+  TreeOptions options;
+  options.tabs = 30;
+  options.decoys = 200;
+  browser.SetTree(options);
+
+  browser.Read();
+  const auto walk_calls = browser.calls();
+  browser.Read();
+  const auto cached_calls = browser.calls();
+
+  std::printf("%zu tabs, %zu decoys: walk %llu calls, cached %llu calls\n",
+              options.tabs, options.decoys,
+              static_cast<unsigned long long>(walk_calls),
+              static_cast<unsigned long long>(cached_calls));
+}
+
+}  // namespace
+
+int main() {
+  CheckCache();
+  CheckMissingElements();
+  MeasureCalls();
+
+  if (failures) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,173 @@
+// Compiles a players file into a binary snapshot that can be memory-mapped
+// with anisthesia::Snapshot, or into a C++ header of constexpr tables that is
+// used for built-in players.
+//
+// Usage: anisthesia-compile [--header] <input.anisthesia> <output>
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <anisthesia/player.hpp>
+#include <anisthesia/snapshot.hpp>
+#include <anisthesia/util.hpp>
+
+namespace {
+
+std::string ToLowerAscii(std::string str) {
+  for (auto& c : str) {
+    if ('A' <= c && c <= 'Z')
+      c += 'a' - 'A';
+  }
+  return str;
+}
+
+std::string ToStringLiteral(const std::string& str) {
+  std::string literal = "\"";
+  for (const auto c : str) {
+    const auto u = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      literal += '\\';
+      literal += c;
+    } else if (u < 0x20 || u >= 0x7F) {
+      // Octal escapes have a fixed length, unlike hexadecimal ones, so they
+      // cannot swallow the characters that follow.
+      char buffer[5];
+      std::snprintf(buffer, sizeof(buffer), "\\%03o", u);
+      literal += buffer;
+    } else {
+      literal += c;
+    }
+  }
+  return literal + "\"sv";
+}
+
+std::string GetPatternArray(const std::string& name,
+                            const std::vector<std::string>& patterns,
+                            std::string& output) {
+  if (patterns.empty())
+    return "{}";
+
+  output += "inline constexpr std::string_view " + name + "[] = {";
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    // Regular expressions must be kept as is, while literals are matched
+    // case-insensitively.
+    const auto& pattern = patterns[i];
+    output += i ? ", " : "";
+    output += ToStringLiteral(
+        !pattern.empty() && pattern.front() == '^' ? pattern
+                                                   : ToLowerAscii(pattern));
+  }
+  output += "};\n";
+
+  return name;
+}
+
+std::string GetPlayerType(anisthesia::PlayerType type) {
+  switch (type) {
+    default:
+    case anisthesia::PlayerType::Default:
+      return "PlayerType::Default";
+    case anisthesia::PlayerType::WebBrowser:
+      return "PlayerType::WebBrowser";
+  }
+}
+
+std::string GenerateHeader(const std::vector<anisthesia::Player>& players) {
+  std::string output =
+      "// Generated by anisthesia-compile. Do not edit.\n"
+      "\n"
+      "#pragma once\n"
+      "\n"
+      "#include <string_view>\n"
+      "\n"
+      "#include <anisthesia/builtin.hpp>\n"
+      "\n"
+      "namespace anisthesia::detail::builtin {\n"
+      "\n"
+      "using namespace std::string_view_literals;\n"
+      "\n";
+
+  std::string records;
+
+  for (size_t i = 0; i < players.size(); ++i) {
+    const auto& player = players[i];
+    const auto index = std::to_string(i);
+
+    const auto windows =
+        GetPatternArray("kWindows" + index, player.windows, output);
+    const auto executables =
+        GetPatternArray("kExecutables" + index, player.executables, output);
+    const auto extensions =
+        GetPatternArray("kExtensions" + index, player.extensions, output);
+
+    anisthesia::strategy_mask_t strategies = 0;
+    for (const auto strategy : player.strategies) {
+      strategies |= anisthesia::GetStrategyMask(strategy);
+    }
+
+    anisthesia::player_option_mask_t options = 0;
+    for (const auto option : player.options) {
+      options |= anisthesia::GetPlayerOptionMask(option);
+    }
+
+    records += "  {" + GetPlayerType(player.type) + ", " +
+               ToStringLiteral(player.name) + ", " +
+               ToStringLiteral(player.window_title_format) + ", " +
+               windows + ", " + executables + ", " +
+               std::to_string(strategies) + ", " +
+               std::to_string(options) + ", " + extensions + "},\n";
+  }
+
+  output += "\n"
+            "inline constexpr BuiltinPlayer kPlayers[] = {\n" +
+            records +
+            "};\n"
+            "\n"
+            "}  // namespace anisthesia::detail::builtin\n";
+
+  return output;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  bool header = false;
+  if (!args.empty() && args.front() == "--header") {
+    header = true;
+    args.erase(args.begin());
+  }
+
+  if (args.size() != 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--header] <input.anisthesia> <output>\n";
+    return 1;
+  }
+
+  const auto& input_path = args[0];
+  const auto& output_path = args[1];
+
+  std::vector<anisthesia::Player> players;
+  if (!anisthesia::ParsePlayersFile(input_path, players)) {
+    std::cerr << "Could not parse players file: " << input_path << '\n';
+    return 1;
+  }
+
+  std::string data;
+  if (header) {
+    data = GenerateHeader(players);
+  } else if (!anisthesia::CompileSnapshot(players, data)) {
+    std::cerr << "Could not compile snapshot\n";
+    return 1;
+  }
+
+  if (!anisthesia::detail::util::WriteFile(output_path, data)) {
+    std::cerr << "Could not write output file: " << output_path << '\n';
+    return 1;
+  }
+
+  return 0;
+}
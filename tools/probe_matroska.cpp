@@ -0,0 +1,372 @@
+// Reads the information of Matroska files, and reports what it took to read
+// each of them, so that changes to the reader can be measured on real files.
+//
+// With --check, generates files of an increasing number of clusters instead:
+// indexed ones, whose index may point to another at the end, unindexed ones,
+// and ones that are cut short. Each is read both from memory and from a file,
+// and indexed files must take the same views and reads however many clusters
+// they have.
+//
+// Usage: anisthesia-probe-matroska [--mmap | --pread] <file>...
+//        anisthesia-probe-matroska --check
+
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <anisthesia/matroska.hpp>
+
+namespace {
+
+using namespace anisthesia::matroska;
+
+enum class SourceType {
+  Mapped,
+  File,
+};
+
+std::unique_ptr<detail::ByteSource> OpenSource(SourceType type,
+                                               const std::string& path) {
+  switch (type) {
+    case SourceType::Mapped: {
+      auto source = std::make_unique<detail::MappedFileSource>();
+      if (!source->Open(path))
+        return nullptr;
+      return source;
+    }
+    case SourceType::File: {
+      auto source = std::make_unique<detail::FileSource>();
+      if (!source->Open(path))
+        return nullptr;
+      return source;
+    }
+  }
+  return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+using bytes_t = std::vector<uint8_t>;
+
+constexpr size_t kClusterSize = 0x4000;
+// Files are larger than two blocks of a FileSource even with the fewest
+constexpr size_t kClusterCounts[] = {16, 64, 256};
+
+int failures = 0;
+
+void Expect(bool condition, const std::string& description) {
+  std::printf("%s: %s\n", condition ? "ok" : "FAILED", description.c_str());
+  if (!condition)
+    ++failures;
+}
+
+void Append(bytes_t& data, const bytes_t& more) {
+  data.insert(data.end(), more.begin(), more.end());
+}
+
+void AppendBigEndian(bytes_t& data, uint64_t value, size_t size) {
+  for (size_t i = size; i-- > 0;) {
+    data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+  }
+}
+
+// Sizes take 8 bytes, so that the size of an element does not depend on the
+// values it holds (e.g. the positions of an index).
+bytes_t Element(uint32_t id, const bytes_t& payload) {
+  // IDs have their length marker in their first byte
+  size_t id_size = 1;
+  while (id_size < 4 && (id >> (id_size * 8)))
+    ++id_size;
+
+  bytes_t data;
+  AppendBigEndian(data, id, id_size);
+  data.push_back(0x01);
+  AppendBigEndian(data, payload.size(), 7);
+  Append(data, payload);
+  return data;
+}
+
+bytes_t UIntElement(uint32_t id, uint64_t value) {
+  bytes_t payload;
+  AppendBigEndian(payload, value, 8);
+  return Element(id, payload);
+}
+
+bytes_t FloatElement(uint32_t id, double value) {
+  bytes_t payload;
+  AppendBigEndian(payload, std::bit_cast<uint64_t>(value), 8);
+  return Element(id, payload);
+}
+
+bytes_t StringElement(uint32_t id, const std::string& value) {
+  return Element(id, bytes_t(value.begin(), value.end()));
+}
+
+bytes_t SeekHead(std::initializer_list<std::pair<uint32_t, uint64_t>> seeks) {
+  bytes_t payload;
+  for (const auto& [id, position] : seeks) {
+    bytes_t seek = UIntElement(detail::kSeekID, id);
+    Append(seek, UIntElement(detail::kSeekPosition, position));
+    Append(payload, Element(detail::kSeek, seek));
+  }
+  return Element(detail::kSeekHead, payload);
+}
+
+enum class Layout {
+  Indexed,        // the index at the start points to the information at the end
+  NestedIndex,    // which it does through another index at the end
+  Unindexed,
+  Truncated,      // indexed, but cut short within the clusters
+};
+
+bytes_t GenerateFile(Layout layout, size_t cluster_count) {
+  bytes_t clusters;
+  for (size_t i = 0; i < cluster_count; ++i) {
+    Append(clusters, Element(detail::kCluster, bytes_t(kClusterSize, 0)));
+  }
+
+  bytes_t info = UIntElement(detail::kTimecodeScale, 1000000);
+  Append(info, FloatElement(detail::kDuration, 1440000.0));
+  Append(info, StringElement(detail::kTitle, "Show - 01"));
+  info = Element(detail::kInfo, info);
+
+  bytes_t track = UIntElement(detail::kTrackType, detail::kVideo);
+  Append(track, StringElement(detail::kTrackName, "Video"));
+  const bytes_t tracks =
+      Element(detail::kTracks, Element(detail::kTrackEntry, track));
+
+  // Positions are relative to the start of the segment data, and indices are
+  // of the same size whatever their positions are.
+  bytes_t segment;
+  switch (layout) {
+    case Layout::Indexed:
+    case Layout::Truncated: {
+      const uint64_t info_position =
+          SeekHead({{0, 0}, {0, 0}}).size() + clusters.size();
+      Append(segment, SeekHead({{detail::kInfo, info_position},
+                                {detail::kTracks,
+                                 info_position + info.size()}}));
+      Append(segment, clusters);
+      Append(segment, info);
+      Append(segment, tracks);
+      break;
+    }
+    case Layout::NestedIndex: {
+      const uint64_t info_position =
+          SeekHead({{0, 0}}).size() + clusters.size();
+      const uint64_t tracks_position = info_position + info.size();
+      Append(segment, SeekHead({{detail::kSeekHead,
+                                 tracks_position + tracks.size()}}));
+      Append(segment, clusters);
+      Append(segment, info);
+      Append(segment, tracks);
+      Append(segment, SeekHead({{detail::kInfo, info_position},
+                                {detail::kTracks, tracks_position}}));
+      break;
+    }
+    case Layout::Unindexed:
+      Append(segment, clusters);
+      Append(segment, info);
+      Append(segment, tracks);
+      break;
+  }
+
+  constexpr uint32_t kDocType = 0x4282;
+  bytes_t data = Element(detail::kEBML, StringElement(kDocType, "matroska"));
+  Append(data, Element(detail::kSegment, segment));
+  if (layout == Layout::Truncated)
+    data.resize(data.size() - clusters.size() / 2 - info.size() -
+                tracks.size());
+  return data;
+}
+
+struct Probe {
+  bool success = false;
+  Info info;
+  detail::ByteSourceStats stats;
+};
+
+Probe ReadSource(detail::ByteSource& source) {
+  Probe probe;
+  probe.success = detail::ReadInfo(source, probe.info);
+  probe.stats = source.stats();
+  return probe;
+}
+
+bool HasInfo(const Probe& probe) {
+  return probe.success && probe.info.duration.count() == 1440000.0f &&
+         probe.info.title == "Show - 01" &&
+         probe.info.video_track_name == "Video";
+}
+
+bool HasNoInfo(const Probe& probe) {
+  return probe.info.duration.count() == 0 && probe.info.title.empty() &&
+         probe.info.video_track_name.empty();
+}
+
+void CheckLayout(const std::filesystem::path& directory, Layout layout,
+                 const char* name) {
+  std::vector<Probe> memory_probes;
+  std::vector<Probe> file_probes;
+
+  for (const auto cluster_count : kClusterCounts) {
+    const auto data = GenerateFile(layout, cluster_count);
+    const auto path =
+        directory / (name + (" " + std::to_string(cluster_count)) + ".mkv");
+    std::ofstream(path, std::ios::binary)
+        .write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+
+    detail::MemorySource memory_source(data);
+    memory_probes.push_back(ReadSource(memory_source));
+
+    detail::FileSource file_source;
+    if (!file_source.Open(path.string())) {
+      Expect(false, std::string{"file is opened: "} + path.string());
+      return;
+    }
+    file_probes.push_back(ReadSource(file_source));
+
+    const auto& memory = memory_probes.back().stats;
+    const auto& file = file_probes.back().stats;
+    std::printf(
+        "%s, %zu clusters: views: %llu (%llu bytes), "
+        "reads: %llu (%llu bytes)\n",
+        name, cluster_count, static_cast<unsigned long long>(memory.views),
+        static_cast<unsigned long long>(memory.bytes_viewed),
+        static_cast<unsigned long long>(file.reads),
+        static_cast<unsigned long long>(file.bytes_read));
+  }
+
+  const std::string prefix = std::string{name} + " files ";
+  auto all_of = [&](bool (*predicate)(const Probe&)) {
+    for (size_t i = 0; i < memory_probes.size(); ++i) {
+      if (!predicate(memory_probes[i]) || !predicate(file_probes[i]))
+        return false;
+    }
+    return true;
+  };
+  auto constant = [&](const std::vector<Probe>& probes, auto member) {
+    for (const auto& probe : probes) {
+      if (probe.stats.*member != probes.front().stats.*member)
+        return false;
+    }
+    return true;
+  };
+
+  switch (layout) {
+    case Layout::Indexed:
+    case Layout::NestedIndex:
+      Expect(all_of(HasInfo), prefix + "are read");
+      Expect(constant(memory_probes, &detail::ByteSourceStats::views) &&
+                 constant(memory_probes,
+                          &detail::ByteSourceStats::bytes_viewed),
+             prefix + "take the same views however many clusters they have");
+      Expect(constant(file_probes, &detail::ByteSourceStats::reads) &&
+                 constant(file_probes, &detail::ByteSourceStats::bytes_read),
+             prefix + "take the same reads however many clusters they have");
+      break;
+    case Layout::Unindexed:
+      Expect(all_of(HasInfo), prefix + "are scanned");
+      break;
+    case Layout::Truncated:
+      Expect(all_of(HasNoInfo), prefix + "are read as far as they go");
+      break;
+  }
+}
+
+int Check() {
+  std::error_code ec;
+  const auto directory =
+      std::filesystem::temp_directory_path(ec) /
+      ("anisthesia-probe-matroska-" + std::to_string(std::random_device{}()));
+  if (ec || !std::filesystem::create_directory(directory, ec)) {
+    std::fprintf(stderr, "Could not create a temporary directory\n");
+    return 1;
+  }
+
+  CheckLayout(directory, Layout::Indexed, "indexed");
+  CheckLayout(directory, Layout::NestedIndex, "nested index");
+  CheckLayout(directory, Layout::Unindexed, "unindexed");
+  CheckLayout(directory, Layout::Truncated, "truncated");
+
+  std::filesystem::remove_all(directory, ec);
+
+  if (failures) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  if (args.size() == 1 && args.front() == "--check")
+    return Check();
+
+  auto type = SourceType::File;
+  if (!args.empty() && args.front() == "--mmap") {
+    type = SourceType::Mapped;
+    args.erase(args.begin());
+  } else if (!args.empty() && args.front() == "--pread") {
+    args.erase(args.begin());
+  }
+
+  if (args.empty()) {
+    std::fprintf(stderr,
+                 "Usage: %s [--mmap | --pread] <file>...\n"
+                 "       %s --check\n",
+                 argv[0], argv[0]);
+    return 1;
+  }
+
+  int result = 0;
+
+  for (const auto& path : args) {
+    const auto source = OpenSource(type, path);
+    if (!source) {
+      std::fprintf(stderr, "Could not open file: %s\n", path.c_str());
+      result = 1;
+      continue;
+    }
+
+    Info info;
+    const auto start = std::chrono::steady_clock::now();
+    const bool success = detail::ReadInfo(*source, info);
+    const std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const auto& stats = source->stats();
+    std::printf(
+        "%s\n"
+        "  duration: %.0f ms, title: \"%s\", video track: \"%s\"%s\n"
+        "  file size: %llu, views: %llu (%llu bytes), "
+        "reads: %llu (%llu bytes), %.1f us\n",
+        path.c_str(), info.duration.count(), info.title.c_str(),
+        info.video_track_name.c_str(), success ? "" : " (failed)",
+        static_cast<unsigned long long>(source->size()),
+        static_cast<unsigned long long>(stats.views),
+        static_cast<unsigned long long>(stats.bytes_viewed),
+        static_cast<unsigned long long>(stats.reads),
+        static_cast<unsigned long long>(stats.bytes_read), elapsed.count());
+
+    if (!success)
+      result = 1;
+  }
+
+  return result;
+}